@@ -0,0 +1,112 @@
+
+#include "container.h"
+#include "math.h"
+
+#include <thread>
+
+using namespace evx;
+
+/*
+// abac
+//
+// Compresses or decompresses a file (or pipe) into a container (see container.h).
+//
+//   usage: abac [-d] [-l level] [-t threads] [input [output]]
+*/
+
+void print_usage()
+{
+    printf("usage: abac [-d] [-l level] [-t threads] [input [output]]\n");
+    printf("  -d          decompress the input\n");
+    printf("  -l level    1 (fastest) through 9 (best ratio), default %i\n", EVX_CONTAINER_DEFAULT_LEVEL);
+    printf("  -t threads  number of coder threads, default is the hardware concurrency\n");
+    printf("  input and output default to stdin and stdout, or may be specified as -\n");
+}
+
+int main(int argc, char **argv)
+{
+    FILE *input = stdin;
+    FILE *output = stdout;
+    uint32 level = EVX_CONTAINER_DEFAULT_LEVEL;
+    uint32 thread_count = evx_max2(std::thread::hardware_concurrency(), 1u);
+    bool decompress = false;
+    const char *input_filename = 0;
+    const char *output_filename = 0;
+
+    for (int32 i = 1; i < argc; ++i)
+    {
+        if (0 == strcmp(argv[i], "-d"))
+        {
+            decompress = true;
+        }
+        else if (0 == strcmp(argv[i], "-l") && i + 1 < argc)
+        {
+            level = (uint32) atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            thread_count = (uint32) atoi(argv[++i]);
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            print_usage();
+            return 1;
+        }
+        else if (!input_filename)
+        {
+            input_filename = argv[i];
+        }
+        else if (!output_filename)
+        {
+            output_filename = argv[i];
+        }
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (level < 1 || level > EVX_CONTAINER_MAX_LEVEL || 0 == thread_count)
+    {
+        print_usage();
+        return 1;
+    }
+
+    if (input_filename && strcmp(input_filename, "-"))
+    {
+        input = fopen(input_filename, "rb");
+    }
+
+    if (output_filename && strcmp(output_filename, "-"))
+    {
+        output = fopen(output_filename, "wb");
+    }
+
+    if (!input || !output)
+    {
+        fprintf(stderr, "error: unable to open %s\n", input ? output_filename : input_filename);
+        return 1;
+    }
+
+    evx_status result = (decompress ? decompress_container(input, output, thread_count) : 
+                                      compress_container(input, output, level, thread_count));
+
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+
+    if (output != stdout)
+    {
+        fclose(output);
+    }
+
+    if (EVX_SUCCESS != result)
+    {
+        fprintf(stderr, "error: %s failed with status %i\n", decompress ? "decompression" : "compression", result);
+        return 1;
+    }
+
+    return 0;
+}
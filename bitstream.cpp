@@ -2,6 +2,7 @@
 #include "bitstream.h"
 #include "math.h"
 #include "memory.h"
+#include "sink.h"
 
 namespace evx {
 
@@ -11,11 +12,17 @@ bitstream::bitstream()
     write_index = 0;
     data_store = 0;
     data_capacity = 0;
+    sink = 0;
+    flushed_bits = 0;
+    external = false;
 }
 
 bitstream::bitstream(uint32 size) 
 {
     data_store = 0;
+    sink = 0;
+    flushed_bits = 0;
+    external = false;
 
     if (size != resize_capacity(size)) 
     {
@@ -26,6 +33,9 @@ bitstream::bitstream(uint32 size)
 bitstream::bitstream(void *bytes, uint32 size) 
 {
     data_store = 0;
+    sink = 0;
+    flushed_bits = 0;
+    external = false;
 
     if (0 != assign(bytes, size)) 
     {
@@ -58,6 +68,16 @@ uint32 bitstream::query_byte_occupancy() const
     return align(query_occupancy(), 8) >> 3;
 }
 
+uint32 bitstream::query_read_index() const 
+{
+    return read_index;
+}
+
+uint32 bitstream::query_write_index() const 
+{
+    return write_index;
+}
+
 uint32 bitstream::resize_capacity(uint32 size_in_bits) 
 {
     if (EVX_PARAM_CHECK) 
@@ -84,6 +104,44 @@ uint32 bitstream::resize_capacity(uint32 size_in_bits)
     return size_in_bits;
 }
 
+evx_status bitstream::reserve_capacity(uint64 size_in_bits) 
+{
+    if (size_in_bits <= query_capacity()) 
+    {
+        return EVX_SUCCESS;
+    }
+
+    if (size_in_bits > EVX_MAX_UINT32) 
+    {
+        return evx_post_error(EVX_ERROR_CAPACITY_LIMIT);
+    }
+
+    uint32 byte_size = align((uint32) size_in_bits, 8) >> 3;
+    uint8 *new_store = new uint8[byte_size];
+
+    if (!new_store) 
+    {
+        return evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    /* Our indices are unaffected, so we preserve every byte up to the write index. */
+    if (data_store) 
+    {
+        memcpy(new_store, data_store, align(write_index, 8) >> 3);
+    }
+
+    if (!external) 
+    {
+        delete [] data_store;
+    }
+
+    data_store = new_store;
+    data_capacity = byte_size;
+    external = false;
+
+    return EVX_SUCCESS;
+}
+
 evx_status bitstream::seek(uint32 bit_offset) 
 {
     if (bit_offset >= write_index) 
@@ -95,11 +153,24 @@ evx_status bitstream::seek(uint32 bit_offset)
     return 0;
 }
 
+evx_status bitstream::truncate(uint32 bit_offset) 
+{
+    if (bit_offset > write_index || bit_offset < read_index) 
+    {
+        return evx_post_error(EVX_ERROR_INVALIDARG);
+    }
+
+    /* Bits beyond the write index are never assumed to be zero, so we
+       simply abandon them. */
+    write_index = bit_offset;
+    return EVX_SUCCESS;
+}
+
 evx_status bitstream::assign(void *bytes, uint32 size) 
 {
     if (EVX_PARAM_CHECK) 
     {
-        if (0 == size || !bytes) 
+        if (0 == size || size > EVX_BITSTREAM_MAX_BYTES || !bytes) 
         {
             return evx_post_error(EVX_ERROR_INVALIDARG);
         }
@@ -124,19 +195,131 @@ evx_status bitstream::assign(void *bytes, uint32 size)
     return EVX_SUCCESS;
 }
 
+evx_status bitstream::wrap(void *bytes, uint32 size) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (0 == size || size > EVX_BITSTREAM_MAX_BYTES || !bytes) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    clear();
+
+    data_store = reinterpret_cast<uint8 *>(bytes);
+    data_capacity = size;
+    external = true;
+
+    read_index = 0;
+    write_index = size << 3;
+
+    return EVX_SUCCESS;
+}
+
 void bitstream::clear() 
 {
     empty();
 
-    delete [] data_store;
+    if (!external) 
+    {
+        delete [] data_store;
+    }
+
     data_store = 0;
     data_capacity = 0;
+    external = false;
 }
 
 void bitstream::empty() 
 {
     write_index = 0;
     read_index = 0;
+    flushed_bits = 0;
+}
+
+void bitstream::attach_sink(bitstream_sink *output) 
+{
+    sink = output;
+}
+
+uint64 bitstream::query_flushed_bits() const 
+{
+    return flushed_bits;
+}
+
+evx_status bitstream::drain_sink() 
+{
+    uint32 byte_count = write_index >> 3;
+
+    if (0 == byte_count) 
+    {
+        return EVX_SUCCESS;
+    }
+
+    if (EVX_SUCCESS != sink->write(data_store, byte_count)) 
+    {
+        return evx_post_error(EVX_ERROR_IO_FAILURE);
+    }
+
+    /* Any trailing partial byte moves to the front of our buffer. A byte aligned 
+       stream has none, and byte_count may then be our entire buffer. */
+    if (write_index & 0x7) 
+    {
+        data_store[0] = data_store[byte_count];
+    }
+
+    write_index &= 0x7;
+    read_index = 0;
+    flushed_bits += byte_count << 3;
+
+    return EVX_SUCCESS;
+}
+
+evx_status bitstream::flush_sink(bool final) 
+{
+    if (!sink) 
+    {
+        return evx_post_error(EVX_ERROR_NOT_READY);
+    }
+
+    if (EVX_SUCCESS != drain_sink()) 
+    {
+        return evx_post_error(EVX_ERROR_IO_FAILURE);
+    }
+
+    if (final && write_index) 
+    {
+        /* Unused buffer memory is not zero filled, so we clear our padding bits. */
+        data_store[0] &= (0x1 << write_index) - 1;
+
+        if (EVX_SUCCESS != sink->write(data_store, 1)) 
+        {
+            return evx_post_error(EVX_ERROR_IO_FAILURE);
+        }
+
+        flushed_bits += write_index;
+        write_index = 0;
+        read_index = 0;
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status bitstream::ensure_capacity(uint32 bit_count) 
+{
+    if (uint64(write_index) + bit_count <= query_capacity()) 
+    {
+        return EVX_SUCCESS;
+    }
+
+    if (!sink || EVX_SUCCESS != drain_sink() ||
+        uint64(write_index) + bit_count > query_capacity()) 
+    {
+        return EVX_ERROR_CAPACITY_LIMIT;
+    }
+
+    return EVX_SUCCESS;
 }
 
 bool bitstream::is_empty() const 
@@ -151,7 +334,7 @@ bool bitstream::is_full() const
 
 evx_status bitstream::write_byte(uint8 value) 
 {
-    if (write_index + 8 > query_capacity()) 
+    if (write_index + 8 > query_capacity() && EVX_SUCCESS != ensure_capacity(8)) 
     {
         return EVX_ERROR_CAPACITY_LIMIT;
     }
@@ -181,7 +364,7 @@ evx_status bitstream::write_byte(uint8 value)
 
 evx_status bitstream::write_bit(uint8 value) 
 {
-    if (write_index + 1 > query_capacity()) 
+    if (write_index + 1 > query_capacity() && EVX_SUCCESS != ensure_capacity(1)) 
     {
         return EVX_ERROR_CAPACITY_LIMIT;
     }
@@ -200,6 +383,35 @@ evx_status bitstream::write_bit(uint8 value)
     return EVX_SUCCESS;
 }
 
+evx_status bitstream::write_run(uint8 value, uint32 bit_count) 
+{
+    if (write_index + bit_count > query_capacity() && !sink) 
+    {
+        return EVX_ERROR_CAPACITY_LIMIT;
+    }
+
+    while (bit_count) 
+    {
+        uint32 chunk_size = evx_min2(bit_count, query_capacity() - write_index);
+
+        if (0 == chunk_size) 
+        {
+            /* Only reachable with an attached sink. */
+            if (EVX_SUCCESS != ensure_capacity(1)) 
+            {
+                return EVX_ERROR_CAPACITY_LIMIT;
+            }
+
+            continue;
+        }
+
+        write_run_unchecked(value, chunk_size);
+        bit_count -= chunk_size;
+    }
+
+    return EVX_SUCCESS;
+}
+
 evx_status bitstream::write_bits(void *data, uint32 bit_count) 
 {
     if (EVX_PARAM_CHECK) 
@@ -210,7 +422,7 @@ evx_status bitstream::write_bits(void *data, uint32 bit_count)
         }
     }
 
-    if (write_index + bit_count > query_capacity()) 
+    if (write_index + bit_count > query_capacity() && !sink) 
     {
         return EVX_ERROR_CAPACITY_LIMIT;
     }
@@ -218,29 +430,54 @@ evx_status bitstream::write_bits(void *data, uint32 bit_count)
     uint32 bits_copied = 0;
     uint8 *source = reinterpret_cast<uint8 *>(data);
 
-    if (0 == (write_index % 8) && (bit_count >= 8)) 
+    while (bits_copied < bit_count) 
     {
-        /* We can perform a (partial) fast copy because our source and destination 
-           are byte aligned. We handle any trailing bits below. */
-        bits_copied = aligned_bit_copy(data_store, write_index, source, 0, bit_count);
+        uint32 chunk_size = bit_count - bits_copied;
+        uint32 chunk_copied = 0;
 
-        if (!bits_copied) 
+        if (write_index + chunk_size > query_capacity()) 
         {
-            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+            /* Only reachable with an attached sink. We drain our buffer and write as
+               much as fits, preferring whole bytes to preserve source alignment. */
+            if (EVX_SUCCESS != drain_sink()) 
+            {
+                return evx_post_error(EVX_ERROR_IO_FAILURE);
+            }
+
+            chunk_size = evx_min2(chunk_size, query_capacity() - write_index);
+            chunk_size = (chunk_size > 8 ? chunk_size & ~0x7 : chunk_size);
+
+            if (0 == chunk_size) 
+            {
+                return EVX_ERROR_CAPACITY_LIMIT;
+            }
         }
-    }
 
-    if (bits_copied < bit_count) 
-    {
-        /* Perform unaligned copies of our data. */
-        bits_copied += unaligned_bit_copy(data_store, 
-                                          write_index + bits_copied, 
-                                          source, 
-                                          bits_copied, 
-                                          bit_count - bits_copied);
-    }
+        if (0 == (write_index % 8) && 0 == (bits_copied % 8) && (chunk_size >= 8)) 
+        {
+            /* We can perform a (partial) fast copy because our source and destination 
+               are byte aligned. We handle any trailing bits below. */
+            chunk_copied = aligned_bit_copy(data_store, write_index, source, bits_copied, chunk_size);
+
+            if (!chunk_copied) 
+            {
+                return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+            }
+        }
 
-    write_index += bits_copied;
+        if (chunk_copied < chunk_size) 
+        {
+            /* Perform unaligned copies of our data. */
+            chunk_copied += shifted_bit_copy(data_store, 
+                                             write_index + chunk_copied, 
+                                             source, 
+                                             bits_copied + chunk_copied, 
+                                             chunk_size - chunk_copied);
+        }
+
+        write_index += chunk_copied;
+        bits_copied += chunk_copied;
+    }
 
     return EVX_SUCCESS;
 }
@@ -353,11 +590,11 @@ evx_status bitstream::read_bits(void *data, uint32 *bit_count)
     /* Perform unaligned copies of our data. */
     if (bits_copied < (*bit_count)) 
     {
-        bits_copied += unaligned_bit_copy(dest, 
-                                          bits_copied, 
-                                          data_store, 
-                                          read_index + bits_copied, 
-                                          (*bit_count) - bits_copied);
+        bits_copied += shifted_bit_copy(dest, 
+                                        bits_copied, 
+                                        data_store, 
+                                        read_index + bits_copied, 
+                                        (*bit_count) - bits_copied);
     }
 
     read_index += bits_copied;
@@ -365,6 +602,66 @@ evx_status bitstream::read_bits(void *data, uint32 *bit_count)
     return EVX_SUCCESS;
 }
 
+evx_status bitstream::append(const bitstream &source) 
+{
+    const bitstream *sources[] = { &source };
+    return append(sources, 1);
+}
+
+evx_status bitstream::append(const bitstream *const *sources, uint32 source_count) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!sources || 0 == source_count) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint64 total_bits = 0;
+
+    for (uint32 i = 0; i < source_count; ++i) 
+    {
+        if (!sources[i]) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+
+        total_bits += sources[i]->query_occupancy();
+    }
+
+    /* Sink backed streams write through their existing buffer instead of growing. */
+    if (!sink && EVX_SUCCESS != reserve_capacity(write_index + total_bits)) 
+    {
+        return evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    for (uint32 i = 0; i < source_count; ++i) 
+    {
+        uint32 source_index = sources[i]->read_index;
+        uint32 bit_count = sources[i]->query_occupancy();
+
+        while (bit_count) 
+        {
+            if (EVX_SUCCESS != ensure_capacity(evx_min2(bit_count, (uint32) 8))) 
+            {
+                return evx_post_error(EVX_ERROR_CAPACITY_LIMIT);
+            }
+
+            /* Our source data is queried per chunk since appending a stream to itself
+               may have reallocated it above. */
+            uint32 chunk_size = evx_min2(bit_count, query_capacity() - write_index);
+            shifted_bit_copy(data_store, write_index, sources[i]->data_store, source_index, chunk_size);
+
+            write_index += chunk_size;
+            source_index += chunk_size;
+            bit_count -= chunk_size;
+        }
+    }
+
+    return EVX_SUCCESS;
+}
+
 evx_status bitstream::read_bytes(void *data, uint32 *byte_count) 
 {
     if (EVX_PARAM_CHECK) 
@@ -37,17 +37,30 @@
 
 #include "base.h"
 
+/* Bit indices are 32 bits, so byte buffers must be smaller than 512 MB. */
+#define EVX_BITSTREAM_MAX_BYTES             (0x1FFFFFFF)
+
 #define EVX_READ_BIT(source, bit)           (((source) >> (bit)) & 0x1)
 #define EVX_WRITE_BIT(dest, bit, value)     (dest) = (((dest) & ~(0x1 << (bit))) | \
                                             (((value) & 0x1) << (bit)))
 namespace evx {
 
+class bitstream_sink;
+
 class bitstream 
 {
     uint32 read_index;
     uint32 write_index;
     uint32 data_capacity;
     uint8 *data_store;
+    bitstream_sink *sink;
+    uint64 flushed_bits;
+    bool external;
+
+private:
+
+    evx_status drain_sink();
+    evx_status reserve_capacity(uint64 size_in_bits);
 
 public:
 
@@ -62,12 +75,23 @@ public:
     uint32 query_byte_occupancy() const;
     uint32 resize_capacity(uint32 size_in_bits);
 
-    /* seek will only adjust the read index. there is purposely 
-       no way to adjust the write index. */
+    uint32 query_read_index() const;
+    uint32 query_write_index() const;
+
+    /* seek will only adjust the read index. truncate may only move 
+       the write index backwards, discarding previously written bits. */
     evx_status seek(uint32 bit_offset);
+    evx_status truncate(uint32 bit_offset);
     evx_status assign(const bitstream &rvalue);
+
+    /* Buffers of up to EVX_BITSTREAM_MAX_BYTES may be assigned or wrapped. */
     evx_status assign(void *bytes, uint32 size);
 
+    /* Wraps caller owned memory without copying it. The memory must outlive our use
+       of it, and is never freed by the stream. Growing the stream replaces it with
+       an owned copy. */
+    evx_status wrap(void *bytes, uint32 size);
+
     void clear();   
     void empty();  
 
@@ -84,11 +108,127 @@ public:
     evx_status read_bytes(void *data, uint32 *byte_count);
     evx_status read_bits(void *data, uint32 *bit_count);
 
+    /* Appends the unread bits of one or more streams at our write index, which need
+       not be byte aligned. Our buffer grows (preserving its contents) as required, 
+       and appending a batch of streams allocates at most once. Sources are left 
+       unchanged. */
+    evx_status append(const bitstream &source);
+    evx_status append(const bitstream *const *sources, uint32 source_count);
+
+    /* An attached sink receives all completed bytes whenever a write would exceed
+       our capacity, after which the buffer is reused. Such streams are write only,
+       and flush_sink must be called (with final set) once writing is complete to
+       deliver any remaining bits. */
+    void attach_sink(bitstream_sink *output);
+    evx_status flush_sink(bool final);
+    evx_status ensure_capacity(uint32 bit_count);
+    uint64 query_flushed_bits() const;
+
+    /* Unchecked accessors for bulk coding loops. Callers must validate the
+       available capacity (or occupancy) before using these. */
+    uint32 query_free_bits() const;
+    uint32 query_unread_bits() const;
+    void write_bit_unchecked(uint8 value);
+    void write_word_unchecked(uint32 bits, uint8 bit_count);
+    void write_run_unchecked(uint8 value, uint32 bit_count);
+    uint8 read_bit_unchecked();
+    uint32 read_word_unchecked(uint8 bit_count);
+
+    /* Writes bit_count copies of a single bit value. */
+    evx_status write_run(uint8 value, uint32 bit_count);
+
 private:
   
     EVX_DISABLE_COPY_AND_ASSIGN(bitstream);
 };
 
+inline uint32 bitstream::query_free_bits() const 
+{
+    return (data_capacity << 3) - write_index;
+}
+
+inline uint32 bitstream::query_unread_bits() const 
+{
+    return write_index - read_index;
+}
+
+inline void bitstream::write_bit_unchecked(uint8 value) 
+{
+    uint8 *data = &(data_store[write_index >> 3]);
+    uint8 dest_bit = write_index & 0x7;
+
+    *data = ((*data) & ~(0x1 << dest_bit)) | (value & 0x1) << dest_bit;
+    write_index++;
+}
+
+inline void bitstream::write_word_unchecked(uint32 bits, uint8 bit_count) 
+{
+    /* Writes the low bit_count (<= 32) bits of our word, least significant first. We
+       merge with the bits already present in the current partial byte. */
+    uint32 dest_byte = write_index >> 3;
+    uint8 dest_bit = write_index & 0x7;
+    uint64 mask = (uint64(0x1) << bit_count) - 1;
+    uint64 word = (data_store[dest_byte] & ((0x1 << dest_bit) - 1)) | ((bits & mask) << dest_bit);
+    uint32 byte_count = (dest_bit + bit_count + 7) >> 3;
+
+    for (uint32 i = 0; i < byte_count; ++i) 
+    {
+        data_store[dest_byte + i] = (word >> (i << 3)) & 0xFF;
+    }
+
+    write_index += bit_count;
+}
+
+inline void bitstream::write_run_unchecked(uint8 value, uint32 bit_count) 
+{
+    uint8 fill = (value & 0x1) ? 0xFF : 0x00;
+
+    /* Complete our current partial byte, then fill whole bytes at once. */
+    while (bit_count && (write_index & 0x7)) 
+    {
+        write_bit_unchecked(value);
+        bit_count--;
+    }
+
+    if (bit_count >= 8) 
+    {
+        memset(data_store + (write_index >> 3), fill, bit_count >> 3);
+        write_index += bit_count & ~0x7;
+        bit_count &= 0x7;
+    }
+
+    if (bit_count) 
+    {
+        write_word_unchecked(fill, bit_count);
+    }
+}
+
+inline uint32 bitstream::read_word_unchecked(uint8 bit_count) 
+{
+    /* Returns bit_count (<= 32) bits, with the first bit read in the least significant position. */
+    uint32 source_byte = read_index >> 3;
+    uint8 source_bit = read_index & 0x7;
+    uint32 byte_count = (source_bit + bit_count + 7) >> 3;
+    uint64 word = 0;
+
+    for (uint32 i = 0; i < byte_count; ++i) 
+    {
+        word |= uint64(data_store[source_byte + i]) << (i << 3);
+    }
+
+    read_index += bit_count;
+
+    return uint32((word >> source_bit) & ((uint64(0x1) << bit_count) - 1));
+}
+
+inline uint8 bitstream::read_bit_unchecked() 
+{
+    uint8 value = (data_store[read_index >> 3] >> (read_index & 0x7)) & 0x1;
+    read_index++;
+
+    return value;
+}
+
 } // namespace EVX
 
 #endif // __EVX_BIT_STREAM_H__
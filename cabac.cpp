@@ -1,6 +1,10 @@
 
 #include "cabac.h"
+#include "index.h"
 #include "math.h"
+#include "memory.h"
+#include "rate.h"
+#include "ring.h"
 
 #define EVX_ENTROPY_PRECISION					(16)
 #define EVX_ENTROPY_PRECISION_MAX				((uint32(0x1) << EVX_ENTROPY_PRECISION) - 1)
@@ -10,6 +14,13 @@
 #define EVX_ENTROPY_3QTR_RANGE					(3 * EVX_ENTROPY_QTR_RANGE)
 #define EVX_ENTROPY_MSB_MASK					(uint64(0x1) << (EVX_ENTROPY_PRECISION - 1))
 #define EVX_ENTROPY_SMSB_MASK					(EVX_ENTROPY_MSB_MASK >> 1)
+#define EVX_ENTROPY_ESTIMATE_PRECISION			(15)
+#define EVX_ENTROPY_ESTIMATE_MAX				(uint32(0x1) << EVX_ENTROPY_ESTIMATE_PRECISION)
+#define EVX_ENTROPY_ESTIMATE_HALF				(EVX_ENTROPY_ESTIMATE_MAX >> 1)
+#define EVX_ENTROPY_MAX_RATE					(EVX_ENTROPY_ESTIMATE_PRECISION - 1)
+#define EVX_ENTROPY_BLOCK_SIZE					(256)
+#define EVX_ENTROPY_FLUSH_BITS					(2)
+#define EVX_ENTROPY_RUN_INDEX_MAX				(31)
 
 #if (EVX_ENTROPY_PRECISION > 32)
   #error "EVX_ENTROPY_PRECISION must be <= 32"
@@ -17,6 +28,14 @@
 
 namespace evx {
 
+/* Golomb orders indexed by our run index, as in JPEG-LS. Each run segment that is
+   fully coded advances the index, and each interrupted run steps it back. */
+static const uint8 run_golomb_order[EVX_ENTROPY_RUN_INDEX_MAX + 1] = 
+{
+    0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+    4, 4, 5, 5, 6, 6, 7, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
 /* 
 // ABAC Ranging
 //
@@ -31,12 +50,28 @@ entropy_coder::entropy_coder()
 {
     history[0] = 1;
     history[1] = 1;
+    initial_history[0] = 1;
+    initial_history[1] = 1;
+    initial_estimate = EVX_ENTROPY_ESTIMATE_HALF;
+
+    dual_rate = 0;
+    rate_shift[0] = EVX_ENTROPY_DEFAULT_FAST_RATE;
+    rate_shift[1] = EVX_ENTROPY_DEFAULT_SLOW_RATE;
+    estimate[0] = EVX_ENTROPY_ESTIMATE_HALF;
+    estimate[1] = EVX_ENTROPY_ESTIMATE_HALF;
 
     e3_count = 0;
     adaptive = 1;
     model = EVX_ENTROPY_HALF_RANGE;
+    static_shift = 0;
     value = 0;
 
+    run_mode = 0;
+    run_index = 0;
+    run_symbol = 0;
+    run_count = 0;
+    run_pending = 0;
+
     low = 0;
     high = EVX_ENTROPY_PRECISION_MAX;
     mid = EVX_ENTROPY_HALF_RANGE;
@@ -46,268 +81,1520 @@ entropy_coder::entropy_coder(uint32 input_model)
 {
     history[0] = 0;
     history[1] = 0;
+    initial_history[0] = 0;
+    initial_history[1] = 0;
+    initial_estimate = EVX_ENTROPY_ESTIMATE_HALF;
+
+    dual_rate = 0;
+    rate_shift[0] = EVX_ENTROPY_DEFAULT_FAST_RATE;
+    rate_shift[1] = EVX_ENTROPY_DEFAULT_SLOW_RATE;
+    estimate[0] = EVX_ENTROPY_ESTIMATE_HALF;
+    estimate[1] = EVX_ENTROPY_ESTIMATE_HALF;
 
     model = input_model;
     e3_count = 0;
     adaptive = 0;
+    static_shift = 0;
+    value = 0;
+
+    run_mode = 0;
+    run_index = 0;
+    run_symbol = 0;
+    run_count = 0;
+    run_pending = 0;
+
+    low	= 0;
+    high = EVX_ENTROPY_PRECISION_MAX;
+    mid = model;
+}
+
+entropy_coder::entropy_coder(uint8 fast_rate, uint8 slow_rate) 
+{
+    history[0] = 1;
+    history[1] = 1;
+    initial_history[0] = 1;
+    initial_history[1] = 1;
+    initial_estimate = EVX_ENTROPY_ESTIMATE_HALF;
+
+    /* Shift rates outside of [1, 14] would either freeze or overflow our estimates. */
+    dual_rate = 1;
+    rate_shift[0] = evx_max2(1, evx_min2(fast_rate, EVX_ENTROPY_MAX_RATE));
+    rate_shift[1] = evx_max2(1, evx_min2(slow_rate, EVX_ENTROPY_MAX_RATE));
+    estimate[0] = EVX_ENTROPY_ESTIMATE_HALF;
+    estimate[1] = EVX_ENTROPY_ESTIMATE_HALF;
+
+    model = EVX_ENTROPY_HALF_RANGE;
+    e3_count = 0;
+    adaptive = 1;
+    value = 0;
+    static_shift = 0;
+
+    run_mode = 0;
+    run_index = 0;
+    run_symbol = 0;
+    run_count = 0;
+    run_pending = 0;
+
+    low = 0;
+    high = EVX_ENTROPY_PRECISION_MAX;
+    mid = EVX_ENTROPY_HALF_RANGE;
+}
+
+void entropy_coder::clear() 
+{
+    low	= 0;
     value = 0;
+    e3_count = 0;
+    run_index = 0;
+    run_symbol = 0;
+    run_count = 0;
+    run_pending = 0;
+  
+    if (adaptive) 
+    {
+        history[0] = initial_history[0];
+        history[1] = initial_history[1];
+        estimate[0] = initial_estimate;
+        estimate[1] = initial_estimate;
+        high = EVX_ENTROPY_PRECISION_MAX;
+        mid	= EVX_ENTROPY_HALF_RANGE;
+    } 
+    else 
+    {
+        high = EVX_ENTROPY_PRECISION_MAX;
+        mid = model;
+    }
+}
+
+evx_status entropy_coder::load_model(const entropy_model &source, uint32 context_index) 
+{
+    entropy_model_state state;
+
+    if (EVX_SUCCESS != source.query_state(context_index, &state)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_INDEX);
+    }
+
+    uint32 zeros = (uint32(state.probability) * state.confidence) >> 16;
+
+    /* Each model type consumes the trained state in its own representation. */
+    initial_history[0] = evx_max2(zeros, 1);
+    initial_history[1] = evx_max2(state.confidence - zeros, 1);
+    initial_estimate = evx_max2(state.probability >> 1, 1);
+
+    /* Our static model divides the range by EVX_ENTROPY_PRECISION_MAX, so a context 
+       saturated towards zero must still leave room for a one. */
+    if (!adaptive) 
+    {
+        model = evx_min2((uint32) state.probability, EVX_ENTROPY_PRECISION_MAX - 1);
+    }
+
+    clear();
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::load_static_model(uint16 probability) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (0 == probability) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    adaptive = 0;
+    dual_rate = 0;
+    static_shift = 1;
+    model = probability;
+
+    clear();
+
+    return EVX_SUCCESS;
+}
+
+void entropy_coder::enable_run_mode(bool enable) 
+{
+    run_mode = enable;
+}
+
+void entropy_coder::resolve_model() 
+{
+    uint64 mid_range = 0; 
+    uint64 range = high - low;
+    
+    if (dual_rate) 
+    {
+        /* Our estimates track the probability of a zero and never reach either
+           bound, so the sum always leaves a non-empty range for a one. */
+        mid_range = (range * (estimate[0] + estimate[1])) >> (EVX_ENTROPY_ESTIMATE_PRECISION + 1);
+    } 
+    else if (adaptive) 
+    {
+        mid_range = range * history[0] / (history[0] + history[1]);
+    } 
+    else if (static_shift) 
+    {
+        mid_range = (range * model) >> EVX_ENTROPY_PRECISION;
+    } 
+    else 
+    {
+        mid_range = range * model / EVX_ENTROPY_PRECISION_MAX;
+    }
+
+    mid = low + mid_range;
+}
+
+static inline void update_estimate(uint16 *estimate, const uint8 *rate_shift, uint8 value) 
+{
+    if (value) 
+    {
+        estimate[0] -= estimate[0] >> rate_shift[0];
+        estimate[1] -= estimate[1] >> rate_shift[1];
+    } 
+    else 
+    {
+        estimate[0] += (EVX_ENTROPY_ESTIMATE_MAX - estimate[0]) >> rate_shift[0];
+        estimate[1] += (EVX_ENTROPY_ESTIMATE_MAX - estimate[1]) >> rate_shift[1];
+    }
+}
+
+static inline uint32 query_context_range(const entropy_context *context, uint64 range) 
+{
+    return uint32((range * (context->state >> EVX_CONTEXT_COUNT_BITS)) >> EVX_CONTEXT_PROBABILITY_BITS);
+}
+
+static inline void update_context(entropy_context *context, const uint8 *rate_shift, uint8 value) 
+{
+    uint32 probability = context->state >> EVX_CONTEXT_COUNT_BITS;
+    uint32 count = context->state & EVX_CONTEXT_COUNT_MAX;
+
+    /* Our shift moves from the fast rate to the slow rate as observations accumulate. */
+    int32 shift = rate_shift[0] + ((int32(rate_shift[1]) - rate_shift[0]) * int32(count)) / EVX_CONTEXT_COUNT_MAX;
+    shift = evx_max2(1, evx_min2(shift, EVX_CONTEXT_PROBABILITY_BITS - 1));
+
+    if (value) 
+    {
+        probability -= probability >> shift;
+    } 
+    else 
+    {
+        probability += (EVX_CONTEXT_PROBABILITY_MAX - probability) >> shift;
+    }
+
+    count = evx_min2(count + 1, (uint32) EVX_CONTEXT_COUNT_MAX);
+    context->state = uint16((probability << EVX_CONTEXT_COUNT_BITS) | count);
+}
+
+void entropy_coder::update_model(uint8 value) 
+{
+    if (dual_rate) 
+    {
+        update_estimate(estimate, rate_shift, value);
+        return;
+    }
+
+    /* Semi-static models never adapt, and need not count symbols. */
+    if (static_shift) 
+    {
+        return;
+    }
+
+    history[value]++;
+}
+
+uint32 entropy_coder::query_probability() const 
+{
+    /* Returns the probability of a zero in 1/65536 units. */
+    if (dual_rate) 
+    {
+        return estimate[0] + estimate[1];
+    } 
+    else if (adaptive) 
+    {
+        return uint32((uint64(history[0]) << 16) / (uint64(history[0]) + history[1]));
+    }
+
+    return model;
+}
+
+uint32 entropy_coder::estimate_rate(uint8 value) const 
+{
+    uint32 probability = query_probability();
+    return query_rate_cost(value & 0x1 ? 0x10000 - probability : probability);
+}
+
+uint32 entropy_coder::estimate_rate(const entropy_context &context, uint8 value) 
+{
+    uint32 probability = (context.state >> EVX_CONTEXT_COUNT_BITS) << (16 - EVX_CONTEXT_PROBABILITY_BITS);
+    return query_rate_cost(value & 0x1 ? 0x10000 - probability : probability);
+}
+
+evx_status entropy_coder::estimate_rate(bitstream *source, uint32 *cost) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!source || !cost) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint8 value = 0;
+    evx_status result = EVX_SUCCESS;
+    uint32 saved_history[2] = { history[0], history[1] };
+    uint16 saved_estimate[2] = { estimate[0], estimate[1] };
+
+    *cost = 0;
+
+    while (!source->is_empty()) 
+    {
+        if (EVX_SUCCESS != source->read_bit(&value)) 
+        {
+            result = evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            break;
+        }
+
+        value &= 0x1;
+        *cost += estimate_rate(value);
+        update_model(value);
+    }
+
+    history[0] = saved_history[0];
+    history[1] = saved_history[1];
+    estimate[0] = saved_estimate[0];
+    estimate[1] = saved_estimate[1];
+
+    return result;
+}
+
+void entropy_coder::save_checkpoint(const bitstream *dest, entropy_checkpoint *checkpoint) const 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!dest || !checkpoint) 
+        {
+            evx_post_error(EVX_ERROR_INVALIDARG);
+            return;
+        }
+    }
+
+    checkpoint->low = low;
+    checkpoint->high = high;
+    checkpoint->value = value;
+    checkpoint->e3_count = e3_count;
+    checkpoint->history[0] = history[0];
+    checkpoint->history[1] = history[1];
+    checkpoint->estimate[0] = estimate[0];
+    checkpoint->estimate[1] = estimate[1];
+    checkpoint->run_count = run_count;
+    checkpoint->run_index = run_index;
+    checkpoint->run_symbol = run_symbol;
+    checkpoint->run_pending = run_pending;
+    checkpoint->position = dest->query_flushed_bits() + dest->query_write_index();
+}
+
+evx_status entropy_coder::restore_checkpoint(const entropy_checkpoint &checkpoint, bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* Any bits emitted since the checkpoint are discarded in place, which is only
+       possible if they have not yet been drained to a sink. */
+    if (checkpoint.position < dest->query_flushed_bits() ||
+        EVX_SUCCESS != dest->truncate((uint32) (checkpoint.position - dest->query_flushed_bits()))) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    low = checkpoint.low;
+    high = checkpoint.high;
+    value = checkpoint.value;
+    e3_count = checkpoint.e3_count;
+    history[0] = checkpoint.history[0];
+    history[1] = checkpoint.history[1];
+    estimate[0] = checkpoint.estimate[0];
+    estimate[1] = checkpoint.estimate[1];
+    run_count = checkpoint.run_count;
+    run_index = checkpoint.run_index;
+    run_symbol = checkpoint.run_symbol;
+    run_pending = checkpoint.run_pending;
+
+    return EVX_SUCCESS;
+}
+
+static uint32 read_codeword(const bitstream *stream, uint32 bit_offset) 
+{
+    /* Returns the 16 bits at bit_offset, with the first bit in the most significant position. */
+    const uint8 *data = stream->query_data();
+    uint32 word = 0;
+
+    for (uint32 i = bit_offset; i < bit_offset + EVX_ENTROPY_PRECISION; ++i) 
+    {
+        word = (word << 1) | ((data[i >> 3] >> (i & 0x7)) & 0x1);
+    }
+
+    return word;
+}
+
+static evx_status encode_span(entropy_coder *coder, bitstream *source, uint32 span, bitstream *dest) 
+{
+    /* Codes the next span symbols of source through a view, without finishing the stream. */
+    uint32 read_index = source->query_read_index();
+    bitstream view;
+
+    if (EVX_SUCCESS != view.wrap(source->query_data(), (read_index + span + 7) >> 3) ||
+        EVX_SUCCESS != view.seek(read_index) ||
+        EVX_SUCCESS != view.truncate(read_index + span) ||
+        EVX_SUCCESS != coder->encode(&view, dest, false) ||
+        EVX_SUCCESS != source->seek(read_index + span)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::encode_indexed(uint32 interval, bitstream *source, bitstream *dest, entropy_index *index) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (0 == interval || !source || !dest || !index) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* Run mode holds symbols back from the coder, so its checkpoints do not line up
+       with symbol boundaries. */
+    if (run_mode) 
+    {
+        return evx_post_error(EVX_ERROR_NOTIMPL);
+    }
+
+    uint32 symbol_count = source->query_occupancy();
+    uint64 flushed_bits = dest->query_flushed_bits();
+    uint32 start_index = dest->query_write_index();
+    std::vector<entropy_index_entry> entries;
+
+    index->clear();
+    clear();
+
+    for (uint32 symbol_index = 0; symbol_index < symbol_count; symbol_index += interval) 
+    {
+        entropy_index_entry entry;
+        uint32 span = evx_min2(interval, symbol_count - symbol_index);
+
+        save_checkpoint(dest, &entry.checkpoint);
+        entry.symbol_index = symbol_index;
+        entry.checkpoint.position -= flushed_bits + start_index;
+        entries.push_back(entry);
+
+        if (EVX_SUCCESS != encode_span(this, source, span, dest)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+    }
+
+    if (EVX_SUCCESS != finish_encode(dest)) 
+    {
+        return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+    }
+
+    /* Decoder values are read back from the finished stream, so it must still be 
+       resident rather than drained to a sink. */
+    if (dest->query_flushed_bits() != flushed_bits) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    uint32 stream_bits = dest->query_write_index() - start_index;
+
+    for (uint32 i = 0; i < entries.size(); ++i) 
+    {
+        entropy_checkpoint *checkpoint = &entries[i].checkpoint;
+        uint32 value_index = (uint32) checkpoint->position + checkpoint->e3_count;
+
+        /* A decoder resuming here will have consumed our pending E3 bits, with each 
+           one having inverted the msb of its value. */
+        if (value_index + EVX_ENTROPY_PRECISION > stream_bits) 
+        {
+            break;
+        }
+
+        checkpoint->value = read_codeword(dest, start_index + value_index);
+        checkpoint->value ^= checkpoint->e3_count ? EVX_ENTROPY_MSB_MASK : 0;
+
+        if (EVX_SUCCESS != index->add_entry(entries[i].symbol_index, *checkpoint)) 
+        {
+            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+        }
+    }
+
+    index->set_symbol_count(symbol_count);
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::encode_bounded(uint32 byte_budget, bitstream *source, bitstream *dest, uint32 *symbol_count) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (0 == byte_budget || !source || !dest || !symbol_count) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (run_mode) 
+    {
+        return evx_post_error(EVX_ERROR_NOTIMPL);
+    }
+
+    uint64 budget_bits = uint64(byte_budget) << 3;
+    uint64 coded_bits = 0;
+    uint32 block_size = EVX_ENTROPY_BLOCK_SIZE;
+    entropy_checkpoint checkpoint;
+
+    /* Blocks are coded into scratch and only appended to dest once they are known to 
+       fit, so dest never holds more than byte_budget bytes. Pending E3 bits are bounded 
+       by the budget, and each symbol emits at most EVX_ENTROPY_PRECISION bits more. */
+    bitstream scratch((uint32) evx_min2(budget_bits + EVX_ENTROPY_BLOCK_SIZE * EVX_ENTROPY_PRECISION, (uint64) EVX_MAX_UINT32 - 7));
+
+    *symbol_count = 0;
+    clear();
+
+    /* Our finished size (output plus the flush of any pending E3 bits) never shrinks 
+       as symbols are added. We code whole blocks until one overruns the budget, then 
+       roll it back and retry with half the block size, so that the final symbols are 
+       placed one at a time and we stop at the longest prefix that fits. */
+    while (block_size && !source->is_empty()) 
+    {
+        uint32 span = evx_min2(block_size, source->query_occupancy());
+        uint32 read_index = source->query_read_index();
+
+        scratch.empty();
+        save_checkpoint(&scratch, &checkpoint);
+
+        if (EVX_SUCCESS != encode_span(this, source, span, &scratch)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        if (coded_bits + scratch.query_occupancy() + e3_count + EVX_ENTROPY_FLUSH_BITS <= budget_bits) 
+        {
+            if (scratch.query_occupancy() && EVX_SUCCESS != dest->append(scratch)) 
+            {
+                return evx_post_error(EVX_ERROR_CAPACITY_LIMIT);
+            }
+
+            coded_bits += scratch.query_occupancy();
+            *symbol_count += span;
+            continue;
+        }
+
+        restore_checkpoint(checkpoint, &scratch);
+        source->seek(read_index);
+        block_size >>= 1;
+    }
+
+    return finish_encode(dest);
+}
+
+evx_status entropy_coder::sync_flush(bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (run_mode) 
+    {
+        return evx_post_error(EVX_ERROR_NOTIMPL);
+    }
+
+    /* A decoder holds EVX_ENTROPY_PRECISION bits beyond our output and pending E3 bits, 
+       so we terminate the codeword and pad until those bits are in the stream. Any 
+       padding decodes correctly after a termination. */
+    if (EVX_SUCCESS != flush_encoder(dest)) 
+    {
+        return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+    }
+
+    uint64 position = dest->query_flushed_bits() + dest->query_write_index();
+    uint32 pad_bits = EVX_ENTROPY_PRECISION - EVX_ENTROPY_FLUSH_BITS;
+
+    pad_bits += (8 - ((position + pad_bits) & 0x7)) & 0x7;
+
+    if (EVX_SUCCESS != dest->write_run(0, pad_bits)) 
+    {
+        return evx_post_error(EVX_ERROR_CAPACITY_LIMIT);
+    }
+
+    /* Only the range restarts. Our model state carries over to the next segment. */
+    low = 0;
+    high = EVX_ENTROPY_PRECISION_MAX;
+    e3_count = 0;
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::sync_decode(bitstream *source) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!source) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* We have already read every bit of the flushed segment but its byte padding. */
+    uint32 read_index = (uint32) align(source->query_read_index(), 8);
+    uint8 bit = 0;
+
+    if (read_index > source->query_write_index() || EVX_SUCCESS != source->seek(read_index)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    low = 0;
+    high = EVX_ENTROPY_PRECISION_MAX;
+    e3_count = 0;
+    value = 0;
+
+    /* We read in our initial bits with padded tailing zeroes. */
+    for (uint32 i = 0; i < EVX_ENTROPY_PRECISION; ++i) 
+    {
+        if (!source->is_empty()) 
+        {
+            if (EVX_SUCCESS != source->read_bit(&bit)) 
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+        }
+
+        value <<= 0x1;
+        value |= bit;
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::resume_decode(const entropy_checkpoint &checkpoint, bitstream *source) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!source) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint64 read_index = source->query_read_index() + checkpoint.position + checkpoint.e3_count + EVX_ENTROPY_PRECISION;
+
+    if (read_index > source->query_write_index() || EVX_SUCCESS != source->seek((uint32) read_index)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    low = checkpoint.low;
+    high = checkpoint.high;
+    value = checkpoint.value;
+    e3_count = checkpoint.e3_count;
+    history[0] = checkpoint.history[0];
+    history[1] = checkpoint.history[1];
+    estimate[0] = checkpoint.estimate[0];
+    estimate[1] = checkpoint.estimate[1];
+    run_count = 0;
+    run_index = 0;
+    run_symbol = 0;
+    run_pending = 0;
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::encode_symbol(uint8 value) 
+{
+    value = value & 0x1;
+
+    /* We only encode the first 2 GB instances of each symbol. */
+    if (!dual_rate && history[value] >= (2 * EVX_GB)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    /* Adapt our model with knowledge of our recently processed value. */
+    resolve_model();
+
+    /* Encode our bit. */
+
+    if (value) 
+    {
+        low = mid + 1;		
+    } 
+    else 
+    {
+        high = mid;			  
+    }
+
+    update_model(value);
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::decode_symbol(uint32 value, bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* Adapt our model with knowledge of our recently processed value. */
+    resolve_model();
+
+    /* Decode our bit. */
+    if (value >= low && value <= mid) 
+    {
+        high = mid;
+        update_model(0);
+        dest->write_bit(0);
+    } 
+    else if (value > mid && value <= high) 
+    {
+        low = mid + 1;
+        update_model(1);
+        dest->write_bit(1);
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::flush_inverse_bits(uint8 value, bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* Our pending E3 bits are emitted as a single run. */
+    if (e3_count && EVX_SUCCESS != dest->write_run(!value, e3_count)) 
+    {
+        return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+    }
+
+    e3_count = 0;
+
+    return EVX_SUCCESS;
+}
+
+/*
+// Accelerated Scaling
+//
+// Rather than shifting one bit at a time, we determine the number of scaling steps
+// up front. E1/E2 steps occur while the msbs of low and high match, which is given by
+// the leading zeros of (low ^ high). E3 steps then occur while the bit below the msb
+// is set in low and clear in high. E3 steps never expose a new E1/E2 condition, so a
+// single pass of each is equivalent to the original bit serial loop. 
+//
+// Note that EVX_ENTROPY_3QTR_RANGE is not a power of two boundary, so an E3 step is
+// also refused when high has reached 0xBFFE or 0xBFFF. We preserve this exactly in
+// order to remain bitstream compatible.
+*/
+
+static inline uint8 query_e12_shifts(uint32 low, uint32 high) 
+{
+    return evx_min2(count_leading_zeros((low ^ high) << (32 - EVX_ENTROPY_PRECISION)), EVX_ENTROPY_PRECISION);
+}
+
+static inline uint8 query_e3_shifts(uint32 low, uint32 high) 
+{
+    uint32 candidates = (low & ~high) << (33 - EVX_ENTROPY_PRECISION);
+
+    if (!(candidates & 0x80000000)) 
+    {
+        return 0;
+    }
+
+    uint8 shifts = count_leading_zeros(~candidates);
+
+    /* Determine the first step at which high would sit on the 3qtr boundary. */
+    uint8 boundary_step = 0;
+    uint32 boundary_bits = EVX_ENTROPY_QTR_RANGE >> 1;
+
+    if (((high >> 1) & boundary_bits) != boundary_bits) 
+    {
+        uint8 trailing_ones = count_trailing_zeros(~high);
+        boundary_step = (trailing_ones >= EVX_ENTROPY_PRECISION - 3 ? 1 : (EVX_ENTROPY_PRECISION - 2) - trailing_ones);
+    }
+
+    return evx_min2(shifts, boundary_step);
+}
+
+inline void entropy_coder::renormalize_encoder(bitstream *dest) 
+{
+    uint8 shifts = query_e12_shifts(low, high);
+
+    if (shifts) 
+    {
+        /* Our leading bits, ordered for the stream with the msb first. */
+        uint32 bits = reverse_bits(low << (32 - EVX_ENTROPY_PRECISION));
+
+        if (e3_count) 
+        {
+            uint8 msb = bits & 0x1;
+            dest->write_bit_unchecked(msb);
+            dest->write_run_unchecked(!msb, e3_count);
+            e3_count = 0;
+
+            if (shifts > 1) 
+            {
+                dest->write_word_unchecked(bits >> 1, shifts - 1);
+            }
+        } 
+        else 
+        {
+            dest->write_word_unchecked(bits, shifts);
+        }
+
+        low = (low << shifts) & EVX_ENTROPY_PRECISION_MAX;
+        high = ((high << shifts) | ((uint32(0x1) << shifts) - 1)) & EVX_ENTROPY_PRECISION_MAX;
+    }
+
+    shifts = query_e3_shifts(low, high);
+
+    if (shifts) 
+    {
+        low = (low << shifts) & EVX_ENTROPY_HALF_RANGE;
+        high = EVX_ENTROPY_MSB_MASK | ((high << shifts) & EVX_ENTROPY_HALF_RANGE) | ((uint32(0x1) << shifts) - 1);
+        e3_count += shifts;
+    }
+}
+
+inline void entropy_coder::renormalize_decoder(uint32 *target, bitstream *source) 
+{
+    uint8 shifts = query_e12_shifts(low, high);
+    uint8 e3_shifts = query_e3_shifts(low << shifts, (high << shifts) | ((uint32(0x1) << shifts) - 1));
+    uint8 total_shifts = shifts + e3_shifts;
+
+    if (!total_shifts) 
+    {
+        return;
+    }
+
+    /* Every scaling step maps x to 2 * (x - c) + bit for a shared c, so the offset 
+       of our value from low simply accumulates the incoming bits. */
+    uint32 offset = *target - low;
+
+    low = (low << shifts) & EVX_ENTROPY_PRECISION_MAX;
+    high = ((high << shifts) | ((uint32(0x1) << shifts) - 1)) & EVX_ENTROPY_PRECISION_MAX;
+
+    if (e3_shifts) 
+    {
+        low = (low << e3_shifts) & EVX_ENTROPY_HALF_RANGE;
+        high = EVX_ENTROPY_MSB_MASK | ((high << e3_shifts) & EVX_ENTROPY_HALF_RANGE) | ((uint32(0x1) << e3_shifts) - 1);
+    }
+
+    uint32 incoming = 0;
+    uint8 read_count = evx_min2((uint32) total_shifts, source->query_unread_bits());
+
+    if (read_count) 
+    {
+        incoming = reverse_bits(source->read_word_unchecked(read_count)) >> (32 - read_count);
+    }
+
+    if (read_count < total_shifts) 
+    {
+        /* Reads past the end of our source repeat the last bit read during this scaling 
+           pass (or zero), matching the original bit serial decoder. */
+        uint8 pad_count = total_shifts - read_count;
+        uint32 padding = (incoming & 0x1) ? (uint32(0x1) << pad_count) - 1 : 0;
+        incoming = uint32(uint64(incoming) << pad_count) | padding;
+    }
+
+    *target = (low + (offset << total_shifts) + incoming) & EVX_ENTROPY_PRECISION_MAX;
+}
+
+evx_status entropy_coder::resolve_encode_scaling(bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint8 shifts = query_e12_shifts(low, high);
+
+    if (shifts && EVX_SUCCESS != dest->ensure_capacity(shifts + e3_count)) 
+    {
+        /* Our pending bits may exceed the capacity of a sink staging buffer, so we
+           emit the first E1/E2 step through the checked (streaming) path. */
+        uint8 msb = (low & EVX_ENTROPY_MSB_MASK) >> (EVX_ENTROPY_PRECISION - 1);
+
+        if (EVX_SUCCESS != dest->write_bit(msb) || 
+            EVX_SUCCESS != flush_inverse_bits(msb, dest) ||
+            EVX_SUCCESS != dest->ensure_capacity(shifts - 1)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        low = (low << 0x1) & EVX_ENTROPY_PRECISION_MAX;
+        high = ((high << 0x1) & EVX_ENTROPY_PRECISION_MAX) | 0x1;
+    }
+
+    renormalize_encoder(dest);
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::resolve_decode_scaling(uint32 *value, bitstream *source, bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!value || !source || !dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    renormalize_decoder(value, source);
+
+    return EVX_SUCCESS;
+}
+
+void entropy_coder::encode_block(uint32 symbol_count, bitstream *source, bitstream *dest) 
+{
+    /* Callers guarantee that the source holds symbol_count bits and that dest can hold 
+       the worst case output of the block, so this loop carries no status plumbing. It
+       mirrors encode_symbol and resolve_encode_scaling. */
+    for (uint32 i = 0; i < symbol_count; ++i) 
+    {
+        uint8 symbol = source->read_bit_unchecked();
+
+        resolve_model();
+
+        if (symbol) 
+        {
+            low = mid + 1;
+        } 
+        else 
+        {
+            high = mid;
+        }
+
+        update_model(symbol);
+        renormalize_encoder(dest);
+    }
+}
+
+void entropy_coder::decode_block(uint32 symbol_count, bitstream *source, bitstream *dest) 
+{
+    /* Callers guarantee that dest can hold symbol_count bits. */
+    for (uint32 i = 0; i < symbol_count; ++i) 
+    {
+        resolve_model();
+
+        if (value >= low && value <= mid) 
+        {
+            high = mid;
+            update_model(0);
+            dest->write_bit_unchecked(0);
+        } 
+        else if (value > mid && value <= high) 
+        {
+            low = mid + 1;
+            update_model(1);
+            dest->write_bit_unchecked(1);
+        }
+
+        renormalize_decoder(&value, source);
+    }
+}
+
+evx_status entropy_coder::flush_encoder(bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* A run left unterminated at the end of the stream is coded as a one, which the
+       decoder clamps to its remaining symbol count. */
+    if (run_pending && EVX_SUCCESS != encode_bypass(1, dest)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    run_pending = 0;
+    e3_count++;
+
+    if (low < EVX_ENTROPY_QTR_RANGE) 
+    {
+        if (EVX_SUCCESS != dest->write_bit(0) || 
+            EVX_SUCCESS != flush_inverse_bits(0, dest)) 
+        {
+            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+        }
+    } 
+    else 
+    {
+        if (EVX_SUCCESS != dest->write_bit(1) ||
+            EVX_SUCCESS != flush_inverse_bits(1, dest)) 
+        {
+            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+        }
+    }
+
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::encode_bypass(uint8 value, bitstream *dest) 
+{
+    /* Bypass bins split our range evenly and leave the model untouched. */
+    mid = low + ((high - low) >> 1);
+
+    if (value & 0x1) 
+    {
+        low = mid + 1;
+    } 
+    else 
+    {
+        high = mid;
+    }
+
+    return resolve_encode_scaling(dest);
+}
+
+evx_status entropy_coder::decode_bypass(uint8 *symbol, bitstream *source) 
+{
+    mid = low + ((high - low) >> 1);
+
+    if (value <= mid) 
+    {
+        high = mid;
+        *symbol = 0;
+    } 
+    else 
+    {
+        low = mid + 1;
+        *symbol = 1;
+    }
+
+    renormalize_decoder(&value, source);
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::encode_run(bitstream *source, bitstream *dest) 
+{
+    uint32 remaining = source->query_occupancy();
+    uint32 run_length = 0;
+    bool interrupted = false;
+    uint8 fill = run_symbol ? 0xFF : 0x00;
+
+    /* Measure our run, skipping whole bytes where possible. The interrupting symbol 
+       (if any) is consumed since the decoder will imply it. */
+    while (run_length < remaining) 
+    {
+        uint32 read_index = source->query_read_index();
+
+        if (0 == (read_index & 0x7) && remaining - run_length >= 8 && 
+            fill == source->query_data()[read_index >> 3]) 
+        {
+            source->seek(read_index + 8);
+            run_length += 8;
+            continue;
+        }
+
+        if (run_symbol != source->read_bit_unchecked()) 
+        {
+            interrupted = true;
+            break;
+        }
+
+        run_length++;
+    }
+
+    /* Our run continues any that was left unterminated by a previous call. */
+    run_length += run_pending;
+    run_pending = 0;
+
+    /* Each full segment of 2^k symbols is coded as a single one. */
+    while (run_length >= (uint32(0x1) << run_golomb_order[run_index])) 
+    {
+        if (EVX_SUCCESS != encode_bypass(1, dest)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        run_length -= uint32(0x1) << run_golomb_order[run_index];
+        run_index = evx_min2(run_index + 1, EVX_ENTROPY_RUN_INDEX_MAX);
+    }
+
+    if (interrupted) 
+    {
+        /* An interrupted run codes a zero followed by its remaining length in k bits. */
+        uint8 order = run_golomb_order[run_index];
+
+        if (EVX_SUCCESS != encode_bypass(0, dest)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        for (uint8 i = order; i > 0; --i) 
+        {
+            if (EVX_SUCCESS != encode_bypass((run_length >> (i - 1)) & 0x1, dest)) 
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+        }
+
+        run_index = run_index ? run_index - 1 : 0;
+        run_symbol = !run_symbol;
+        run_count = 1;
+    } 
+    else 
+    {
+        /* Our input may continue in a later call, so a partial segment is held back 
+           (and we remain in run mode) until the run ends or the stream is finished. */
+        run_pending = run_length;
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::decode_run(uint32 *symbol_count, bitstream *source, bitstream *dest) 
+{
+    uint8 bit = 0;
+
+    while (*symbol_count) 
+    {
+        if (EVX_SUCCESS != decode_bypass(&bit, source)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        uint8 order = run_golomb_order[run_index];
+
+        if (bit) 
+        {
+            /* A full segment, or the remainder of our symbols if fewer remain. */
+            uint32 run_length = evx_min2(*symbol_count, uint32(0x1) << order);
+
+            if (EVX_SUCCESS != dest->write_run(run_symbol, run_length)) 
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            *symbol_count -= run_length;
+            run_index = evx_min2(run_index + 1, EVX_ENTROPY_RUN_INDEX_MAX);
+            continue;
+        }
+
+        uint32 run_length = 0;
+
+        for (uint8 i = 0; i < order; ++i) 
+        {
+            if (EVX_SUCCESS != decode_bypass(&bit, source)) 
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            run_length = (run_length << 1) | bit;
+        }
+
+        /* Our run is followed by its implied interrupting symbol. */
+        if (run_length + 1 > *symbol_count ||
+            EVX_SUCCESS != dest->write_run(run_symbol, run_length) ||
+            EVX_SUCCESS != dest->write_bit(!run_symbol)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        *symbol_count -= run_length + 1;
+        run_index = run_index ? run_index - 1 : 0;
+        run_symbol = !run_symbol;
+        run_count = 1;
+
+        return EVX_SUCCESS;
+    }
+
+    run_count = 0;
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::encode_with_runs(bitstream *source, bitstream *dest) 
+{
+    uint8 value = 0;
+
+    while (!source->is_empty()) 
+    {
+        if (run_count >= EVX_ENTROPY_RUN_THRESHOLD) 
+        {
+            if (EVX_SUCCESS != encode_run(source, dest)) 
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            continue;
+        }
+
+        if (EVX_SUCCESS != source->read_bit(&value) ||
+            EVX_SUCCESS != encode_symbol(value) ||
+            EVX_SUCCESS != resolve_encode_scaling(dest)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        run_count = (value == run_symbol) ? run_count + 1 : 1;
+        run_symbol = value;
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::decode_with_runs(uint32 symbol_count, bitstream *source, bitstream *dest) 
+{
+    while (symbol_count) 
+    {
+        if (run_count >= EVX_ENTROPY_RUN_THRESHOLD) 
+        {
+            if (EVX_SUCCESS != decode_run(&symbol_count, source, dest)) 
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            continue;
+        }
+
+        if (EVX_SUCCESS != decode_symbol(value, dest) ||
+            EVX_SUCCESS != resolve_decode_scaling(&value, source, dest)) 
+        {
+            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+        }
+
+        /* Our decoded symbol is the last bit written to dest. Sinks always retain the
+           partial byte that holds it. */
+        uint32 write_index = dest->query_write_index() - 1;
+        uint8 symbol = (dest->query_data()[write_index >> 3] >> (write_index & 0x7)) & 0x1;
+
+        run_count = (symbol == run_symbol) ? run_count + 1 : 1;
+        run_symbol = symbol;
+        symbol_count--;
+    }
+
+    return EVX_SUCCESS;
+}
+
+void entropy_coder::init_context(entropy_context *context) const 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!context) 
+        {
+            evx_post_error(EVX_ERROR_INVALIDARG);
+            return;
+        }
+    }
+
+    context->state = EVX_CONTEXT_INITIAL_STATE;
+}
+
+evx_status entropy_coder::encode_bin(uint8 value, entropy_context *context, bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!context || !dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    mid = low + query_context_range(context, high - low);
+
+    if (value & 0x1) 
+    {
+        low = mid + 1;
+    } 
+    else 
+    {
+        high = mid;
+    }
+
+    update_context(context, rate_shift, value & 0x1);
 
-    low	= 0;
-    high = EVX_ENTROPY_PRECISION_MAX;
-    mid = model;
+    return resolve_encode_scaling(dest);
 }
 
-void entropy_coder::clear() 
+evx_status entropy_coder::encode_fixed_length(uint32 value, uint8 bit_count, bitstream *dest) 
 {
-    low	= 0;
-    value = 0;
-    e3_count = 0;
-  
-    if (adaptive) 
+    if (EVX_PARAM_CHECK) 
     {
-        history[0] = 1;
-        history[1] = 1;
-        high = EVX_ENTROPY_PRECISION_MAX;
-        mid	= EVX_ENTROPY_HALF_RANGE;
-    } 
-    else 
+        if (bit_count > 32 || !dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* Bits are coded most significant first. */
+    for (uint8 i = bit_count; i > 0; --i) 
     {
-        high = EVX_ENTROPY_PRECISION_MAX;
-        mid = model;
+        if (EVX_SUCCESS != encode_bypass((value >> (i - 1)) & 0x1, dest)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
     }
+
+    return EVX_SUCCESS;
 }
 
-void entropy_coder::resolve_model() 
+evx_status entropy_coder::encode_truncated_unary(uint32 value, uint32 max_value, entropy_context *contexts, uint32 context_count, bitstream *dest) 
 {
-    uint64 mid_range = 0; 
-    uint64 range = high - low;
-    
-    if (adaptive) 
+    if (EVX_PARAM_CHECK) 
     {
-        mid_range = range * history[0] / (history[0] + history[1]);
-    } 
-    else 
+        if (value > max_value || !contexts || 0 == context_count || !dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    for (uint32 i = 0; i < value; ++i) 
     {
-        mid_range = range * model / EVX_ENTROPY_PRECISION_MAX;
+        if (EVX_SUCCESS != encode_bin(1, &contexts[evx_min2(i, context_count - 1)], dest)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
     }
 
-    mid = low + mid_range;
+    if (value < max_value && 
+        EVX_SUCCESS != encode_bin(0, &contexts[evx_min2(value, context_count - 1)], dest)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    return EVX_SUCCESS;
 }
 
-evx_status entropy_coder::encode_symbol(uint8 value) 
+evx_status entropy_coder::encode_exp_golomb(uint32 value, uint8 k, bitstream *dest) 
 {
-    /* We only encode the first 2 GB instances of each symbol. */
-    if (history[value] >= (2 * EVX_GB)) 
+    if (EVX_PARAM_CHECK) 
     {
-        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        if (k > 31 || !dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
     }
 
-    /* Adapt our model with knowledge of our recently processed value. */
-    resolve_model();
+    while (k < 32 && value >= (uint32(0x1) << k)) 
+    {
+        if (EVX_SUCCESS != encode_bypass(1, dest)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
 
-    /* Encode our bit. */
-    value = value & 0x1;
+        value -= uint32(0x1) << k;
+        k++;
+    }
 
-    if (value) 
+    /* Values that exhaust all 32 orders omit their terminating zero. */
+    if ((k < 32 && EVX_SUCCESS != encode_bypass(0, dest)) ||
+        EVX_SUCCESS != encode_fixed_length(value, k, dest)) 
     {
-        low = mid + 1;		
-    } 
-    else 
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_coder::encode_ueg(uint32 value, uint8 k, uint32 cutoff, entropy_context *contexts, uint32 context_count, bitstream *dest) 
+{
+    if (EVX_SUCCESS != encode_truncated_unary(evx_min2(value, cutoff), cutoff, contexts, context_count, dest)) 
     {
-        high = mid;			  
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
     }
 
-    history[value]++;	
+    if (value >= cutoff && EVX_SUCCESS != encode_exp_golomb(value - cutoff, k, dest)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
 
     return EVX_SUCCESS;
 }
 
-evx_status entropy_coder::decode_symbol(uint32 value, bitstream *dest) 
+evx_status entropy_coder::decode_bin(entropy_context *context, bitstream *source, uint8 *symbol) 
 {
     if (EVX_PARAM_CHECK) 
     {
-        if (!dest) 
+        if (!context || !source || !symbol) 
         {
             return evx_post_error(EVX_ERROR_INVALIDARG);
         }
     }
 
-    /* Adapt our model with knowledge of our recently processed value. */
-    resolve_model();
+    mid = low + query_context_range(context, high - low);
 
-    /* Decode our bit. */
-    if (value >= low && value <= mid) 
+    if (value <= mid) 
     {
         high = mid;
-        history[0]++;
-        dest->write_bit(0);
+        *symbol = 0;
     } 
-    else if (value > mid && value <= high) 
+    else 
     {
         low = mid + 1;
-        history[1]++;
-        dest->write_bit(1);
+        *symbol = 1;
     }
 
+    update_context(context, rate_shift, *symbol);
+    renormalize_decoder(&value, source);
+
     return EVX_SUCCESS;
 }
 
-evx_status entropy_coder::flush_inverse_bits(uint8 value, bitstream *dest) 
+evx_status entropy_coder::decode_fixed_length(uint8 bit_count, bitstream *source, uint32 *value) 
 {
     if (EVX_PARAM_CHECK) 
     {
-        if (!dest) 
+        if (bit_count > 32 || !source || !value) 
         {
             return evx_post_error(EVX_ERROR_INVALIDARG);
         }
     }
 
-    value = !value;
+    uint8 bit = 0;
+    *value = 0;
 
-    for (uint32 i = 0; i < e3_count; ++i) 
+    for (uint8 i = 0; i < bit_count; ++i) 
     {
-        if (EVX_SUCCESS != dest->write_bit(value)) 
+        if (EVX_SUCCESS != decode_bypass(&bit, source)) 
         {
-            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
         }
-    }
 
-    e3_count = 0;
+        *value = (*value << 1) | bit;
+    }
 
     return EVX_SUCCESS;
 }
 
-evx_status entropy_coder::resolve_encode_scaling(bitstream *dest) 
+evx_status entropy_coder::decode_truncated_unary(uint32 max_value, entropy_context *contexts, uint32 context_count, bitstream *source, uint32 *value) 
 {
     if (EVX_PARAM_CHECK) 
     {
-        if (!dest) 
+        if (!contexts || 0 == context_count || !source || !value) 
         {
             return evx_post_error(EVX_ERROR_INVALIDARG);
         }
     }
 
-    while (true) 
+    uint8 bit = 1;
+    *value = 0;
+
+    while (*value < max_value) 
     {
-        if ((high & EVX_ENTROPY_MSB_MASK) == (low & EVX_ENTROPY_MSB_MASK)) 
+        if (EVX_SUCCESS != decode_bin(&contexts[evx_min2(*value, context_count - 1)], source, &bit)) 
         {
-            /* E1/E2 scaling violation. */
-            uint8 msb = (high & EVX_ENTROPY_MSB_MASK) >> (EVX_ENTROPY_PRECISION - 1);
-            low -= EVX_ENTROPY_HALF_RANGE * msb + msb;	
-            high -= EVX_ENTROPY_HALF_RANGE * msb + msb;	
-
-            if (EVX_SUCCESS != dest->write_bit(msb)) 
-            {
-                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
-            }
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
 
-            if (EVX_SUCCESS != flush_inverse_bits(msb, dest)) 
-            {
-                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
-            }
-        } 
-        else if (high <= EVX_ENTROPY_3QTR_RANGE && low > EVX_ENTROPY_QTR_RANGE) 
-        {
-            /* E3 scaling violation. */
-            high -= EVX_ENTROPY_QTR_RANGE + 1;
-            low	-= EVX_ENTROPY_QTR_RANGE + 1;
-            e3_count += 1;
-        } 
-        else 
+        if (!bit) 
         {
             break;
         }
 
-        high = ((high << 0x1) & EVX_ENTROPY_PRECISION_MAX) | 0x1;
-        low = ((low  << 0x1) & EVX_ENTROPY_PRECISION_MAX) | 0x0;
+        (*value)++;
     }
 
     return EVX_SUCCESS;
 }
 
-evx_status entropy_coder::resolve_decode_scaling(uint32 *value, bitstream *source, bitstream *dest) 
+evx_status entropy_coder::decode_exp_golomb(uint8 k, bitstream *source, uint32 *value) 
 {
     if (EVX_PARAM_CHECK) 
     {
-        if (!value || !source || !dest) 
+        if (k > 31 || !source || !value) 
         {
             return evx_post_error(EVX_ERROR_INVALIDARG);
         }
     }
 
     uint8 bit = 0;
+    uint32 base = 0;
+    uint32 suffix = 0;
 
-    while (true) 
+    while (k < 32) 
     {
-        if (high <= EVX_ENTROPY_HALF_RANGE) 
+        if (EVX_SUCCESS != decode_bypass(&bit, source)) 
         {
-            /* If our high value is less than half we do nothing (but
-               prevent the loop from exiting). */
-        } 
-        else if (low > EVX_ENTROPY_HALF_RANGE) 
-        {
-            high -= (EVX_ENTROPY_HALF_RANGE + 1);
-            low	-= (EVX_ENTROPY_HALF_RANGE + 1);
-            *value -= (EVX_ENTROPY_HALF_RANGE + 1);
-        }	
-        else if (high <= EVX_ENTROPY_3QTR_RANGE && low > EVX_ENTROPY_QTR_RANGE) 
-        {
-            /* E3 scaling violation. */
-            high -= EVX_ENTROPY_QTR_RANGE + 1;
-            low	-= EVX_ENTROPY_QTR_RANGE + 1;
-            *value -= EVX_ENTROPY_QTR_RANGE + 1;
-        } 
-        else
-        {
-            break;
-        }   
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
 
-        if (!source->is_empty()) 
+        if (!bit) 
         {
-            if (EVX_SUCCESS != source->read_bit(&bit)) 
-            {
-                return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
-            }
+            break;
         }
 
-        high = ((high << 0x1) & EVX_ENTROPY_PRECISION_MAX) | 0x1;
-        low = ((low  << 0x1) & EVX_ENTROPY_PRECISION_MAX) | 0x0;
-        *value = ((*value << 0x1) & EVX_ENTROPY_PRECISION_MAX) | bit;
+        base += uint32(0x1) << k;
+        k++;
+    }
+
+    if (EVX_SUCCESS != decode_fixed_length(k, source, &suffix)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
     }
 
+    *value = base + suffix;
+
     return EVX_SUCCESS;
 }
 
-evx_status entropy_coder::flush_encoder(bitstream *dest) 
+evx_status entropy_coder::decode_ueg(uint8 k, uint32 cutoff, entropy_context *contexts, uint32 context_count, bitstream *source, uint32 *value) 
 {
     if (EVX_PARAM_CHECK) 
     {
-        if (!dest) 
+        if (!value) 
         {
             return evx_post_error(EVX_ERROR_INVALIDARG);
         }
     }
 
-    e3_count++;
+    uint32 suffix = 0;
 
-    if (low < EVX_ENTROPY_QTR_RANGE) 
+    if (EVX_SUCCESS != decode_truncated_unary(cutoff, contexts, context_count, source, value)) 
     {
-        if (EVX_SUCCESS != dest->write_bit(0) || 
-            EVX_SUCCESS != flush_inverse_bits(0, dest)) 
-        {
-            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
-        }
-    } 
-    else 
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    if (*value >= cutoff) 
     {
-        if (EVX_SUCCESS != dest->write_bit(1) ||
-            EVX_SUCCESS != flush_inverse_bits(1, dest)) 
+        if (EVX_SUCCESS != decode_exp_golomb(k, source, &suffix)) 
         {
-            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
         }
-    }
 
-    clear();
+        *value += suffix;
+    }
 
     return EVX_SUCCESS;
 }
@@ -324,8 +1611,29 @@ evx_status entropy_coder::encode(bitstream *source, bitstream *dest, bool auto_f
 
     uint8 value = 0;
 
+    if (run_mode && EVX_SUCCESS != encode_with_runs(source, dest)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
     while (!source->is_empty()) 
     {
+        uint32 block_size = evx_min2(source->query_occupancy(), EVX_ENTROPY_BLOCK_SIZE);
+
+        /* Each symbol triggers fewer than EVX_ENTROPY_PRECISION scaling shifts, and each 
+           shift emits at most one bit plus any pending E3 bits. If the whole block fits 
+           we code it without per bit checks, otherwise we fall back to the checked path. */
+        uint64 worst_case_bits = uint64(block_size) * EVX_ENTROPY_PRECISION + e3_count;
+        bool history_fits = dual_rate || 
+                            evx_max2(history[0], history[1]) + block_size < (2 * EVX_GB);
+
+        if (history_fits && worst_case_bits <= EVX_MAX_UINT32 &&
+            EVX_SUCCESS == dest->ensure_capacity((uint32) worst_case_bits)) 
+        {
+            encode_block(block_size, source, dest);
+            continue;
+        }
+
         if (EVX_SUCCESS != source->read_bit(&value) ||
             EVX_SUCCESS != encode_symbol(value) ||
             EVX_SUCCESS != resolve_encode_scaling(dest)) 
@@ -349,6 +1657,45 @@ evx_status entropy_coder::encode(bitstream *source, bitstream *dest, bool auto_f
     return EVX_SUCCESS;
 }
 
+evx_status entropy_coder::encode(bitstream_ring *source, bitstream *dest, bool auto_finish) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!source || !dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    bitstream view;
+    uint8 *data = 0;
+    uint32 byte_count = 0;
+    evx_status result = EVX_SUCCESS;
+
+    while (EVX_SUCCESS == (result = source->acquire(&data, &byte_count))) 
+    {
+        if (EVX_SUCCESS != view.wrap(data, byte_count) ||
+            EVX_SUCCESS != encode(&view, dest, false)) 
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        source->release(byte_count);
+    }
+
+    if (EVX_ERROR_OPERATION_COMPLETED != result) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    if (auto_finish) 
+    {
+        return finish_encode(dest);
+    }
+
+    return EVX_SUCCESS;
+}
+
 evx_status entropy_coder::decode(uint32 symbol_count, bitstream *source, bitstream *dest, bool auto_start) 
 {
     if (EVX_PARAM_CHECK) 
@@ -382,14 +1729,31 @@ evx_status entropy_coder::decode(uint32 symbol_count, bitstream *source, bitstre
         }
     }
 
+    if (run_mode) 
+    {
+        return decode_with_runs(symbol_count, source, dest);
+    }
+
     /* Begin decoding the sequence. */
-    for (uint32 i = 0; i < symbol_count; ++i) 
+    while (symbol_count) 
     {
+        uint32 block_size = evx_min2(symbol_count, EVX_ENTROPY_BLOCK_SIZE);
+
+        /* Each symbol writes at most a single bit to our destination. */
+        if (EVX_SUCCESS == dest->ensure_capacity(block_size)) 
+        {
+            decode_block(block_size, source, dest);
+            symbol_count -= block_size;
+            continue;
+        }
+
         if (EVX_SUCCESS != decode_symbol(value, dest) ||
             EVX_SUCCESS != resolve_decode_scaling(&value, source, dest)) 
         {
             return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
         }
+
+        symbol_count--;
     }
 
     return EVX_SUCCESS;
@@ -432,4 +1796,84 @@ evx_status entropy_coder::finish_encode(bitstream *dest)
     return EVX_SUCCESS;
 }
 
-} // namespace evx
\ No newline at end of file
+uint16 entropy_coder::quantize_probability(uint64 zero_count, uint64 symbol_count) 
+{
+    if (0 == symbol_count) 
+    {
+        return 0x8000;
+    }
+
+    uint64 probability = (zero_count << 16) / symbol_count;
+
+    probability = evx_max2(probability, (uint64) 1);
+    probability = evx_min2(probability, (uint64) EVX_MAX_UINT16);
+
+    return (uint16) probability;
+}
+
+uint16 entropy_coder::measure_probability(const bitstream &source) 
+{
+    uint32 symbol_count = source.query_occupancy();
+
+    if (0 == symbol_count) 
+    {
+        return quantize_probability(0, 0);
+    }
+
+    uint32 one_count = count_set_bits(source.query_data(), source.query_read_index(), symbol_count);
+
+    return quantize_probability(symbol_count - one_count, symbol_count);
+}
+
+evx_status entropy_coder::encode_semi_static(uint16 probability, bitstream *source, bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!source || !dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* The header is stored little endian, ahead of the coded symbols. */
+    if (EVX_SUCCESS != load_static_model(probability) ||
+        EVX_SUCCESS != dest->write_byte(probability & 0xFF) ||
+        EVX_SUCCESS != dest->write_byte(probability >> 8)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    return encode(source, dest);
+}
+
+evx_status entropy_coder::decode_semi_static(uint32 symbol_count, bitstream *source, bitstream *dest) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!source || !dest) 
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint8 header[EVX_ENTROPY_SEMI_STATIC_HEADER_SIZE] = { 0 };
+    uint16 probability = 0;
+
+    if (source->query_occupancy() < (EVX_ENTROPY_SEMI_STATIC_HEADER_SIZE << 3) ||
+        EVX_SUCCESS != source->read_byte(&header[0]) ||
+        EVX_SUCCESS != source->read_byte(&header[1])) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    probability = uint16(header[0]) | (uint16(header[1]) << 8);
+
+    if (0 == probability || EVX_SUCCESS != load_static_model(probability)) 
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    return decode(symbol_count, source, dest);
+}
+
+} // namespace evx
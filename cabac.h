@@ -36,6 +36,8 @@
 #define __EV_CABAC_H__
 
 #include "bitstream.h"
+#include "context.h"
+#include "model.h"
  
 /*
 // Entropy Stream Interface
@@ -56,15 +58,119 @@
 //     Decode(). This process allows the coder to properly initialize, flush, and reset itself.
 */
 
+/*
+// Dual Rate Estimation
+//
+// The default adaptive coder derives its probability from a ratio of symbol counts,
+// which requires a division per coded bit. Passing a pair of shift rates to the 
+// constructor selects a dual rate estimator instead: two exponentially decaying 
+// estimates (one fast, one slow) are averaged and updated using shifts only.
+*/
+
+#define EVX_ENTROPY_DEFAULT_FAST_RATE           (4)
+#define EVX_ENTROPY_DEFAULT_SLOW_RATE           (7)
+
+/*
+// Run Mode
+//
+// Sparse inputs are dominated by long runs of a single bit value, each of which 
+// would otherwise pay for a full model update and renormalization. When run mode
+// is enabled, a run of EVX_ENTROPY_RUN_THRESHOLD identical coded symbols switches 
+// the coder into run mode, where the length of the following run is coded with an 
+// adaptive Golomb binarization (similar to JPEG-LS) using equiprobable bins. The 
+// symbol that interrupts a run is implied and the coder then resumes regular coding.
+// A run that reaches the end of an incremental encode call is held back until the
+// next call (or finish_encode) determines how it ends.
+//
+// Run mode changes the bitstream, so encoders and decoders must agree on it.
+*/
+
+#define EVX_ENTROPY_RUN_THRESHOLD               (16)
+
+/*
+// Semi-Static Coding
+//
+// The static model constructor takes a fixed probability, but choosing one requires
+// knowledge of the source. Semi-static coding makes two passes: the first measures 
+// the probability of a zero across the source (see measure_probability, or the
+// parallel_coder equivalent), and the second records that probability in a 16 bit
+// stream header before coding the source with it. 
+//
+// Semi-static models are normalized to 1/65536 units, so each symbol divides the
+// range with a multiply and a shift, and the model never adapts.
+*/
+
+#define EVX_ENTROPY_SEMI_STATIC_HEADER_SIZE     (2)
+
 namespace evx {
 
+class bitstream_ring;
+class entropy_index;
+
+/*
+// Checkpoints
+//
+// A checkpoint captures the complete range and model state of a coder along with 
+// the write position of its output stream. Rolling back restores the coder and
+// truncates the output stream, allowing several candidate encodings to be tried 
+// from the same starting point without copying any output.
+*/
+
+typedef struct entropy_checkpoint
+{
+    uint32 low;
+    uint32 high;
+    uint32 value;
+    uint32 e3_count;
+    uint32 history[2];
+    uint16 estimate[2];
+    uint32 run_count;
+    uint8 run_index;
+    uint8 run_symbol;
+    uint32 run_pending;
+    uint64 position;
+} entropy_checkpoint;
+
+/*
+// Integer Coding
+//
+// Integers may be coded directly, one call per value, between start_decode and
+// finish_encode. Each call is written straight to the coder's output stream
+// rather than through an intermediate bitstream. Bins that carry most of the
+// information (unary prefixes) are coded with caller-owned adaptive contexts,
+// while uniformly distributed bins (fixed length values and Exp-Golomb suffixes)
+// are coded as equiprobable bypass bins.
+//
+//   truncated unary: value ones followed by a zero, omitted when value == max.
+//   Exp-Golomb-k:    ones while value >= 2^k (subtracting 2^k and incrementing k
+//                    each time), a zero, and then the remaining value in k bits.
+//   UEGk:            a truncated unary prefix of min(value, cutoff), followed by an
+//                    Exp-Golomb-k suffix of (value - cutoff) when value >= cutoff.
+//
+// Prefix bin i uses contexts[min(i, context_count - 1)]. Contexts are packed states
+// (see context.h) that adapt between the coder's fast and slow rates, and must be 
+// initialized identically on both sides.
+*/
+
 class entropy_coder 
 {
     bool adaptive;
+    bool dual_rate;
+    uint8 rate_shift[2];
+    uint16 estimate[2];
+    uint16 initial_estimate;
     uint32 e3_count;
     uint32 history[2];
+    uint32 initial_history[2];
     uint32 value;
 
+    bool static_shift;
+    bool run_mode;
+    uint8 run_index;
+    uint8 run_symbol;
+    uint32 run_count;
+    uint32 run_pending;
+
     uint32 model;
     uint32 low;
     uint32 high;
@@ -73,6 +179,8 @@ class entropy_coder
 private:
 
     void resolve_model();
+    void update_model(uint8 value);
+    uint32 query_probability() const;
 
     evx_status flush_encoder(bitstream *dest);
     evx_status flush_inverse_bits(uint8 value, bitstream *dest);
@@ -83,18 +191,106 @@ private:
     evx_status resolve_encode_scaling(bitstream *dest);
     evx_status resolve_decode_scaling(uint32 *value, bitstream *source, bitstream *dest);
 
+    void renormalize_encoder(bitstream *dest);
+    void renormalize_decoder(uint32 *target, bitstream *source);
+
+    void encode_block(uint32 symbol_count, bitstream *source, bitstream *dest);
+    void decode_block(uint32 symbol_count, bitstream *source, bitstream *dest);
+
+    evx_status encode_bypass(uint8 value, bitstream *dest);
+    evx_status decode_bypass(uint8 *symbol, bitstream *source);
+
+    evx_status encode_run(bitstream *source, bitstream *dest);
+    evx_status decode_run(uint32 *symbol_count, bitstream *source, bitstream *dest);
+    evx_status encode_with_runs(bitstream *source, bitstream *dest);
+    evx_status decode_with_runs(uint32 symbol_count, bitstream *source, bitstream *dest);
+
 public:
 
     entropy_coder();
     explicit entropy_coder(uint32 input_model);
+    entropy_coder(uint8 fast_rate, uint8 slow_rate);
     void clear();
 
+    /* Initializes our model from a trained context state. The state persists across
+       calls to clear() until another model is loaded. */
+    evx_status load_model(const entropy_model &source, uint32 context_index);
+
+    /* Selects a semi-static model with the given probability of a zero, in 1/65536
+       units. The model persists across calls to clear() until another is loaded. */
+    evx_status load_static_model(uint16 probability);
+
+    /* Run mode is disabled by default and persists across calls to clear(). */
+    void enable_run_mode(bool enable);
+
     evx_status encode(bitstream *source, bitstream *dest, bool auto_finish=true);
+
+    /* Encodes bytes as they arrive from a producer thread, until the ring is closed.
+       Bytes are coded in place within the ring. */
+    evx_status encode(bitstream_ring *source, bitstream *dest, bool auto_finish=true);
     evx_status decode(uint32 symbol_count, bitstream *source, bitstream *dest, bool auto_start=true);
 
     evx_status start_decode(bitstream *source);
     evx_status finish_encode(bitstream *dest);
 
+    /* Semi-static coding writes (or reads) the model header and then codes an entire 
+       stream with it. The probability is typically the result of measure_probability. */
+    evx_status encode_semi_static(uint16 probability, bitstream *source, bitstream *dest);
+    evx_status decode_semi_static(uint32 symbol_count, bitstream *source, bitstream *dest);
+
+    /* Returns the probability of a zero among the unread bits of a source, in 1/65536
+       units, clamped so that neither symbol is impossible. */
+    static uint16 measure_probability(const bitstream &source);
+    static uint16 quantize_probability(uint64 zero_count, uint64 symbol_count);
+
+    /* Rate estimation returns the cost, in 1/256 bit units, of coding symbols
+       in our current model state without performing any arithmetic coding. Bulk
+       estimation consumes the source and adapts a scratch copy of our model, so
+       the coder state is left unchanged. */
+    uint32 estimate_rate(uint8 value) const;
+    evx_status estimate_rate(bitstream *source, uint32 *cost);
+
+    /* Returns the cost of coding value through a context in its current state, as 
+       encode_bin would. */
+    static uint32 estimate_rate(const entropy_context &context, uint8 value);
+
+    void save_checkpoint(const bitstream *dest, entropy_checkpoint *checkpoint) const;
+    evx_status restore_checkpoint(const entropy_checkpoint &checkpoint, bitstream *dest);
+
+    /* Indexed encoding codes a single adaptive stream while recording a checkpoint 
+       every interval symbols. A decoder may resume at any index entry, given a source 
+       whose read index is at the start of the stream, and then call decode with 
+       auto_start disabled. */
+    evx_status encode_indexed(uint32 interval, bitstream *source, bitstream *dest, entropy_index *index);
+    evx_status resume_decode(const entropy_checkpoint &checkpoint, bitstream *source);
+
+    /* A sync flush terminates the codeword and byte aligns the output, so that every 
+       symbol coded so far may be decoded from the bytes written so far. Unlike 
+       finish_encode, the model state is kept and encoding continues in the same stream.
+       A decoder calls sync_decode at the same point, before the symbols that follow, 
+       once their bytes are available. The decoder source should start byte aligned. */
+    evx_status sync_flush(bitstream *dest);
+    evx_status sync_decode(bitstream *source);
+
+    /* Codes as many symbols as fit within byte_budget bytes of finished output and 
+       terminates the stream, so that each call produces a packet that decodes on its 
+       own. The number of symbols consumed from source is returned in symbol_count. */
+    evx_status encode_bounded(uint32 byte_budget, bitstream *source, bitstream *dest, uint32 *symbol_count);
+
+    void init_context(entropy_context *context) const;
+
+    evx_status encode_bin(uint8 value, entropy_context *context, bitstream *dest);
+    evx_status encode_fixed_length(uint32 value, uint8 bit_count, bitstream *dest);
+    evx_status encode_truncated_unary(uint32 value, uint32 max_value, entropy_context *contexts, uint32 context_count, bitstream *dest);
+    evx_status encode_exp_golomb(uint32 value, uint8 k, bitstream *dest);
+    evx_status encode_ueg(uint32 value, uint8 k, uint32 cutoff, entropy_context *contexts, uint32 context_count, bitstream *dest);
+
+    evx_status decode_bin(entropy_context *context, bitstream *source, uint8 *symbol);
+    evx_status decode_fixed_length(uint8 bit_count, bitstream *source, uint32 *value);
+    evx_status decode_truncated_unary(uint32 max_value, entropy_context *contexts, uint32 context_count, bitstream *source, uint32 *value);
+    evx_status decode_exp_golomb(uint8 k, bitstream *source, uint32 *value);
+    evx_status decode_ueg(uint8 k, uint32 cutoff, entropy_context *contexts, uint32 context_count, bitstream *source, uint32 *value);
+
 private:
 
     EVX_DISABLE_COPY_AND_ASSIGN(entropy_coder);
@@ -0,0 +1,669 @@
+
+#include "container.h"
+#include "cabac.h"
+#include "hashed.h"
+#include "match.h"
+#include "math.h"
+#include "memory.h"
+#include "sink.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define EVX_CHUNK_HEADER_SIZE                   (9)
+#define EVX_CHUNK_MODE_CODED                    (0)
+#define EVX_CHUNK_MODE_STORED                   (1)
+#define EVX_DIRECT_CONTEXT_COUNT                (256 * 256)
+#define EVX_MATCH_PREDICT_LENGTH                (16)
+#define EVX_STAGING_SIZE                        (64 * EVX_KB)
+
+namespace evx {
+
+typedef struct level_setting
+{
+    uint32 chunk_size;
+    uint8 fast_rate;
+    uint8 slow_rate;
+    uint8 order;
+    uint8 bucket_bits;
+    uint8 window_bits;
+} level_setting;
+
+/* Lower levels favor throughput and parallelism with small chunks and cheap models.
+   A bucket_bits of zero selects direct order 1 contexts, and a non zero window_bits
+   attaches a match model with a window of that many bits. Higher levels restart 
+   adaptation less often, so their higher order contexts have time to settle. Sparse
+   contexts are only seen a handful of times, so every level adapts quickly. */
+static const level_setting level_settings[EVX_CONTAINER_MAX_LEVEL] = {
+    { 128 * EVX_KB, 1, 4, 1, 0, 0 },
+    { 256 * EVX_KB, 1, 4, 1, 0, 0 },
+    { 512 * EVX_KB, 1, 4, 2, 16, 0 },
+    { 1 * EVX_MB, 1, 4, 3, 18, 0 },
+    { 2 * EVX_MB, 1, 4, 3, 18, 0 },
+    { 2 * EVX_MB, 1, 4, 3, 20, 21 },
+    { 4 * EVX_MB, 1, 4, 3, 20, 22 },
+    { 8 * EVX_MB, 1, 4, 3, 20, 23 },
+    { 16 * EVX_MB, 1, 4, 3, 20, 24 },
+};
+
+typedef struct chunk_job
+{
+    uint64 index;
+    uint32 raw_size;
+    uint8 mode;
+    std::vector<uint8> data;
+} chunk_job;
+
+/* A bounded FIFO shared between pipeline stages. */
+class job_queue
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<chunk_job *> jobs;
+    uint32 capacity;
+    bool closed;
+
+public:
+
+    explicit job_queue(uint32 limit) : capacity(limit), closed(false) {}
+
+    void push(chunk_job *job)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (jobs.size() >= capacity && !closed)
+        {
+            changed.wait(guard);
+        }
+
+        jobs.push_back(job);
+        changed.notify_all();
+    }
+
+    /* Returns null once the queue is closed and drained. */
+    chunk_job *pop()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (jobs.empty() && !closed)
+        {
+            changed.wait(guard);
+        }
+
+        if (jobs.empty())
+        {
+            return 0;
+        }
+
+        chunk_job *job = jobs.front();
+        jobs.pop_front();
+        changed.notify_all();
+
+        return job;
+    }
+
+    void close()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        closed = true;
+        changed.notify_all();
+    }
+};
+
+/* Collects coded chunks and releases them strictly in index order. Producers block
+   while they are more than a window ahead of the writer. */
+class ordered_queue
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    std::map<uint64, chunk_job *> pending;
+    uint64 next_index;
+    uint32 window;
+    uint32 producers;
+
+public:
+
+    ordered_queue(uint32 limit, uint32 producer_count) : next_index(0), window(limit), producers(producer_count) {}
+
+    void push(chunk_job *job)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (job->index >= next_index + window)
+        {
+            changed.wait(guard);
+        }
+
+        pending[job->index] = job;
+        changed.notify_all();
+    }
+
+    void producer_done()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        producers--;
+        changed.notify_all();
+    }
+
+    /* Returns null once all producers have finished and no jobs remain. */
+    chunk_job *pop()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (!pending.count(next_index) && (producers || !pending.empty()))
+        {
+            changed.wait(guard);
+        }
+
+        if (!pending.count(next_index))
+        {
+            return 0;
+        }
+
+        chunk_job *job = pending[next_index];
+        pending.erase(next_index++);
+        changed.notify_all();
+
+        return job;
+    }
+};
+
+typedef struct pipeline_context
+{
+    FILE *input;
+    FILE *output;
+    uint32 chunk_size;
+    uint32 level;
+    bool decompress;
+    std::mutex error_lock;
+    evx_status error;
+} pipeline_context;
+
+/* The models of a single coder thread, allocated once and reset for every chunk. */
+class chunk_coder
+{
+    entropy_coder coder;
+    hashed_byte_coder hashed;
+    match_model matcher;
+    std::vector<entropy_context> contexts;
+    bool direct;
+
+private:
+
+    void reset_contexts();
+
+    evx_status encode_direct(bitstream *source, bitstream *dest);
+    evx_status decode_direct(uint32 byte_count, bitstream *source, bitstream *dest);
+
+public:
+
+    explicit chunk_coder(const level_setting &setting);
+
+    evx_status create(const level_setting &setting);
+    evx_status encode(bitstream *source, bitstream *dest);
+    evx_status decode(uint32 byte_count, bitstream *source, bitstream *dest);
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(chunk_coder);
+};
+
+chunk_coder::chunk_coder(const level_setting &setting) : coder(setting.fast_rate, setting.slow_rate), hashed(&coder)
+{
+    direct = false;
+}
+
+evx_status chunk_coder::create(const level_setting &setting)
+{
+    direct = (0 == setting.bucket_bits);
+
+    if (direct)
+    {
+        contexts.resize(EVX_DIRECT_CONTEXT_COUNT);
+        return EVX_SUCCESS;
+    }
+
+    if (EVX_SUCCESS != hashed.create(setting.order, setting.bucket_bits))
+    {
+        return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+    }
+
+    if (setting.window_bits)
+    {
+        if (EVX_SUCCESS != matcher.create(setting.window_bits, setting.window_bits - 2, EVX_MATCH_PREDICT_LENGTH))
+        {
+            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+        }
+
+        hashed.attach_match_model(&matcher);
+    }
+
+    return EVX_SUCCESS;
+}
+
+void chunk_coder::reset_contexts()
+{
+    for (uint32 i = 0; i < contexts.size(); ++i)
+    {
+        coder.init_context(&contexts[i]);
+    }
+}
+
+/* Each byte is coded as a bit tree, with the tree of every previous byte value held
+   in its own 256 contexts. */
+evx_status chunk_coder::encode_direct(bitstream *source, bitstream *dest)
+{
+    uint32 previous = 0;
+
+    reset_contexts();
+    coder.clear();
+
+    while (!source->is_empty())
+    {
+        uint8 value = 0;
+        uint32 node = 1;
+
+        if (EVX_SUCCESS != source->read_byte(&value))
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        for (int32 i = 7; i >= 0; --i)
+        {
+            uint8 bit = (value >> i) & 0x1;
+
+            if (EVX_SUCCESS != coder.encode_bin(bit, &contexts[(previous << 8) | node], dest))
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            node = (node << 1) | bit;
+        }
+
+        previous = value;
+    }
+
+    return coder.finish_encode(dest);
+}
+
+evx_status chunk_coder::decode_direct(uint32 byte_count, bitstream *source, bitstream *dest)
+{
+    uint32 previous = 0;
+
+    reset_contexts();
+
+    if (EVX_SUCCESS != coder.start_decode(source))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    for (uint32 i = 0; i < byte_count; ++i)
+    {
+        uint32 node = 1;
+
+        for (uint32 j = 0; j < 8; ++j)
+        {
+            uint8 bit = 0;
+
+            if (EVX_SUCCESS != coder.decode_bin(&contexts[(previous << 8) | node], source, &bit))
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            node = (node << 1) | bit;
+        }
+
+        previous = node & 0xFF;
+
+        if (EVX_SUCCESS != dest->write_byte((uint8) previous))
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status chunk_coder::encode(bitstream *source, bitstream *dest)
+{
+    return (direct ? encode_direct(source, dest) : hashed.encode(source, dest));
+}
+
+evx_status chunk_coder::decode(uint32 byte_count, bitstream *source, bitstream *dest)
+{
+    return (direct ? decode_direct(byte_count, source, dest) : hashed.decode(byte_count, source, dest));
+}
+
+static void report_error(pipeline_context *context, evx_status error)
+{
+    std::unique_lock<std::mutex> guard(context->error_lock);
+
+    if (EVX_SUCCESS == context->error)
+    {
+        context->error = error;
+    }
+}
+
+static bool has_failed(pipeline_context *context)
+{
+    std::unique_lock<std::mutex> guard(context->error_lock);
+    return EVX_SUCCESS != context->error;
+}
+
+static evx_status compress_chunk(chunk_coder *coder, chunk_job *job)
+{
+    std::vector<uint8> coded;
+    vector_sink coded_sink(&coded);
+    bitstream source;
+    bitstream staging(EVX_STAGING_SIZE << 3);
+    staging.attach_sink(&coded_sink);
+
+    if (EVX_SUCCESS != source.wrap(&job->data[0], job->raw_size) ||
+        EVX_SUCCESS != coder->encode(&source, &staging) ||
+        EVX_SUCCESS != staging.flush_sink(true))
+    {
+        return EVX_ERROR_EXECUTION_FAILURE;
+    }
+
+    /* Incompressible chunks are stored as is. */
+    if (coded.size() < job->raw_size)
+    {
+        job->data.swap(coded);
+        job->mode = EVX_CHUNK_MODE_CODED;
+    }
+    else
+    {
+        job->mode = EVX_CHUNK_MODE_STORED;
+    }
+
+    return EVX_SUCCESS;
+}
+
+static evx_status decompress_chunk(chunk_coder *coder, chunk_job *job)
+{
+    if (EVX_CHUNK_MODE_STORED == job->mode)
+    {
+        return (job->data.size() == job->raw_size ? EVX_SUCCESS : EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    if (job->data.empty())
+    {
+        return EVX_ERROR_INVALID_RESOURCE;
+    }
+
+    bitstream source;
+    bitstream dest(job->raw_size << 3);
+
+    if (EVX_SUCCESS != source.wrap(&job->data[0], (uint32) job->data.size()) ||
+        EVX_SUCCESS != coder->decode(job->raw_size, &source, &dest))
+    {
+        return EVX_ERROR_EXECUTION_FAILURE;
+    }
+
+    job->data.assign(dest.query_data(), dest.query_data() + job->raw_size);
+
+    return EVX_SUCCESS;
+}
+
+static void reader_stage(pipeline_context *context, job_queue *jobs)
+{
+    for (uint64 index = 0; !has_failed(context); ++index)
+    {
+        chunk_job *job = new chunk_job;
+        job->index = index;
+        job->mode = EVX_CHUNK_MODE_CODED;
+
+        if (context->decompress)
+        {
+            uint8 header[EVX_CHUNK_HEADER_SIZE];
+
+            if (EVX_CHUNK_HEADER_SIZE != fread(header, 1, EVX_CHUNK_HEADER_SIZE, context->input))
+            {
+                report_error(context, EVX_ERROR_INVALID_RESOURCE);
+                delete job;
+                break;
+            }
+
+            job->raw_size = load_u32(header);
+            job->mode = header[8];
+
+            uint32 coded_size = load_u32(header + 4);
+
+            if (0 == job->raw_size)
+            {
+                delete job;
+                break;
+            }
+
+            if (job->raw_size > context->chunk_size || coded_size > context->chunk_size)
+            {
+                report_error(context, EVX_ERROR_INVALID_RESOURCE);
+                delete job;
+                break;
+            }
+
+            job->data.resize(coded_size);
+
+            if (coded_size && coded_size != fread(&job->data[0], 1, coded_size, context->input))
+            {
+                report_error(context, EVX_ERROR_IO_FAILURE);
+                delete job;
+                break;
+            }
+        }
+        else
+        {
+            job->data.resize(context->chunk_size);
+            job->raw_size = (uint32) fread(&job->data[0], 1, context->chunk_size, context->input);
+
+            if (0 == job->raw_size)
+            {
+                delete job;
+                break;
+            }
+
+            job->data.resize(job->raw_size);
+        }
+
+        jobs->push(job);
+    }
+
+    jobs->close();
+}
+
+static void coder_stage(pipeline_context *context, job_queue *jobs, ordered_queue *results)
+{
+    const level_setting &setting = level_settings[context->level - 1];
+    chunk_coder coder(setting);
+
+    if (EVX_SUCCESS != coder.create(setting))
+    {
+        report_error(context, EVX_ERROR_EXECUTION_FAILURE);
+    }
+
+    while (chunk_job *job = jobs->pop())
+    {
+        evx_status result = EVX_SUCCESS;
+
+        if (!has_failed(context))
+        {
+            result = (context->decompress ? decompress_chunk(&coder, job) : compress_chunk(&coder, job));
+        }
+
+        if (EVX_SUCCESS != result)
+        {
+            report_error(context, result);
+        }
+
+        results->push(job);
+    }
+
+    results->producer_done();
+}
+
+static void writer_stage(pipeline_context *context, ordered_queue *results)
+{
+    while (chunk_job *job = results->pop())
+    {
+        if (!has_failed(context))
+        {
+            if (!context->decompress)
+            {
+                uint8 header[EVX_CHUNK_HEADER_SIZE];
+                store_u32(header, job->raw_size);
+                store_u32(header + 4, (uint32) job->data.size());
+                header[8] = job->mode;
+
+                if (EVX_CHUNK_HEADER_SIZE != fwrite(header, 1, EVX_CHUNK_HEADER_SIZE, context->output))
+                {
+                    report_error(context, EVX_ERROR_IO_FAILURE);
+                }
+            }
+
+            if (!job->data.empty() && job->data.size() != fwrite(&job->data[0], 1, job->data.size(), context->output))
+            {
+                report_error(context, EVX_ERROR_IO_FAILURE);
+            }
+        }
+
+        delete job;
+    }
+
+    if (!context->decompress && !has_failed(context))
+    {
+        uint8 terminator[EVX_CHUNK_HEADER_SIZE] = { 0 };
+
+        if (EVX_CHUNK_HEADER_SIZE != fwrite(terminator, 1, EVX_CHUNK_HEADER_SIZE, context->output))
+        {
+            report_error(context, EVX_ERROR_IO_FAILURE);
+        }
+    }
+}
+
+static evx_status run_pipeline(pipeline_context *context, uint32 thread_count)
+{
+    job_queue jobs(thread_count << 1);
+    ordered_queue results(thread_count << 1, thread_count);
+    std::vector<std::thread> coders;
+
+    std::thread reader(reader_stage, context, &jobs);
+
+    for (uint32 i = 0; i < thread_count; ++i)
+    {
+        coders.push_back(std::thread(coder_stage, context, &jobs, &results));
+    }
+
+    std::thread writer(writer_stage, context, &results);
+
+    reader.join();
+
+    for (uint32 i = 0; i < thread_count; ++i)
+    {
+        coders[i].join();
+    }
+
+    writer.join();
+
+    if (EVX_SUCCESS == context->error && fflush(context->output))
+    {
+        context->error = EVX_ERROR_IO_FAILURE;
+    }
+
+    return context->error;
+}
+
+static evx_status write_container_header(pipeline_context *context)
+{
+    uint8 header[EVX_CONTAINER_HEADER_SIZE] = { 0 };
+
+    store_u32(header, EVX_CONTAINER_MAGIC);
+    header[4] = EVX_CONTAINER_VERSION;
+    header[5] = (uint8) context->level;
+    store_u32(header + 8, context->chunk_size);
+
+    if (EVX_CONTAINER_HEADER_SIZE != fwrite(header, 1, EVX_CONTAINER_HEADER_SIZE, context->output))
+    {
+        return EVX_ERROR_IO_FAILURE;
+    }
+
+    return EVX_SUCCESS;
+}
+
+static evx_status read_container_header(pipeline_context *context)
+{
+    uint8 header[EVX_CONTAINER_HEADER_SIZE];
+
+    if (EVX_CONTAINER_HEADER_SIZE != fread(header, 1, EVX_CONTAINER_HEADER_SIZE, context->input) ||
+        EVX_CONTAINER_MAGIC != load_u32(header) ||
+        EVX_CONTAINER_VERSION != header[4] ||
+        header[5] < 1 || header[5] > EVX_CONTAINER_MAX_LEVEL)
+    {
+        return EVX_ERROR_INVALID_RESOURCE;
+    }
+
+    context->level = header[5];
+    context->chunk_size = load_u32(header + 8);
+
+    if (context->chunk_size > level_settings[EVX_CONTAINER_MAX_LEVEL - 1].chunk_size)
+    {
+        return EVX_ERROR_INVALID_RESOURCE;
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status compress_container(FILE *input, FILE *output, uint32 level, uint32 thread_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!input || !output || level < 1 || level > EVX_CONTAINER_MAX_LEVEL || 0 == thread_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    pipeline_context context;
+    context.input = input;
+    context.output = output;
+    context.level = level;
+    context.chunk_size = level_settings[level - 1].chunk_size;
+    context.decompress = false;
+    context.error = write_container_header(&context);
+
+    if (EVX_SUCCESS != context.error)
+    {
+        return context.error;
+    }
+
+    return run_pipeline(&context, thread_count);
+}
+
+evx_status decompress_container(FILE *input, FILE *output, uint32 thread_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!input || !output || 0 == thread_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    pipeline_context context;
+    context.input = input;
+    context.output = output;
+    context.decompress = true;
+    context.error = read_container_header(&context);
+
+    if (EVX_SUCCESS != context.error)
+    {
+        return context.error;
+    }
+
+    return run_pipeline(&context, thread_count);
+}
+
+} // namespace evx
@@ -0,0 +1,84 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// container.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_CONTAINER_H__
+#define __EV_CONTAINER_H__
+
+#include "base.h"
+#include <stdio.h>
+
+/*
+// Containers
+//
+// A container holds a file (or pipe) compressed as a sequence of independently coded
+// chunks. Both directions run as a staged pipeline: a reader thread splits the input 
+// into chunks, a pool of coder threads codes chunks independently, and a writer thread
+// emits the results in their original order. All queues between stages are bounded 
+// so that memory use remains flat regardless of input size.
+//
+// The level selects the chunk size and how each chunk is modeled. Lower levels code 
+// bytes through direct contexts selected by the previous byte, middle levels through 
+// hashed contexts of the preceding two to four bytes, and upper levels add a match 
+// model that captures repeats longer than any context order.
+//
+// Container layout (all fields little endian):
+//
+//   [0]   uint32  magic
+//   [4]   uint8   format version
+//   [5]   uint8   level
+//   [6]   uint16  reserved
+//   [8]   uint32  chunk size in bytes
+//
+// followed by chunks of { uint32 raw size, uint32 coded size, uint8 mode, data }
+// and terminated by a chunk with a raw size of zero.
+*/
+
+#define EVX_CONTAINER_MAGIC                     (0x43585645)    // 'EVXC'
+#define EVX_CONTAINER_VERSION                   (2)
+#define EVX_CONTAINER_HEADER_SIZE               (12)
+#define EVX_CONTAINER_DEFAULT_LEVEL             (5)
+#define EVX_CONTAINER_MAX_LEVEL                 (9)
+
+namespace evx {
+
+/* Compresses input until its end, writing a container at level 1 (fastest) through
+   EVX_CONTAINER_MAX_LEVEL (best ratio) to output with thread_count coder threads. */
+evx_status compress_container(FILE *input, FILE *output, uint32 level, uint32 thread_count);
+
+/* Reads a container from input and writes the original bytes to output. */
+evx_status decompress_container(FILE *input, FILE *output, uint32 thread_count);
+
+} // namespace evx
+
+#endif // __EV_CONTAINER_H__
@@ -0,0 +1,88 @@
+
+#include "context.h"
+#include "math.h"
+
+#define EVX_CONTEXT_LINE_COUNT                  ((uint32) (EVX_CACHE_LINE_SIZE / sizeof(entropy_context)))
+
+namespace evx {
+
+context_table::context_table()
+{
+    allocation = 0;
+    contexts = 0;
+    context_count = 0;
+    group_count = 0;
+}
+
+context_table::~context_table()
+{
+    clear();
+}
+
+void context_table::clear()
+{
+    delete [] allocation;
+    allocation = 0;
+    contexts = 0;
+    context_count = 0;
+    group_count = 0;
+}
+
+evx_status context_table::create(const uint32 *group_sizes, uint32 count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!group_sizes || 0 == count || count > EVX_CONTEXT_MAX_GROUPS)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    clear();
+
+    /* Each group is padded to a whole number of cache lines. */
+    uint32 total_count = 0;
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        group_offset[i] = total_count;
+        total_count += align(group_sizes[i], EVX_CONTEXT_LINE_COUNT);
+    }
+
+    total_count = evx_max2(total_count, EVX_CONTEXT_LINE_COUNT);
+    allocation = new uint8[total_count * sizeof(entropy_context) + EVX_CACHE_LINE_SIZE];
+
+    if (!allocation)
+    {
+        return evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(allocation);
+    contexts = reinterpret_cast<entropy_context *>((address + EVX_CACHE_LINE_SIZE - 1) & ~uintptr_t(EVX_CACHE_LINE_SIZE - 1));
+    context_count = total_count;
+    group_count = count;
+
+    reset();
+
+    return EVX_SUCCESS;
+}
+
+void context_table::reset()
+{
+    for (uint32 i = 0; i < context_count; ++i)
+    {
+        contexts[i].state = EVX_CONTEXT_INITIAL_STATE;
+    }
+}
+
+uint32 context_table::query_group_count() const
+{
+    return group_count;
+}
+
+uint32 context_table::query_context_count() const
+{
+    return context_count;
+}
+
+} // namespace evx
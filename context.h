@@ -0,0 +1,106 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// context.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_CONTEXT_H__
+#define __EV_CONTEXT_H__
+
+#include "base.h"
+
+/*
+// Packed Contexts
+//
+// Context models are kept apart from the coding engine: an entropy_coder holds only 
+// the range state, while each context is a packed 16 bit state that callers keep in
+// their own arrays. A state holds a 13 bit probability of a zero along with a 3 bit
+// observation count. The count selects the adaptation shift, moving from the coder's
+// fast rate towards its slow rate as a context gathers observations, so that new
+// contexts learn quickly and settle into a stable estimate. 
+//
+// A context_table stores many contexts in a single cache line aligned allocation,
+// grouped by syntax element. Each group begins on its own cache line, so contexts 
+// that are used together share lines, and selecting a context is an indexed load
+// from its group.
+*/
+
+#define EVX_CONTEXT_COUNT_BITS                  (3)
+#define EVX_CONTEXT_COUNT_MAX                   ((0x1 << EVX_CONTEXT_COUNT_BITS) - 1)
+#define EVX_CONTEXT_PROBABILITY_BITS            (16 - EVX_CONTEXT_COUNT_BITS)
+#define EVX_CONTEXT_PROBABILITY_MAX             (0x1 << EVX_CONTEXT_PROBABILITY_BITS)
+#define EVX_CONTEXT_INITIAL_STATE               ((EVX_CONTEXT_PROBABILITY_MAX >> 1) << EVX_CONTEXT_COUNT_BITS)
+#define EVX_CONTEXT_MAX_GROUPS                  (32)
+
+namespace evx {
+
+typedef struct entropy_context
+{
+    uint16 state;
+} entropy_context;
+
+class context_table
+{
+    uint8 *allocation;
+    entropy_context *contexts;
+    uint32 context_count;
+    uint32 group_count;
+    uint32 group_offset[EVX_CONTEXT_MAX_GROUPS];
+
+public:
+
+    context_table();
+    virtual ~context_table();
+
+    /* Allocates one group per entry of group_sizes and resets every context. */
+    evx_status create(const uint32 *group_sizes, uint32 count);
+    void clear();
+
+    /* Returns all contexts to their initial state. */
+    void reset();
+
+    entropy_context *query_group(uint32 group) const;
+    uint32 query_group_count() const;
+    uint32 query_context_count() const;
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(context_table);
+};
+
+inline entropy_context *context_table::query_group(uint32 group) const
+{
+    return contexts + group_offset[group];
+}
+
+} // namespace evx
+
+#endif // __EV_CONTEXT_H__
@@ -0,0 +1,93 @@
+
+#include "cpu.h"
+#include "math.h"
+
+namespace evx {
+
+static const char *cpu_level_names[EVX_CPU_LEVEL_COUNT] = { "scalar", "sse42", "avx2", "avx512" };
+
+static uint8 detect_cpu_support()
+{
+#if defined (EVX_CPU_X86)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512cd") && __builtin_cpu_supports("avx512vl"))
+    {
+        return EVX_CPU_AVX512;
+    }
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return EVX_CPU_AVX2;
+    }
+
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+    {
+        return EVX_CPU_SSE42;
+    }
+#endif
+
+    return EVX_CPU_SCALAR;
+}
+
+static uint8 detect_cpu_level()
+{
+    uint8 support = query_cpu_support();
+    const char *name = getenv("EVX_CPU");
+
+    if (name)
+    {
+        for (uint8 i = 0; i < EVX_CPU_LEVEL_COUNT; ++i)
+        {
+            if (0 == strcmp(name, cpu_level_names[i]))
+            {
+                return evx_min2(i, support);
+            }
+        }
+    }
+
+    return support;
+}
+
+static uint8 &query_cpu_level_store()
+{
+    static uint8 level = detect_cpu_level();
+    return level;
+}
+
+uint8 query_cpu_support()
+{
+    static const uint8 support = detect_cpu_support();
+    return support;
+}
+
+uint8 query_cpu_level()
+{
+    return query_cpu_level_store();
+}
+
+evx_status force_cpu_level(uint8 level)
+{
+    if (EVX_CPU_AUTO == level)
+    {
+        query_cpu_level_store() = query_cpu_support();
+        return EVX_SUCCESS;
+    }
+
+    if (level > query_cpu_support())
+    {
+        return evx_post_error(EVX_ERROR_NOTIMPL);
+    }
+
+    query_cpu_level_store() = level;
+
+    return EVX_SUCCESS;
+}
+
+const char *query_cpu_level_name(uint8 level)
+{
+    return (level < EVX_CPU_LEVEL_COUNT) ? cpu_level_names[level] : "unknown";
+}
+
+} // namespace evx
@@ -0,0 +1,82 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// cpu.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+#ifndef __EV_CPU_H__
+#define __EV_CPU_H__
+
+#include "base.h"
+
+/*
+// Runtime Dispatch
+//
+// We build a single binary without -march, and our vector kernels are compiled for
+// their instruction sets through target attributes. The processor is queried once, 
+// and each kernel selects the widest variant allowed by the current cpu level:
+//
+//   + Scalar: portable code only.
+//   + SSE4.2: 128 bit kernels and hardware popcnt.
+//   + AVX2: 256 bit kernels.
+//   + AVX-512: 512 bit kernels (requires the F, BW, CD and VL subsets).
+//
+// The level may be forced lower for testing, either through force_cpu_level or by
+// setting the EVX_CPU environment variable to scalar, sse42, avx2 or avx512 before
+// the first query. Forcing is not synchronized with coding in other threads. 
+*/
+
+#define EVX_CPU_SCALAR                          (0)
+#define EVX_CPU_SSE42                           (1)
+#define EVX_CPU_AVX2                            (2)
+#define EVX_CPU_AVX512                          (3)
+#define EVX_CPU_LEVEL_COUNT                     (4)
+#define EVX_CPU_AUTO                            (0xFF)
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+    #define EVX_CPU_X86
+#endif
+
+namespace evx {
+
+/* Returns the widest level supported by the processor. */
+uint8 query_cpu_support();
+
+/* Returns the level our kernels currently use. */
+uint8 query_cpu_level();
+
+/* Forces a level no wider than query_cpu_support, or restores it with EVX_CPU_AUTO. */
+evx_status force_cpu_level(uint8 level);
+
+const char *query_cpu_level_name(uint8 level);
+
+} // namespace evx
+
+#endif // __EV_CPU_H__
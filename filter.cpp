@@ -0,0 +1,855 @@
+
+#include "filter.h"
+#include "cpu.h"
+#include "math.h"
+#include "memory.h"
+#include <algorithm>
+
+#if defined (EVX_CPU_X86)
+    #include "immintrin.h"
+#endif
+
+namespace evx {
+
+static uint64 load_word(const uint8 *source, uint8 word_size)
+{
+    uint64 word = 0;
+
+    for (uint8 i = 0; i < word_size; ++i)
+    {
+        word |= uint64(source[i]) << (i << 3);
+    }
+
+    return word;
+}
+
+static void store_word(uint8 *dest, uint64 word, uint8 word_size)
+{
+    for (uint8 i = 0; i < word_size; ++i)
+    {
+        dest[i] = (word >> (i << 3)) & 0xFF;
+    }
+}
+
+/*
+// Delta Filters
+*/
+
+static void delta_forward(const uint8 *source, uint32 byte_count, uint8 word_size, bool exclusive, uint8 *dest)
+{
+    uint64 mask = (word_size < 8) ? (uint64(0x1) << (word_size << 3)) - 1 : ~uint64(0);
+    uint32 word_bytes = byte_count - (byte_count % word_size);
+    uint64 previous = 0;
+
+    for (uint32 i = 0; i < word_bytes; i += word_size)
+    {
+        uint64 word = load_word(source + i, word_size);
+        store_word(dest + i, (exclusive ? (word ^ previous) : (word - previous)) & mask, word_size);
+        previous = word;
+    }
+
+    memcpy(dest + word_bytes, source + word_bytes, byte_count - word_bytes);
+}
+
+static void delta_inverse(const uint8 *source, uint32 byte_count, uint8 word_size, bool exclusive, uint8 *dest)
+{
+    uint64 mask = (word_size < 8) ? (uint64(0x1) << (word_size << 3)) - 1 : ~uint64(0);
+    uint32 word_bytes = byte_count - (byte_count % word_size);
+    uint64 previous = 0;
+
+    for (uint32 i = 0; i < word_bytes; i += word_size)
+    {
+        uint64 word = load_word(source + i, word_size);
+        previous = (exclusive ? (word ^ previous) : (word + previous)) & mask;
+        store_word(dest + i, previous, word_size);
+    }
+
+    memcpy(dest + word_bytes, source + word_bytes, byte_count - word_bytes);
+}
+
+/*
+// Bit-Plane Transposition
+//
+// Words are first split into byte lanes (byte j of every word), and each lane is
+// then transposed 8 bytes at a time as an 8x8 bit matrix. Plane (7 - b) of a lane
+// holds bit b of each of its bytes, with byte i in bit (i % 8) of plane byte i / 8.
+// Lanes are stored most significant first. Vector kernels transpose 16, 32 or 64 
+// bytes of a lane at a time, using movemask (forward) and a byte compare (inverse).
+*/
+
+static uint64 transpose_bits(uint64 x)
+{
+    /* Transposes the 8x8 bit matrix held in x, where byte i is row i. */
+    uint64 t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+
+    return x;
+}
+
+static void transpose_lane_forward(const uint8 *lane, uint32 start, uint32 count, uint8 *planes)
+{
+    uint32 plane_size = count >> 3;
+
+    for (uint32 i = start; i < count; i += 8)
+    {
+        uint64 x = transpose_bits(load_word(lane + i, 8));
+
+        for (uint32 b = 0; b < 8; ++b)
+        {
+            planes[(7 - b) * plane_size + (i >> 3)] = (x >> (b << 3)) & 0xFF;
+        }
+    }
+}
+
+static void transpose_lane_inverse(const uint8 *planes, uint32 start, uint32 count, uint8 *lane)
+{
+    uint32 plane_size = count >> 3;
+
+    for (uint32 i = start; i < count; i += 8)
+    {
+        uint64 x = 0;
+
+        for (uint32 b = 0; b < 8; ++b)
+        {
+            x |= uint64(planes[(7 - b) * plane_size + (i >> 3)]) << (b << 3);
+        }
+
+        store_word(lane + i, transpose_bits(x), 8);
+    }
+}
+
+#if defined (EVX_CPU_X86)
+
+__attribute__((target("sse4.2")))
+static uint32 transpose_lane_forward_sse42(const uint8 *lane, uint32 count, uint8 *planes)
+{
+    uint32 plane_size = count >> 3;
+    uint32 vector_count = count & ~15u;
+
+    for (uint32 i = 0; i < vector_count; i += 16)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lane + i));
+
+        for (uint32 plane = 0; plane < 8; ++plane)
+        {
+            uint16 mask = (uint16) _mm_movemask_epi8(x);
+            memcpy(planes + plane * plane_size + (i >> 3), &mask, 2);
+            x = _mm_add_epi8(x, x);
+        }
+    }
+
+    return vector_count;
+}
+
+__attribute__((target("sse4.2")))
+static uint32 transpose_lane_inverse_sse42(const uint8 *planes, uint32 count, uint8 *lane)
+{
+    uint32 plane_size = count >> 3;
+    uint32 vector_count = count & ~15u;
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i select = _mm_set1_epi64x(0x8040201008040201LL);
+
+    for (uint32 i = 0; i < vector_count; i += 16)
+    {
+        __m128i x = _mm_setzero_si128();
+
+        for (uint32 plane = 0; plane < 8; ++plane)
+        {
+            uint16 mask = 0;
+            memcpy(&mask, planes + plane * plane_size + (i >> 3), 2);
+
+            __m128i bits = _mm_shuffle_epi8(_mm_set1_epi16((int16) mask), spread);
+            bits = _mm_cmpeq_epi8(_mm_and_si128(bits, select), select);
+            x = _mm_or_si128(x, _mm_and_si128(bits, _mm_set1_epi8((int8) (0x80 >> plane))));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lane + i), x);
+    }
+
+    return vector_count;
+}
+
+__attribute__((target("avx2")))
+static uint32 transpose_lane_forward_avx2(const uint8 *lane, uint32 count, uint8 *planes)
+{
+    uint32 plane_size = count >> 3;
+    uint32 vector_count = count & ~31u;
+
+    for (uint32 i = 0; i < vector_count; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lane + i));
+
+        /* Each movemask gathers the current top bit of all 32 bytes, then we shift the
+           next bit into place. */
+        for (uint32 plane = 0; plane < 8; ++plane)
+        {
+            uint32 mask = (uint32) _mm256_movemask_epi8(x);
+            memcpy(planes + plane * plane_size + (i >> 3), &mask, 4);
+            x = _mm256_add_epi8(x, x);
+        }
+    }
+
+    return vector_count;
+}
+
+__attribute__((target("avx2")))
+static uint32 transpose_lane_inverse_avx2(const uint8 *planes, uint32 count, uint8 *lane)
+{
+    uint32 plane_size = count >> 3;
+    uint32 vector_count = count & ~31u;
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i select = _mm256_set1_epi64x(0x8040201008040201LL);
+
+    for (uint32 i = 0; i < vector_count; i += 32)
+    {
+        __m256i x = _mm256_setzero_si256();
+
+        /* Each plane word is spread so that byte k holds the plane bit of byte k. */
+        for (uint32 plane = 0; plane < 8; ++plane)
+        {
+            uint32 mask = 0;
+            memcpy(&mask, planes + plane * plane_size + (i >> 3), 4);
+
+            __m256i bits = _mm256_shuffle_epi8(_mm256_set1_epi32((int32) mask), spread);
+            bits = _mm256_cmpeq_epi8(_mm256_and_si256(bits, select), select);
+            x = _mm256_or_si256(x, _mm256_and_si256(bits, _mm256_set1_epi8((int8) (0x80 >> plane))));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lane + i), x);
+    }
+
+    return vector_count;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static uint32 transpose_lane_forward_avx512(const uint8 *lane, uint32 count, uint8 *planes)
+{
+    uint32 plane_size = count >> 3;
+    uint32 vector_count = count & ~63u;
+
+    for (uint32 i = 0; i < vector_count; i += 64)
+    {
+        __m512i x = _mm512_loadu_si512(lane + i);
+
+        for (uint32 plane = 0; plane < 8; ++plane)
+        {
+            uint64 mask = (uint64) _mm512_movepi8_mask(x);
+            memcpy(planes + plane * plane_size + (i >> 3), &mask, 8);
+            x = _mm512_add_epi8(x, x);
+        }
+    }
+
+    return vector_count;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static uint32 transpose_lane_inverse_avx512(const uint8 *planes, uint32 count, uint8 *lane)
+{
+    uint32 plane_size = count >> 3;
+    uint32 vector_count = count & ~63u;
+
+    for (uint32 i = 0; i < vector_count; i += 64)
+    {
+        __m512i x = _mm512_setzero_si512();
+
+        /* Mask registers expand plane bits to bytes directly. */
+        for (uint32 plane = 0; plane < 8; ++plane)
+        {
+            uint64 mask = 0;
+            memcpy(&mask, planes + plane * plane_size + (i >> 3), 8);
+            x = _mm512_mask_blend_epi8((__mmask64) mask, x, _mm512_or_si512(x, _mm512_set1_epi8((char) (0x80 >> plane))));
+        }
+
+        _mm512_storeu_si512(lane + i, x);
+    }
+
+    return vector_count;
+}
+
+#endif
+
+static uint32 transpose_lane_vector(const uint8 *source, uint32 count, bool inverse, uint8 *dest)
+{
+#if defined (EVX_CPU_X86)
+    switch (query_cpu_level())
+    {
+        case EVX_CPU_AVX512: return inverse ? transpose_lane_inverse_avx512(source, count, dest) : transpose_lane_forward_avx512(source, count, dest);
+        case EVX_CPU_AVX2: return inverse ? transpose_lane_inverse_avx2(source, count, dest) : transpose_lane_forward_avx2(source, count, dest);
+        case EVX_CPU_SSE42: return inverse ? transpose_lane_inverse_sse42(source, count, dest) : transpose_lane_forward_sse42(source, count, dest);
+    }
+#endif
+
+    return 0;
+}
+
+static void transpose_lane(const uint8 *source, uint32 count, bool inverse, uint8 *dest)
+{
+    uint32 start = transpose_lane_vector(source, count, inverse, dest);
+
+    if (inverse)
+    {
+        transpose_lane_inverse(source, start, count, dest);
+    }
+    else
+    {
+        transpose_lane_forward(source, start, count, dest);
+    }
+}
+
+static void bit_plane_forward(const uint8 *source, uint32 byte_count, uint8 word_size, uint8 *dest)
+{
+    uint32 word_count = (byte_count / word_size) & ~7u;
+    uint32 plane_bytes = word_count * word_size;
+    std::vector<uint8> lanes(word_size > 1 ? plane_bytes : 0);
+    const uint8 *lane_data = source;
+
+    if (word_size > 1)
+    {
+        for (uint32 i = 0; i < word_count; ++i)
+        {
+            for (uint8 j = 0; j < word_size; ++j)
+            {
+                lanes[j * word_count + i] = source[i * word_size + j];
+            }
+        }
+
+        lane_data = lanes.data();
+    }
+
+    for (uint8 j = 0; j < word_size; ++j)
+    {
+        transpose_lane(lane_data + j * word_count, word_count, false, dest + (word_size - 1 - j) * word_count);
+    }
+
+    memcpy(dest + plane_bytes, source + plane_bytes, byte_count - plane_bytes);
+}
+
+static void bit_plane_inverse(const uint8 *source, uint32 byte_count, uint8 word_size, uint8 *dest)
+{
+    uint32 word_count = (byte_count / word_size) & ~7u;
+    uint32 plane_bytes = word_count * word_size;
+    std::vector<uint8> lanes(word_size > 1 ? plane_bytes : 0);
+    uint8 *lane_data = (word_size > 1) ? lanes.data() : dest;
+
+    for (uint8 j = 0; j < word_size; ++j)
+    {
+        transpose_lane(source + (word_size - 1 - j) * word_count, word_count, true, lane_data + j * word_count);
+    }
+
+    if (word_size > 1)
+    {
+        for (uint32 i = 0; i < word_count; ++i)
+        {
+            for (uint8 j = 0; j < word_size; ++j)
+            {
+                dest[i * word_size + j] = lanes[j * word_count + i];
+            }
+        }
+    }
+
+    memcpy(dest + plane_bytes, source + plane_bytes, byte_count - plane_bytes);
+}
+
+/*
+// Block Sorting
+//
+// Each block is sorted as a set of cyclic rotations by prefix doubling with counting
+// sorts, in O(n log n). The primary index is the rank of the unrotated block. Equal
+// rotations (of periodic blocks) may be ranked in any order, since the inverse then
+// simply repeats the period.
+*/
+
+static uint32 sort_rotations(const uint8 *source, uint32 count, uint8 *dest)
+{
+    std::vector<uint32> order(count), rank(count), next_order(count), next_rank(count);
+    std::vector<uint32> bucket(evx_max2(count, 256u), 0);
+    uint32 class_count = 1;
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        bucket[source[i]]++;
+    }
+
+    for (uint32 i = 1; i < 256; ++i)
+    {
+        bucket[i] += bucket[i - 1];
+    }
+
+    for (uint32 i = count; i-- > 0;)
+    {
+        order[--bucket[source[i]]] = i;
+    }
+
+    rank[order[0]] = 0;
+
+    for (uint32 i = 1; i < count; ++i)
+    {
+        class_count += (source[order[i]] != source[order[i - 1]]);
+        rank[order[i]] = class_count - 1;
+    }
+
+    /* Rotations are ordered by their first length symbols, which we double each pass
+       by sorting on the rank of their second half (already in order) then their first. */
+    for (uint32 length = 1; length < count && class_count < count; length <<= 1)
+    {
+        for (uint32 i = 0; i < count; ++i)
+        {
+            next_order[i] = (order[i] >= length) ? order[i] - length : order[i] + count - length;
+        }
+
+        std::fill(bucket.begin(), bucket.begin() + class_count, 0);
+
+        for (uint32 i = 0; i < count; ++i)
+        {
+            bucket[rank[next_order[i]]]++;
+        }
+
+        for (uint32 i = 1; i < class_count; ++i)
+        {
+            bucket[i] += bucket[i - 1];
+        }
+
+        for (uint32 i = count; i-- > 0;)
+        {
+            order[--bucket[rank[next_order[i]]]] = next_order[i];
+        }
+
+        next_rank[order[0]] = 0;
+        class_count = 1;
+
+        for (uint32 i = 1; i < count; ++i)
+        {
+            uint32 current = order[i];
+            uint32 previous = order[i - 1];
+            uint32 current_half = (current + length) % count;
+            uint32 previous_half = (previous + length) % count;
+
+            class_count += (rank[current] != rank[previous] || rank[current_half] != rank[previous_half]);
+            next_rank[current] = class_count - 1;
+        }
+
+        rank.swap(next_rank);
+    }
+
+    uint32 primary_index = 0;
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        dest[i] = source[(order[i] + count - 1) % count];
+        primary_index = order[i] ? primary_index : i;
+    }
+
+    return primary_index;
+}
+
+static void unsort_rotations(const uint8 *source, uint32 count, uint32 primary_index, uint8 *dest)
+{
+    std::vector<uint32> next(count);
+    uint32 bucket[256] = { 0 };
+    uint32 start = 0;
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        bucket[source[i]]++;
+    }
+
+    for (uint32 i = 0; i < 256; ++i)
+    {
+        uint32 symbol_count = bucket[i];
+        bucket[i] = start;
+        start += symbol_count;
+    }
+
+    /* The k-th occurrence of a symbol in the first column is the k-th in the last. */
+    for (uint32 i = 0; i < count; ++i)
+    {
+        next[bucket[source[i]]++] = i;
+    }
+
+    uint32 row = next[primary_index];
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        dest[i] = source[row];
+        row = next[row];
+    }
+}
+
+static void move_to_front(uint8 *data, uint32 count, bool inverse)
+{
+    uint8 order[256];
+
+    for (uint32 i = 0; i < 256; ++i)
+    {
+        order[i] = (uint8) i;
+    }
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        uint8 symbol = data[i];
+        uint8 index = symbol;
+
+        if (inverse)
+        {
+            symbol = order[index];
+        }
+        else
+        {
+            index = 0;
+
+            while (order[index] != symbol)
+            {
+                index++;
+            }
+        }
+
+        memmove(order + 1, order, index);
+        order[0] = symbol;
+        data[i] = inverse ? symbol : index;
+    }
+}
+
+static void bwt_mtf_forward(const uint8 *source, uint32 byte_count, std::vector<uint8> *dest)
+{
+    uint32 block_count = (byte_count + EVX_FILTER_BWT_BLOCK_SIZE - 1) / EVX_FILTER_BWT_BLOCK_SIZE;
+    uint8 *output = 0;
+
+    dest->resize(byte_count + (block_count << 2));
+    output = dest->data();
+
+    for (uint32 i = 0; i < byte_count; i += EVX_FILTER_BWT_BLOCK_SIZE)
+    {
+        uint32 block_size = evx_min2(EVX_FILTER_BWT_BLOCK_SIZE, byte_count - i);
+
+        store_u32(output, sort_rotations(source + i, block_size, output + 4));
+        move_to_front(output + 4, block_size, false);
+        output += block_size + 4;
+    }
+}
+
+static uint64 query_filtered_size(const uint8 *stages, uint8 stage_count, uint64 byte_count)
+{
+    /* Only block sorting changes the size of a stream, adding a primary index per block. */
+    for (uint8 i = 0; i < stage_count; ++i)
+    {
+        if (EVX_FILTER_BWT_MTF == stages[i])
+        {
+            byte_count += ((byte_count + EVX_FILTER_BWT_BLOCK_SIZE - 1) / EVX_FILTER_BWT_BLOCK_SIZE) << 2;
+        }
+    }
+
+    return byte_count;
+}
+
+static evx_status bwt_mtf_inverse(const uint8 *source, uint32 byte_count, std::vector<uint8> *dest)
+{
+    std::vector<uint8> block(evx_min2(byte_count, EVX_FILTER_BWT_BLOCK_SIZE));
+
+    dest->clear();
+
+    while (byte_count)
+    {
+        if (byte_count <= 4)
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        uint32 block_size = evx_min2(EVX_FILTER_BWT_BLOCK_SIZE, byte_count - 4);
+        uint32 primary_index = load_u32(source);
+
+        if (primary_index >= block_size)
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        memcpy(block.data(), source + 4, block_size);
+        move_to_front(block.data(), block_size, true);
+
+        dest->resize(dest->size() + block_size);
+        unsort_rotations(block.data(), block_size, primary_index, dest->data() + dest->size() - block_size);
+
+        source += block_size + 4;
+        byte_count -= block_size + 4;
+    }
+
+    return EVX_SUCCESS;
+}
+
+/*
+// Stream Filter
+*/
+
+stream_filter::stream_filter()
+{
+    clear();
+}
+
+void stream_filter::clear()
+{
+    memset(stages, EVX_FILTER_NONE, sizeof(stages));
+    stage_count = 0;
+    word_size = 1;
+}
+
+evx_status stream_filter::add_stage(uint8 stage)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (EVX_FILTER_NONE == stage || stage >= EVX_FILTER_STAGE_TYPES)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (stage_count >= EVX_FILTER_MAX_STAGES)
+    {
+        return evx_post_error(EVX_ERROR_CAPACITY_LIMIT);
+    }
+
+    stages[stage_count++] = stage;
+
+    return EVX_SUCCESS;
+}
+
+evx_status stream_filter::set_word_size(uint8 size)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (0 == size || size > EVX_FILTER_MAX_WORD_SIZE || (size & (size - 1)))
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    word_size = size;
+
+    return EVX_SUCCESS;
+}
+
+uint8 stream_filter::query_stage_count() const
+{
+    return stage_count;
+}
+
+uint8 stream_filter::query_stage(uint8 index) const
+{
+    return (index < stage_count) ? stages[index] : EVX_FILTER_NONE;
+}
+
+uint8 stream_filter::query_word_size() const
+{
+    return word_size;
+}
+
+evx_status stream_filter::forward(const uint8 *source, uint32 byte_count, std::vector<uint8> *dest) const
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if ((!source && byte_count) || !dest)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    std::vector<uint8> scratch;
+
+    dest->assign(source, source + byte_count);
+
+    for (uint8 i = 0; i < stage_count; ++i)
+    {
+        scratch.resize(dest->size());
+
+        switch (stages[i])
+        {
+            case EVX_FILTER_DELTA: delta_forward(dest->data(), byte_count, word_size, false, scratch.data()); break;
+            case EVX_FILTER_XOR_DELTA: delta_forward(dest->data(), byte_count, word_size, true, scratch.data()); break;
+            case EVX_FILTER_BIT_PLANE: bit_plane_forward(dest->data(), byte_count, word_size, scratch.data()); break;
+            case EVX_FILTER_BWT_MTF: bwt_mtf_forward(dest->data(), byte_count, &scratch); break;
+            default: return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        dest->swap(scratch);
+        byte_count = (uint32) dest->size();
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status stream_filter::inverse(const uint8 *source, uint32 byte_count, std::vector<uint8> *dest) const
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if ((!source && byte_count) || !dest)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    std::vector<uint8> scratch;
+
+    dest->assign(source, source + byte_count);
+
+    for (uint8 i = stage_count; i-- > 0;)
+    {
+        scratch.resize(dest->size());
+
+        switch (stages[i])
+        {
+            case EVX_FILTER_DELTA: delta_inverse(dest->data(), byte_count, word_size, false, scratch.data()); break;
+            case EVX_FILTER_XOR_DELTA: delta_inverse(dest->data(), byte_count, word_size, true, scratch.data()); break;
+            case EVX_FILTER_BIT_PLANE: bit_plane_inverse(dest->data(), byte_count, word_size, scratch.data()); break;
+            case EVX_FILTER_BWT_MTF:
+            {
+                if (EVX_SUCCESS != bwt_mtf_inverse(dest->data(), byte_count, &scratch))
+                {
+                    return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+                }
+            } break;
+            default: return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        dest->swap(scratch);
+        byte_count = (uint32) dest->size();
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status stream_filter::encode(entropy_coder *coder, bitstream *source, bitstream *dest) const
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!coder || !source || !dest || (source->query_occupancy() & 0x7))
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint32 byte_count = source->query_occupancy() >> 3;
+
+    if (query_filtered_size(stages, stage_count, byte_count) >= EVX_FILTER_MAX_BYTE_COUNT)
+    {
+        return evx_post_error(EVX_ERROR_CAPACITY_LIMIT);
+    }
+
+    std::vector<uint8> input(byte_count);
+    std::vector<uint8> filtered;
+    uint8 header[EVX_FILTER_HEADER_SIZE] = { 0 };
+    bitstream view;
+
+    if ((byte_count && EVX_SUCCESS != source->read_bytes(input.data(), &byte_count)) ||
+        EVX_SUCCESS != forward(input.data(), byte_count, &filtered))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    header[0] = stage_count;
+    header[1] = word_size;
+    memcpy(header + 2, stages, stage_count);
+    store_u32(header + 8, byte_count);
+    store_u32(header + 12, (uint32) filtered.size());
+
+    if (EVX_SUCCESS != dest->write_bytes(header, EVX_FILTER_HEADER_SIZE))
+    {
+        return evx_post_error(EVX_ERROR_CAPACITY_LIMIT);
+    }
+
+    if (filtered.empty())
+    {
+        return EVX_SUCCESS;
+    }
+
+    if (EVX_SUCCESS != view.wrap(filtered.data(), (uint32) filtered.size()) ||
+        EVX_SUCCESS != coder->encode(&view, dest))
+    {
+        return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status stream_filter::decode(entropy_coder *coder, bitstream *source, bitstream *dest)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!coder || !source || !dest)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint8 header[EVX_FILTER_HEADER_SIZE];
+    uint32 byte_count = EVX_FILTER_HEADER_SIZE;
+
+    if (source->query_occupancy() < (EVX_FILTER_HEADER_SIZE << 3) ||
+        EVX_SUCCESS != source->read_bytes(header, &byte_count))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    clear();
+
+    if (header[0] > EVX_FILTER_MAX_STAGES || 0 == header[1] || 
+        header[1] > EVX_FILTER_MAX_WORD_SIZE || (header[1] & (header[1] - 1)))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    word_size = header[1];
+
+    for (uint8 i = 0; i < header[0]; ++i)
+    {
+        if (EVX_FILTER_NONE == header[2 + i] || header[2 + i] >= EVX_FILTER_STAGE_TYPES)
+        {
+            clear();
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        stages[stage_count++] = header[2 + i];
+    }
+
+    uint32 original_count = load_u32(header + 8);
+    uint32 filtered_count = load_u32(header + 12);
+    std::vector<uint8> output;
+
+    /* Counts are validated against our chain before anything is allocated, so a 
+       corrupt header cannot force a huge allocation or wrap our symbol count. */
+    if (filtered_count >= EVX_FILTER_MAX_BYTE_COUNT ||
+        filtered_count != query_filtered_size(stages, stage_count, original_count))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    if (0 == filtered_count)
+    {
+        return EVX_SUCCESS;
+    }
+
+    /* Each coded symbol yields a single bit, so we decode straight into a view. */
+    std::vector<uint8> filtered(filtered_count);
+    bitstream view;
+
+    if (EVX_SUCCESS != view.wrap(filtered.data(), filtered_count))
+    {
+        return evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    view.empty();
+
+    if (EVX_SUCCESS != coder->decode(filtered_count << 3, source, &view) ||
+        EVX_SUCCESS != inverse(filtered.data(), filtered_count, &output) ||
+        output.size() != original_count ||
+        EVX_SUCCESS != dest->write_bytes(output.data(), original_count))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    return EVX_SUCCESS;
+}
+
+} // namespace evx
@@ -0,0 +1,123 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// filter.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+#ifndef __EV_FILTER_H__
+#define __EV_FILTER_H__
+
+#include "cabac.h"
+#include <vector>
+
+/*
+// Pre-Filters
+//
+// Our coder sees bytes as a flat sequence of bits, which hides the structure of 
+// numeric data. A stream_filter applies a chain of up to EVX_FILTER_MAX_STAGES 
+// reversible transforms to a byte stream ahead of entropy coding. Stages are applied 
+// in the order they are added, and inverted in reverse order:
+//
+//   + Delta replaces each word with its difference from the previous word.
+//   + XOR delta replaces each word with its exclusive or with the previous word.
+//   + Bit-plane transposition gathers bit b of every word into a contiguous plane, 
+//     most significant plane first. Planes of slowly varying data are long runs.
+//   + BWT+MTF block sorts each EVX_FILTER_BWT_BLOCK_SIZE block of bytes and move to
+//     front codes the result. Each block is preceded by its uint32 primary index.
+//
+// Words are word_size (1, 2, 4 or 8) bytes, little endian. Trailing bytes that do not
+// fill a word (or, for bit planes, a group of 8 words) pass through unchanged.
+//
+// Filtered streams begin with a header that records the chain, so a decoder 
+// configures itself from the stream. All fields are little endian:
+//
+//   [0]   uint8   stage count
+//   [1]   uint8   word size
+//   [2]   uint8   stage identifiers, in order of application
+//   [8]   uint32  byte count
+//   [12]  uint32  filtered byte count (the number of coded bytes)
+//         coded stream.
+//
+// Filtered streams are coded one symbol per bit, so they are limited to fewer than
+// EVX_FILTER_MAX_BYTE_COUNT bytes.
+*/
+
+#define EVX_FILTER_NONE                         (0)
+#define EVX_FILTER_DELTA                        (1)
+#define EVX_FILTER_XOR_DELTA                    (2)
+#define EVX_FILTER_BIT_PLANE                    (3)
+#define EVX_FILTER_BWT_MTF                      (4)
+#define EVX_FILTER_STAGE_TYPES                  (5)
+
+#define EVX_FILTER_MAX_STAGES                   (6)
+#define EVX_FILTER_MAX_WORD_SIZE                (8)
+#define EVX_FILTER_HEADER_SIZE                  (16)
+#define EVX_FILTER_MAX_BYTE_COUNT               (0x20000000)
+#define EVX_FILTER_BWT_BLOCK_SIZE               (256 * EVX_KB)
+
+namespace evx {
+
+class stream_filter
+{
+    uint8 stages[EVX_FILTER_MAX_STAGES];
+    uint8 stage_count;
+    uint8 word_size;
+
+public:
+
+    stream_filter();
+
+    /* Removes every stage and restores a word size of one byte. */
+    void clear();
+    evx_status add_stage(uint8 stage);
+    evx_status set_word_size(uint8 size);
+
+    uint8 query_stage_count() const;
+    uint8 query_stage(uint8 index) const;
+    uint8 query_word_size() const;
+
+    /* Applies (or inverts) our chain over a byte buffer. */
+    evx_status forward(const uint8 *source, uint32 byte_count, std::vector<uint8> *dest) const;
+    evx_status inverse(const uint8 *source, uint32 byte_count, std::vector<uint8> *dest) const;
+
+    /* Encoding filters every remaining (whole) byte of source and writes the header
+       and the coded stream to dest. Decoding reads the header, adopts its chain and 
+       word size, and writes the original bytes to dest. */
+    evx_status encode(entropy_coder *coder, bitstream *source, bitstream *dest) const;
+    evx_status decode(entropy_coder *coder, bitstream *source, bitstream *dest);
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(stream_filter);
+};
+
+} // namespace evx
+
+#endif // __EV_FILTER_H__
@@ -0,0 +1,333 @@
+
+#include "hashed.h"
+#include "match.h"
+
+#define EVX_HASHED_MULTIPLIER                   (0x9E3779B97F4A7C15ULL)
+
+namespace evx {
+
+hashed_context_table::hashed_context_table()
+{
+    allocation = 0;
+    buckets = 0;
+    bucket_count = 0;
+}
+
+hashed_context_table::~hashed_context_table()
+{
+    clear();
+}
+
+void hashed_context_table::clear()
+{
+    delete [] allocation;
+    allocation = 0;
+    buckets = 0;
+    bucket_count = 0;
+}
+
+evx_status hashed_context_table::create(uint8 bucket_bits)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (0 == bucket_bits || bucket_bits > EVX_HASHED_MAX_BUCKET_BITS)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    clear();
+
+    uint32 count = 0x1 << bucket_bits;
+    allocation = new uint8[count * sizeof(hashed_bucket) + EVX_CACHE_LINE_SIZE];
+
+    if (!allocation)
+    {
+        return evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(allocation);
+    buckets = reinterpret_cast<hashed_bucket *>((address + EVX_CACHE_LINE_SIZE - 1) & ~uintptr_t(EVX_CACHE_LINE_SIZE - 1));
+    bucket_count = count;
+
+    reset();
+
+    return EVX_SUCCESS;
+}
+
+void hashed_context_table::reset()
+{
+    /* Empty slots hold a zero checksum and no observations, so they are the first to
+       be replaced and behave exactly like a freshly replaced slot if matched. */
+    for (uint32 i = 0; i < bucket_count; ++i)
+    {
+        for (uint32 j = 0; j < EVX_HASHED_BUCKET_SLOTS; ++j)
+        {
+            hashed_slot *slot = &buckets[i].slots[j];
+            slot->checksum = 0;
+
+            for (uint32 k = 0; k < EVX_HASHED_SLOT_CONTEXTS; ++k)
+            {
+                slot->contexts[k].state = EVX_CONTEXT_INITIAL_STATE;
+            }
+        }
+    }
+}
+
+void hashed_context_table::prefetch(uint64 hash) const
+{
+#if defined (__GNUC__)
+    __builtin_prefetch(&buckets[(hash >> 32) & (bucket_count - 1)], 1);
+#endif
+}
+
+entropy_context *hashed_context_table::query_slot(uint64 hash)
+{
+    /* The upper half of the hash selects our bucket and the lower bits verify it. */
+    hashed_bucket *bucket = &buckets[(hash >> 32) & (bucket_count - 1)];
+    uint16 checksum = (uint16) hash;
+    uint32 victim = 0;
+
+    for (uint32 i = 0; i < EVX_HASHED_BUCKET_SLOTS; ++i)
+    {
+        if (checksum == bucket->slots[i].checksum)
+        {
+            return bucket->slots[i].contexts;
+        }
+
+        uint16 count = bucket->slots[i].contexts[0].state & EVX_CONTEXT_COUNT_MAX;
+        uint16 victim_count = bucket->slots[victim].contexts[0].state & EVX_CONTEXT_COUNT_MAX;
+        victim = (count < victim_count) ? i : victim;
+    }
+
+    hashed_slot *slot = &bucket->slots[victim];
+    slot->checksum = checksum;
+
+    for (uint32 i = 0; i < EVX_HASHED_SLOT_CONTEXTS; ++i)
+    {
+        slot->contexts[i].state = EVX_CONTEXT_INITIAL_STATE;
+    }
+
+    return slot->contexts;
+}
+
+uint32 hashed_context_table::query_bucket_count() const
+{
+    return bucket_count;
+}
+
+hashed_byte_coder::hashed_byte_coder(entropy_coder *entropy)
+{
+    coder = entropy;
+    matcher = 0;
+    history = 0;
+    history_mask = 0;
+    order = 0;
+}
+
+evx_status hashed_byte_coder::create(uint8 context_order, uint8 bucket_bits)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!coder || context_order > EVX_HASHED_MAX_ORDER)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (EVX_SUCCESS != table.create(bucket_bits))
+    {
+        return evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    order = context_order;
+    history_mask = (order < 8) ? (uint64(0x1) << (order << 3)) - 1 : ~uint64(0);
+    history = 0;
+
+    return EVX_SUCCESS;
+}
+
+void hashed_byte_coder::clear()
+{
+    table.reset();
+    history = 0;
+
+    if (matcher)
+    {
+        matcher->clear();
+    }
+}
+
+void hashed_byte_coder::attach_match_model(match_model *model)
+{
+    matcher = model;
+}
+
+uint64 hashed_byte_coder::query_byte_hash() const
+{
+    /* The order is mixed in so that models of different orders never share slots. */
+    uint64 hash = ((history & history_mask) + order + 1) * EVX_HASHED_MULTIPLIER;
+    return hash ^ (hash >> 29);
+}
+
+uint64 hashed_byte_coder::query_nibble_hash(uint64 byte_hash, uint8 high_nibble) const
+{
+    uint64 hash = (byte_hash + high_nibble + 1) * EVX_HASHED_MULTIPLIER;
+    return hash ^ (hash >> 29);
+}
+
+evx_status hashed_byte_coder::encode_byte(uint8 value, bitstream *dest)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!dest || !table.query_bucket_count())
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint64 byte_hash = query_byte_hash();
+    uint64 nibble_hashes[2] = { byte_hash, query_nibble_hash(byte_hash, value >> 4) };
+
+    /* Our encoder knows the whole byte up front, so the low nibble's bucket is fetched 
+       while we code the high nibble. */
+    table.prefetch(nibble_hashes[1]);
+
+    uint32 node = 1;
+
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        entropy_context *contexts = table.query_slot(nibble_hashes[i]);
+        uint8 nibble = (value >> ((1 - i) << 2)) & 0xF;
+        uint32 nibble_node = 1;
+
+        for (int32 bit = 3; bit >= 0; --bit)
+        {
+            uint8 symbol = (nibble >> bit) & 0x1;
+            entropy_context *context = matcher ? matcher->query_context(node) : 0;
+
+            if (EVX_SUCCESS != coder->encode_bin(symbol, context ? context : &contexts[nibble_node - 1], dest))
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            nibble_node = (nibble_node << 1) | symbol;
+            node = (node << 1) | symbol;
+        }
+    }
+
+    if (matcher)
+    {
+        matcher->update(value);
+    }
+
+    history = (history << 8) | value;
+    table.prefetch(query_byte_hash());
+
+    return EVX_SUCCESS;
+}
+
+evx_status hashed_byte_coder::decode_byte(bitstream *source, uint8 *value)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!source || !value || !table.query_bucket_count())
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint64 byte_hash = query_byte_hash();
+    uint32 node = 1;
+
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        /* The low nibble's slot depends upon the high nibble we just decoded. */
+        entropy_context *contexts = table.query_slot(i ? query_nibble_hash(byte_hash, node & 0xF) : byte_hash);
+        uint32 nibble_node = 1;
+
+        for (uint32 bit = 0; bit < 4; ++bit)
+        {
+            uint8 symbol = 0;
+            entropy_context *context = matcher ? matcher->query_context(node) : 0;
+
+            if (EVX_SUCCESS != coder->decode_bin(context ? context : &contexts[nibble_node - 1], source, &symbol))
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            nibble_node = (nibble_node << 1) | symbol;
+            node = (node << 1) | symbol;
+        }
+    }
+
+    *value = node & 0xFF;
+
+    if (matcher)
+    {
+        matcher->update(*value);
+    }
+
+    history = (history << 8) | *value;
+    table.prefetch(query_byte_hash());
+
+    return EVX_SUCCESS;
+}
+
+evx_status hashed_byte_coder::encode(bitstream *source, bitstream *dest)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!source || !dest || (source->query_occupancy() & 0x7))
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    clear();
+    coder->clear();
+
+    while (!source->is_empty())
+    {
+        uint8 value = 0;
+
+        if (EVX_SUCCESS != source->read_byte(&value) || EVX_SUCCESS != encode_byte(value, dest))
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+    }
+
+    return coder->finish_encode(dest);
+}
+
+evx_status hashed_byte_coder::decode(uint32 byte_count, bitstream *source, bitstream *dest)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!source || !dest)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    clear();
+
+    if (EVX_SUCCESS != coder->start_decode(source))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    for (uint32 i = 0; i < byte_count; ++i)
+    {
+        uint8 value = 0;
+
+        if (EVX_SUCCESS != decode_byte(source, &value) || EVX_SUCCESS != dest->write_byte(value))
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+    }
+
+    return EVX_SUCCESS;
+}
+
+} // namespace evx
@@ -0,0 +1,158 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// hashed.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+#ifndef __EV_HASHED_H__
+#define __EV_HASHED_H__
+
+#include "cabac.h"
+#include "math.h"
+
+/*
+// Hashed Contexts
+//
+// High order byte models have far more contexts than could ever be stored directly,
+// but only a small fraction of them occur in practice. A hashed_context_table maps
+// a 64 bit context hash onto cache line sized buckets, each holding two slots of 
+// EVX_HASHED_SLOT_CONTEXTS contexts (the bit tree of a nibble) behind a 16 bit 
+// checksum. A lookup that matches neither checksum replaces the slot whose root 
+// context holds fewer observations, so well established contexts survive. 
+//
+// A hashed_byte_coder codes bytes through an entropy_coder with contexts selected by
+// the preceding order bytes. Each byte is coded as two nibbles, and each nibble as a
+// 4 bit tree within a single slot, so every bit of a nibble hits the same cache line.
+// At each byte boundary we prefetch the bucket of the next high nibble, which is then
+// in flight while the caller handles the byte. The encoder also prefetches the low 
+// nibble's bucket before coding the high nibble, as it knows the whole byte.
+//
+// An attached match_model takes over context selection whenever it predicts the next
+// bit, which captures repeats far longer than our order. The caller owns the model.
+//
+// Encoders and decoders must use the same order and table size (and identically 
+// configured match models, if any), and begin from a cleared table.
+*/
+
+#define EVX_HASHED_SLOT_CONTEXTS                (15)
+#define EVX_HASHED_BUCKET_SLOTS                 (2)
+#define EVX_HASHED_MAX_ORDER                    (8)
+#define EVX_HASHED_MAX_BUCKET_BITS              (26)
+#define EVX_HASHED_DEFAULT_ORDER                (3)
+#define EVX_HASHED_DEFAULT_BUCKET_BITS          (18)
+
+namespace evx {
+
+class match_model;
+
+typedef struct hashed_slot
+{
+    uint16 checksum;
+    entropy_context contexts[EVX_HASHED_SLOT_CONTEXTS];
+} hashed_slot;
+
+typedef struct alignas(EVX_CACHE_LINE_SIZE) hashed_bucket
+{
+    hashed_slot slots[EVX_HASHED_BUCKET_SLOTS];
+} hashed_bucket;
+
+class hashed_context_table
+{
+    uint8 *allocation;
+    hashed_bucket *buckets;
+    uint32 bucket_count;
+
+public:
+
+    hashed_context_table();
+    virtual ~hashed_context_table();
+
+    /* Allocates 2^bucket_bits buckets of EVX_CACHE_LINE_SIZE bytes and resets them. */
+    evx_status create(uint8 bucket_bits);
+    void clear();
+
+    /* Empties every slot. */
+    void reset();
+
+    void prefetch(uint64 hash) const;
+
+    /* Returns the contexts of the slot matching hash, replacing a slot if needed. */
+    entropy_context *query_slot(uint64 hash);
+    uint32 query_bucket_count() const;
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(hashed_context_table);
+};
+
+class hashed_byte_coder
+{
+    entropy_coder *coder;
+    hashed_context_table table;
+    match_model *matcher;
+    uint64 history;
+    uint64 history_mask;
+    uint8 order;
+
+private:
+
+    uint64 query_byte_hash() const;
+    uint64 query_nibble_hash(uint64 byte_hash, uint8 high_nibble) const;
+
+public:
+
+    explicit hashed_byte_coder(entropy_coder *entropy);
+
+    /* Selects the number of preceding bytes (up to EVX_HASHED_MAX_ORDER) that form
+       each context, and allocates our table. */
+    evx_status create(uint8 context_order = EVX_HASHED_DEFAULT_ORDER, 
+                      uint8 bucket_bits = EVX_HASHED_DEFAULT_BUCKET_BITS);
+
+    /* Empties the table and forgets our byte history, clearing any match model. */
+    void clear();
+
+    /* Selects contexts from model while it predicts, or detaches it if null. */
+    void attach_match_model(match_model *model);
+
+    evx_status encode_byte(uint8 value, bitstream *dest);
+    evx_status decode_byte(bitstream *source, uint8 *value);
+
+    /* Codes every remaining byte of source as a complete stream, from a cleared state. */
+    evx_status encode(bitstream *source, bitstream *dest);
+    evx_status decode(uint32 byte_count, bitstream *source, bitstream *dest);
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(hashed_byte_coder);
+};
+
+} // namespace evx
+
+#endif // __EV_HASHED_H__
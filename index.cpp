@@ -0,0 +1,174 @@
+
+#include "index.h"
+#include "memory.h"
+
+namespace evx {
+
+entropy_index::entropy_index()
+{
+    symbol_count = 0;
+}
+
+void entropy_index::clear()
+{
+    symbol_count = 0;
+    entries.clear();
+}
+
+evx_status entropy_index::add_entry(uint32 symbol_index, const entropy_checkpoint &checkpoint)
+{
+    /* Entries are kept in symbol order so that ranges may be found by a linear walk. */
+    if (!entries.empty() && symbol_index <= entries.back().symbol_index)
+    {
+        return evx_post_error(EVX_ERROR_INVALIDARG);
+    }
+
+    entropy_index_entry entry = { symbol_index, checkpoint };
+    entries.push_back(entry);
+
+    return EVX_SUCCESS;
+}
+
+void entropy_index::remove_entry(uint32 entry_index)
+{
+    if (entry_index < entries.size())
+    {
+        entries.erase(entries.begin() + entry_index);
+    }
+}
+
+void entropy_index::set_symbol_count(uint32 count)
+{
+    symbol_count = count;
+}
+
+uint32 entropy_index::query_symbol_count() const
+{
+    return symbol_count;
+}
+
+uint32 entropy_index::query_entry_count() const
+{
+    return (uint32) entries.size();
+}
+
+evx_status entropy_index::query_entry(uint32 entry_index, entropy_index_entry *entry) const
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!entry)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (entry_index >= entries.size())
+    {
+        return evx_post_error(EVX_ERROR_INVALID_INDEX);
+    }
+
+    *entry = entries[entry_index];
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_index::save(bitstream *dest) const
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!dest)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    std::vector<uint8> image(EVX_INDEX_HEADER_SIZE + entries.size() * EVX_INDEX_ENTRY_SIZE, 0);
+
+    store_u32(&image[0], symbol_count);
+    store_u32(&image[4], (uint32) entries.size());
+
+    for (uint32 i = 0; i < entries.size(); ++i)
+    {
+        const entropy_checkpoint &checkpoint = entries[i].checkpoint;
+        uint8 *record = &image[EVX_INDEX_HEADER_SIZE + i * EVX_INDEX_ENTRY_SIZE];
+
+        store_u32(record, entries[i].symbol_index);
+        store_u32(record + 4, (uint32) checkpoint.position);
+        store_u32(record + 8, checkpoint.e3_count);
+        store_u32(record + 12, checkpoint.history[0]);
+        store_u32(record + 16, checkpoint.history[1]);
+        store_u16(record + 20, (uint16) checkpoint.low);
+        store_u16(record + 22, (uint16) checkpoint.high);
+        store_u16(record + 24, (uint16) checkpoint.value);
+        store_u16(record + 26, checkpoint.estimate[0]);
+        store_u16(record + 28, checkpoint.estimate[1]);
+    }
+
+    if (EVX_SUCCESS != dest->write_bytes(&image[0], (uint32) image.size()))
+    {
+        return evx_post_error(EVX_ERROR_CAPACITY_LIMIT);
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_index::load(bitstream *source)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!source)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint8 header[EVX_INDEX_HEADER_SIZE];
+    uint32 byte_count = EVX_INDEX_HEADER_SIZE;
+
+    clear();
+
+    if (source->query_occupancy() < (EVX_INDEX_HEADER_SIZE << 3) ||
+        EVX_SUCCESS != source->read_bytes(header, &byte_count))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    uint32 entry_count = load_u32(header + 4);
+
+    if (source->query_occupancy() / (EVX_INDEX_ENTRY_SIZE << 3) < entry_count)
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    for (uint32 i = 0; i < entry_count; ++i)
+    {
+        uint8 record[EVX_INDEX_ENTRY_SIZE];
+        entropy_checkpoint checkpoint;
+
+        byte_count = EVX_INDEX_ENTRY_SIZE;
+        source->read_bytes(record, &byte_count);
+        memset(&checkpoint, 0, sizeof(checkpoint));
+
+        checkpoint.position = load_u32(record + 4);
+        checkpoint.e3_count = load_u32(record + 8);
+        checkpoint.history[0] = load_u32(record + 12);
+        checkpoint.history[1] = load_u32(record + 16);
+        checkpoint.low = load_u16(record + 20);
+        checkpoint.high = load_u16(record + 22);
+        checkpoint.value = load_u16(record + 24);
+        checkpoint.estimate[0] = load_u16(record + 26);
+        checkpoint.estimate[1] = load_u16(record + 28);
+
+        if (EVX_SUCCESS != add_entry(load_u32(record), checkpoint))
+        {
+            clear();
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+    }
+
+    symbol_count = load_u32(header);
+
+    return EVX_SUCCESS;
+}
+
+} // namespace evx
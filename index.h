@@ -0,0 +1,99 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// index.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_INDEX_H__
+#define __EV_INDEX_H__
+
+#include "cabac.h"
+#include <vector>
+
+/*
+// Seek Index
+//
+// Independently coded chunks can be decoded in parallel, but every chunk restarts
+// adaptation and so costs ratio. Instead, entropy_coder::encode_indexed codes one 
+// continuous adaptive stream while recording the complete coder state every interval
+// symbols into an entropy_index, which is kept alongside the stream. A decoder may
+// resume from any entry via entropy_coder::resume_decode, so disjoint symbol ranges of
+// a single stream can be decoded in parallel (see parallel_coder::decode_indexed).
+//
+// An entry's decoder value is derived from the finished stream: it holds the 16 coded
+// bits that follow the entry's output position and any pending E3 bits, with the msb
+// inverted when E3 bits are pending. Entries that lie within 16 bits of the end of the
+// stream are omitted. Indexed coding does not support run mode.
+//
+// Serialized indices are stored little endian as a symbol count and an entry count,
+// followed by EVX_INDEX_ENTRY_SIZE bytes per entry.
+*/
+
+#define EVX_INDEX_HEADER_SIZE                   (8)
+#define EVX_INDEX_ENTRY_SIZE                    (32)
+
+namespace evx {
+
+typedef struct entropy_index_entry
+{
+    uint32 symbol_index;
+    entropy_checkpoint checkpoint;
+} entropy_index_entry;
+
+class entropy_index
+{
+    uint32 symbol_count;
+    std::vector<entropy_index_entry> entries;
+
+public:
+
+    entropy_index();
+
+    void clear();
+    evx_status add_entry(uint32 symbol_index, const entropy_checkpoint &checkpoint);
+    void remove_entry(uint32 entry_index);
+    void set_symbol_count(uint32 count);
+
+    uint32 query_symbol_count() const;
+    uint32 query_entry_count() const;
+    evx_status query_entry(uint32 entry_index, entropy_index_entry *entry) const;
+
+    evx_status save(bitstream *dest) const;
+    evx_status load(bitstream *source);
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(entropy_index);
+};
+
+} // namespace evx
+
+#endif // __EV_INDEX_H__
@@ -0,0 +1,160 @@
+
+#include "match.h"
+#include <algorithm>
+
+#define EVX_MATCH_MULTIPLIER                    (0x9E3779B97F4A7C15ULL)
+
+namespace evx {
+
+match_model::match_model()
+{
+    window_mask = 0;
+    hash_shift = 0;
+    position = 0;
+    match_position = 0;
+    match_length = 0;
+    predict_length = EVX_MATCH_MIN_LENGTH;
+    history = 0;
+    expected = 0;
+
+    for (uint32 i = 0; i < (EVX_MATCH_LENGTH_BUCKETS << 1); ++i)
+    {
+        contexts[i].state = EVX_CONTEXT_INITIAL_STATE;
+    }
+}
+
+evx_status match_model::create(uint8 window_bits, uint8 hash_bits, uint32 min_predict_length)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (window_bits < 8 || window_bits > EVX_MATCH_MAX_WINDOW_BITS || 
+            0 == hash_bits || hash_bits > 32 || min_predict_length < EVX_MATCH_MIN_LENGTH)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    window.assign(0x1 << window_bits, 0);
+    positions.assign(uint64(0x1) << hash_bits, 0);
+    window_mask = (0x1 << window_bits) - 1;
+    hash_shift = 64 - hash_bits;
+    predict_length = min_predict_length;
+
+    clear();
+
+    return EVX_SUCCESS;
+}
+
+void match_model::clear()
+{
+    std::fill(positions.begin(), positions.end(), 0);
+    position = 0;
+    match_position = 0;
+    match_length = 0;
+    history = 0;
+    expected = 0;
+
+    for (uint32 i = 0; i < (EVX_MATCH_LENGTH_BUCKETS << 1); ++i)
+    {
+        contexts[i].state = EVX_CONTEXT_INITIAL_STATE;
+    }
+}
+
+void match_model::update(uint8 value)
+{
+    if (window.empty())
+    {
+        return;
+    }
+
+    window[position & window_mask] = value;
+    history = (history << 8) | value;
+    position++;
+
+    /* An active match survives for as long as its predicted byte is correct. */
+    if (match_length && value == window[match_position & window_mask])
+    {
+        match_length += (match_length < 0xFFFF) ? 1 : 0;
+        match_position++;
+    }
+    else
+    {
+        match_length = 0;
+    }
+
+    if (position < EVX_MATCH_MIN_LENGTH)
+    {
+        return;
+    }
+
+    uint64 context = history & ((uint64(0x1) << (EVX_MATCH_MIN_LENGTH << 3)) - 1);
+    uint32 hash = (uint32) ((context * EVX_MATCH_MULTIPLIER) >> hash_shift);
+
+    if (0 == match_length)
+    {
+        /* Each entry holds the position that followed an earlier occurrence of its
+           context. Hash collisions are weeded out by comparing backwards from there,
+           and candidates that have left our window are ignored. */
+        uint32 candidate = positions[hash];
+        uint32 distance = position - candidate;
+
+        if (candidate && distance + EVX_MATCH_MAX_VERIFY <= window_mask)
+        {
+            uint32 length = 0;
+
+            while (length < EVX_MATCH_MAX_VERIFY && length < candidate &&
+                   window[(candidate - length - 1) & window_mask] == window[(position - length - 1) & window_mask])
+            {
+                length++;
+            }
+
+            if (length >= EVX_MATCH_MIN_LENGTH)
+            {
+                match_length = length;
+                match_position = candidate;
+            }
+        }
+    }
+
+    positions[hash] = position;
+    expected = match_length ? (0x100 | window[match_position & window_mask]) : 0;
+}
+
+uint32 match_model::query_length_bucket() const
+{
+    /* Short matches are bucketed individually and longer ones logarithmically. */
+    if (match_length < 12)
+    {
+        return match_length - EVX_MATCH_MIN_LENGTH;
+    }
+
+    return evx_min2(6 + (uint32) log2(match_length >> 2), (uint32) EVX_MATCH_LENGTH_BUCKETS - 1);
+}
+
+entropy_context *match_model::query_context(uint32 node)
+{
+    if (match_length < predict_length)
+    {
+        return 0;
+    }
+
+    /* Our prediction only holds while the bits coded so far agree with the expected
+       byte, in which case the next expected bit selects the context. */
+    uint32 bit_count = log2(node);
+
+    if ((expected >> (8 - bit_count)) != node)
+    {
+        return 0;
+    }
+
+    uint32 expected_bit = (expected >> (7 - bit_count)) & 0x1;
+
+    return &contexts[(query_length_bucket() << 1) | expected_bit];
+}
+
+uint32 match_model::query_match_length() const
+{
+    return match_length;
+}
+
+} // namespace evx
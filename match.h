@@ -0,0 +1,114 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// match.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+#ifndef __EV_MATCH_H__
+#define __EV_MATCH_H__
+
+#include "cabac.h"
+#include "math.h"
+#include <vector>
+
+/*
+// Match Model
+//
+// Long repeats are invisible to bitwise context models once they exceed the model 
+// order. A match_model keeps a window of recent bytes and a hash index of every 
+// EVX_MATCH_MIN_LENGTH byte context within it. At each byte boundary with no active 
+// match, we look up the current context and verify the candidate by comparing 
+// backwards. Once a match is found, the byte that followed the earlier occurrence is
+// expected next, and the match extends for as long as its predictions hold.
+//
+// While the bits of the current byte agree with the expected byte, query_context 
+// returns a context selected by the match length and the expected bit, so confidence
+// grows with the length of the match. Otherwise it returns null and the caller falls
+// back to its own contexts. Both sides must call update with every coded byte.
+*/
+
+#define EVX_MATCH_MIN_LENGTH                    (5)
+#define EVX_MATCH_MAX_VERIFY                    (32)
+#define EVX_MATCH_LENGTH_BUCKETS                (16)
+#define EVX_MATCH_MAX_WINDOW_BITS               (28)
+#define EVX_MATCH_DEFAULT_WINDOW_BITS           (22)
+#define EVX_MATCH_DEFAULT_HASH_BITS             (20)
+
+namespace evx {
+
+class match_model
+{
+    std::vector<uint8> window;
+    std::vector<uint32> positions;
+    uint32 window_mask;
+    uint32 hash_shift;
+    uint32 position;
+    uint32 match_position;
+    uint32 match_length;
+    uint32 predict_length;
+    uint64 history;
+    uint32 expected;
+    entropy_context contexts[EVX_MATCH_LENGTH_BUCKETS << 1];
+
+private:
+
+    uint32 query_length_bucket() const;
+
+public:
+
+    match_model();
+
+    /* Allocates a window of 2^window_bits bytes and an index of 2^hash_bits entries. 
+       Matches shorter than min_predict_length are tracked but make no prediction, 
+       which leaves short, unreliable matches to the caller's own contexts. */
+    evx_status create(uint8 window_bits = EVX_MATCH_DEFAULT_WINDOW_BITS, 
+                      uint8 hash_bits = EVX_MATCH_DEFAULT_HASH_BITS,
+                      uint32 min_predict_length = EVX_MATCH_MIN_LENGTH);
+
+    /* Forgets every byte seen and resets our contexts. */
+    void clear();
+
+    /* Appends a coded byte and extends (or searches for) a match. */
+    void update(uint8 value);
+
+    /* Returns the context for the next bit of the current byte, given the bit tree 
+       node of the bits coded so far (1 followed by those bits), or null if the match
+       makes no prediction. */
+    entropy_context *query_context(uint32 node);
+    uint32 query_match_length() const;
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(match_model);
+};
+
+} // namespace evx
+
+#endif // __EV_MATCH_H__
@@ -41,6 +41,8 @@
 #define EVX_MB                  (EVX_KB * EVX_KB)
 #define EVX_GB                  (EVX_MB * EVX_KB)
 
+#define EVX_CACHE_LINE_SIZE     (64)
+
 #define EVX_MAX_INT64           (0x7FFFFFFFFFFFFFFF)
 #define EVX_MAX_INT32           (0x7FFFFFFF)
 #define EVX_MAX_INT16           (0x7FFF)
@@ -107,6 +109,57 @@ inline uint8 log2(uint32 value)
     return 16 + log2((uint16) (value >> 16));
 }
 
+inline uint8 count_leading_zeros(uint32 value) 
+{
+    if (0 == value) 
+    {
+        return 32;
+    }
+
+#if defined (__GNUC__)
+    return __builtin_clz(value);
+#else
+    return 31 - log2(value);
+#endif
+}
+
+inline uint8 count_trailing_zeros(uint32 value) 
+{
+    if (0 == value) 
+    {
+        return 32;
+    }
+
+#if defined (__GNUC__)
+    return __builtin_ctz(value);
+#else
+    return log2(value & (~value + 1));
+#endif
+}
+
+inline uint8 count_set_bits(uint64 value) 
+{
+#if defined (__GNUC__)
+    return __builtin_popcountll(value);
+#else
+    value = value - ((value >> 1) & 0x5555555555555555ULL);
+    value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+    value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+    return (value * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+inline uint32 reverse_bits(uint32 value) 
+{
+    value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+    value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+    value = ((value >> 4) & 0x0F0F0F0F) | ((value & 0x0F0F0F0F) << 4);
+    value = ((value >> 8) & 0x00FF00FF) | ((value & 0x00FF00FF) << 8);
+
+    return (value >> 16) | (value << 16);
+}
+
 inline int8 abs(int8 value) 
 {
     if (value == EVX_MIN_INT8)
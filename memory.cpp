@@ -1,9 +1,37 @@
 
 #include "memory.h"
+#include "cpu.h"
 #include "math.h"
 
+#if defined (EVX_CPU_X86)
+    #include "immintrin.h"
+#endif
+
 namespace evx {
 
+/* Our streams store bits least significant first, so a little endian word load
+   places stream bit i at word bit i. */
+static inline uint64 load_word(const uint8 *source) 
+{
+    uint64 word = 0;
+    memcpy(&word, source, sizeof(word));
+
+#if defined (__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+#endif
+
+    return word;
+}
+
+static inline void store_word(uint8 *dest, uint64 word) 
+{
+#if defined (__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+#endif
+
+    memcpy(dest, &word, sizeof(word));
+}
+
 uint32 aligned_bit_copy(uint8 *dest, uint32 dest_bit_offset, uint8 *source, uint32 source_bit_offset, uint32 copy_bit_count) 
 {
     if (EVX_PARAM_CHECK) 
@@ -67,4 +95,221 @@ uint32 unaligned_bit_copy( uint8 *dest, uint32 dest_offset, uint8 *source, uint3
     return copy_bit_count;
 }
 
-} // namespace evx
\ No newline at end of file
+/*
+// Shifted Copy Kernels
+//
+// Each kernel stores whole 64 bit words formed from two neighboring source words, and
+// returns the number of bits it copied. Like our scalar loop, they stop while a full
+// extra source word remains so that we never read past the end of our source.
+*/
+
+#if defined (EVX_CPU_X86)
+
+__attribute__((target("sse4.2")))
+static uint32 shift_words_sse42(uint8 *dest, const uint8 *source, uint8 shift, uint32 bit_count)
+{
+    __m128i right = _mm_cvtsi32_si128(shift);
+    __m128i left = _mm_cvtsi32_si128(64 - shift);
+    uint32 bits_copied = 0;
+
+    for (; bit_count - bits_copied >= 192; bits_copied += 128, source += 16, dest += 16)
+    {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm_or_si128(_mm_srl_epi64(low, right), _mm_sll_epi64(high, left)));
+    }
+
+    return bits_copied;
+}
+
+__attribute__((target("avx2")))
+static uint32 shift_words_avx2(uint8 *dest, const uint8 *source, uint8 shift, uint32 bit_count)
+{
+    __m128i right = _mm_cvtsi32_si128(shift);
+    __m128i left = _mm_cvtsi32_si128(64 - shift);
+    uint32 bits_copied = 0;
+
+    for (; bit_count - bits_copied >= 320; bits_copied += 256, source += 32, dest += 32)
+    {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest), _mm256_or_si256(_mm256_srl_epi64(low, right), _mm256_sll_epi64(high, left)));
+    }
+
+    return bits_copied;
+}
+
+/* GCC 12 flags the _mm512_undefined_epi32() passthrough inside the AVX-512 shift 
+   intrinsics as -Wmaybe-uninitialized; it is a header false positive. */
+#if defined (__GNUC__) && !defined (__clang__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx512f")))
+static uint32 shift_words_avx512(uint8 *dest, const uint8 *source, uint8 shift, uint32 bit_count)
+{
+    __m128i right = _mm_cvtsi32_si128(shift);
+    __m128i left = _mm_cvtsi32_si128(64 - shift);
+    uint32 bits_copied = 0;
+
+    for (; bit_count - bits_copied >= 576; bits_copied += 512, source += 64, dest += 64)
+    {
+        __m512i low = _mm512_loadu_si512(source);
+        __m512i high = _mm512_loadu_si512(source + 8);
+        _mm512_storeu_si512(dest, _mm512_or_si512(_mm512_srl_epi64(low, right), _mm512_sll_epi64(high, left)));
+    }
+
+    return bits_copied;
+}
+
+#if defined (__GNUC__) && !defined (__clang__)
+    #pragma GCC diagnostic pop
+#endif
+
+__attribute__((target("popcnt")))
+static uint32 count_word_bits_popcnt(const uint8 *source, uint32 word_count)
+{
+    uint32 count = 0;
+
+    for (uint32 i = 0; i < word_count; ++i)
+    {
+        uint64 word = 0;
+        memcpy(&word, source + (i << 3), sizeof(word));
+        count += (uint32) __builtin_popcountll(word);
+    }
+
+    return count;
+}
+
+#endif
+
+static uint32 shift_words(uint8 *dest, const uint8 *source, uint8 shift, uint32 bit_count)
+{
+#if defined (EVX_CPU_X86)
+    switch (query_cpu_level())
+    {
+        case EVX_CPU_AVX512: return shift_words_avx512(dest, source, shift, bit_count);
+        case EVX_CPU_AVX2: return shift_words_avx2(dest, source, shift, bit_count);
+        case EVX_CPU_SSE42: return shift_words_sse42(dest, source, shift, bit_count);
+    }
+#endif
+
+    return 0;
+}
+
+uint32 shifted_bit_copy(uint8 *dest, uint32 dest_offset, uint8 *source, uint32 source_offset, uint32 copy_bit_count) 
+{
+    if (EVX_PARAM_CHECK) 
+    {
+        if (!dest || 0 == copy_bit_count || !source) 
+        {
+            evx_post_error(EVX_ERROR_INVALIDARG);
+            return 0;
+        }
+    }
+
+    /* Align our destination to a byte boundary so that we may store whole words. */
+    uint32 bits_copied = evx_min2((8 - (dest_offset & 0x7)) & 0x7, copy_bit_count);
+
+    if (bits_copied) 
+    {
+        unaligned_bit_copy(dest, dest_offset, source, source_offset, bits_copied);
+    }
+
+    uint8 *dest_data = dest + ((dest_offset + bits_copied) >> 3);
+    uint8 *source_data = source + ((source_offset + bits_copied) >> 3);
+    uint8 shift = (source_offset + bits_copied) & 0x7;
+
+    if (0 == shift) 
+    {
+        uint32 byte_count = (copy_bit_count - bits_copied) >> 3;
+        memcpy(dest_data, source_data, byte_count);
+        bits_copied += byte_count << 3;
+    } 
+    else 
+    {
+        uint32 vector_bits = shift_words(dest_data, source_data, shift, copy_bit_count - bits_copied);
+
+        dest_data += vector_bits >> 3;
+        source_data += vector_bits >> 3;
+        bits_copied += vector_bits;
+
+        /* Each word we store spans nine source bytes, so we stop while a full
+           nine bytes remain in order to never read past the end of our source. */
+        while (copy_bit_count - bits_copied >= 72) 
+        {
+            uint64 word = (load_word(source_data) >> shift) | (uint64(source_data[8]) << (64 - shift));
+            store_word(dest_data, word);
+
+            dest_data += 8;
+            source_data += 8;
+            bits_copied += 64;
+        }
+
+        while (copy_bit_count - bits_copied >= 16) 
+        {
+            *dest_data++ = (source_data[0] >> shift) | (source_data[1] << (8 - shift));
+            source_data++;
+            bits_copied += 8;
+        }
+    }
+
+    if (bits_copied < copy_bit_count) 
+    {
+        unaligned_bit_copy(dest, 
+                           dest_offset + bits_copied, 
+                           source, 
+                           source_offset + bits_copied, 
+                           copy_bit_count - bits_copied);
+    }
+
+    return copy_bit_count;
+}
+
+uint32 count_set_bits(const uint8 *source, uint32 source_offset, uint32 bit_count) 
+{
+    uint32 count = 0;
+
+    source += source_offset >> 3;
+    source_offset &= 0x7;
+
+    /* Bits are stored least significant first, so a leading partial byte is shifted down. */
+    if (source_offset && bit_count) 
+    {
+        uint32 lead_count = evx_min2(8 - source_offset, bit_count);
+        count += count_set_bits(uint64((*source++ >> source_offset) & ((0x1 << lead_count) - 1)));
+        bit_count -= lead_count;
+    }
+
+#if defined (EVX_CPU_X86)
+    if (query_cpu_level() >= EVX_CPU_SSE42) 
+    {
+        count += count_word_bits_popcnt(source, bit_count >> 6);
+        source += (bit_count >> 6) << 3;
+        bit_count &= 63;
+    }
+#endif
+
+    while (bit_count >= 64) 
+    {
+        count += count_set_bits(load_word(source));
+        source += 8;
+        bit_count -= 64;
+    }
+
+    while (bit_count >= 8) 
+    {
+        count += count_set_bits(uint64(*source++));
+        bit_count -= 8;
+    }
+
+    if (bit_count) 
+    {
+        count += count_set_bits(uint64(*source & ((0x1 << bit_count) - 1)));
+    }
+
+    return count;
+}
+
+} // namespace evx
@@ -43,6 +43,36 @@ uint32 aligned_bit_copy(uint8 *dest, uint32 dest_bit_offset, uint8 *source, uint
 
 uint32 unaligned_bit_copy(uint8 *dest, uint32 dest_offset, uint8 *source, uint32 source_offset, uint32 copy_bit_count);
 
+/* Copies between arbitrary bit offsets a 64 bit word at a time, falling back to
+   unaligned_bit_copy for the leading and trailing bits. */
+uint32 shifted_bit_copy(uint8 *dest, uint32 dest_offset, uint8 *source, uint32 source_offset, uint32 copy_bit_count);
+
+/* Returns the number of one bits in a range of bits, counted a 64 bit word at a time. */
+uint32 count_set_bits(const uint8 *source, uint32 source_offset, uint32 bit_count);
+
+/* Little endian field accessors, shared by every serialized format. */
+inline void store_u16(uint8 *dest, uint16 value)
+{
+    dest[0] = value & 0xFF;
+    dest[1] = (value >> 8) & 0xFF;
+}
+
+inline void store_u32(uint8 *dest, uint32 value)
+{
+    store_u16(dest, value & 0xFFFF);
+    store_u16(dest + 2, value >> 16);
+}
+
+inline uint16 load_u16(const uint8 *source)
+{
+    return uint16(source[0]) | (uint16(source[1]) << 8);
+}
+
+inline uint32 load_u32(const uint8 *source)
+{
+    return uint32(load_u16(source)) | (uint32(load_u16(source + 2)) << 16);
+}
+
 } // namespace evx
 
 #endif // __EV_MEMORY_H__
\ No newline at end of file
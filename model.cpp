@@ -0,0 +1,499 @@
+
+#include "model.h"
+#include "math.h"
+#include "memory.h"
+#include "version.h"
+#include <cmath>
+
+#if !defined (EVX_PLATFORM_WINDOWS)
+    #include "fcntl.h"
+    #include "sys/mman.h"
+    #include "sys/stat.h"
+#endif
+
+#define EVX_MODEL_MAGIC                         (0x4D585645)    // 'EVXM'
+
+namespace evx {
+
+/*
+// Model File Layout
+//
+// All fields are stored little endian.
+//
+//   [0]   uint32  magic
+//   [4]   uint16  format version
+//   [6]   uint16  library version word
+//   [8]   uint32  context count
+//   [12]  uint32  signature
+//   [16]  entries of { uint16 probability, uint16 confidence }, one per context.
+*/
+
+static uint32 compute_signature(const uint8 *image, uint32 context_count)
+{
+    /* FNV-1a over the context count and every serialized state. */
+    uint32 hash = 0x811C9DC5;
+    uint32 byte_count = EVX_MODEL_STATE_SIZE * context_count;
+    const uint8 *entries = image + EVX_MODEL_HEADER_SIZE;
+
+    for (uint32 i = 0; i < 4; ++i)
+    {
+        hash = (hash ^ ((context_count >> (i << 3)) & 0xFF)) * 0x01000193;
+    }
+
+    for (uint32 i = 0; i < byte_count; ++i)
+    {
+        hash = (hash ^ entries[i]) * 0x01000193;
+    }
+
+    return hash;
+}
+
+static void quantize_state(uint64 zeros, uint64 ones, entropy_model_state *state)
+{
+    uint64 total = zeros + ones;
+
+    /* We bias our estimate towards even odds so that contexts with few (or no)
+       observations neither saturate nor claim more confidence than they have. */
+    uint64 probability = ((zeros + 1) << 16) / (total + 2);
+    uint64 confidence = evx_min2(total + 2, (uint64) EVX_MODEL_MAX_CONFIDENCE);
+
+    probability = evx_max2(probability, (uint64) 1);
+    probability = evx_min2(probability, (uint64) EVX_MAX_UINT16);
+
+    state->probability = (uint16) probability;
+    state->confidence = (uint16) confidence;
+}
+
+entropy_model::entropy_model()
+{
+    context_count = 0;
+    signature = 0;
+    counts = 0;
+    image = 0;
+    image_size = 0;
+    mapped = false;
+}
+
+entropy_model::~entropy_model()
+{
+    clear();
+}
+
+void entropy_model::release_image()
+{
+    if (image)
+    {
+#if !defined (EVX_PLATFORM_WINDOWS)
+        if (mapped)
+        {
+            munmap(image, image_size);
+        }
+        else
+#endif
+        {
+            delete [] image;
+        }
+    }
+
+    image = 0;
+    image_size = 0;
+    mapped = false;
+}
+
+void entropy_model::clear()
+{
+    release_image();
+
+    delete [] counts;
+    counts = 0;
+    context_count = 0;
+    signature = 0;
+}
+
+evx_status entropy_model::create(uint32 count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (0 == count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    clear();
+
+    counts = new uint64[count << 1];
+
+    if (!counts)
+    {
+        return evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    memset(counts, 0, sizeof(uint64) * (count << 1));
+    context_count = count;
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_model::observe(uint32 context_index, uint8 value)
+{
+    if (!counts || context_index >= context_count)
+    {
+        return evx_post_error(EVX_ERROR_INVALIDARG);
+    }
+
+    counts[(context_index << 1) + (value & 0x1)]++;
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_model::train(bitstream *source)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!source)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (!counts)
+    {
+        return evx_post_error(EVX_ERROR_NOT_READY);
+    }
+
+    if (EVX_SUCCESS != train(source->query_data(), source->query_read_index(), source->query_occupancy()))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    return source->seek(source->query_write_index());
+}
+
+evx_status entropy_model::train(const uint8 *data, uint32 bit_offset, uint32 bit_count, uint32 first_context)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if ((!data && bit_count) || first_context >= evx_max2(context_count, 1u))
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (!counts)
+    {
+        return evx_post_error(EVX_ERROR_NOT_READY);
+    }
+
+    /* A single context only needs its ones counted, a word at a time. */
+    if (1 == context_count)
+    {
+        uint64 one_count = count_set_bits(data, bit_offset, bit_count);
+        counts[0] += bit_count - one_count;
+        counts[1] += one_count;
+
+        return EVX_SUCCESS;
+    }
+
+    uint32 context_index = first_context;
+    const uint8 *input = data + (bit_offset >> 3);
+    uint32 bit_index = bit_offset & 0x7;
+    uint32 value = bit_count ? *input : 0;
+
+    for (uint32 i = 0; i < bit_count; ++i)
+    {
+        counts[(context_index << 1) + ((value >> bit_index) & 0x1)]++;
+
+        if (++context_index == context_count)
+        {
+            context_index = 0;
+        }
+
+        if (8 == ++bit_index && i + 1 < bit_count)
+        {
+            value = *(++input);
+            bit_index = 0;
+        }
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_model::merge(const entropy_model &other)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!other.counts || other.context_count != context_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (!counts)
+    {
+        return evx_post_error(EVX_ERROR_NOT_READY);
+    }
+
+    for (uint32 i = 0; i < (context_count << 1); ++i)
+    {
+        counts[i] += other.counts[i];
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_model::resolve_image()
+{
+    release_image();
+
+    image_size = EVX_MODEL_HEADER_SIZE + EVX_MODEL_STATE_SIZE * context_count;
+    image = new uint8[image_size];
+
+    if (!image)
+    {
+        image_size = 0;
+        return evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    for (uint32 i = 0; i < context_count; ++i)
+    {
+        entropy_model_state state;
+        quantize_state(counts[i << 1], counts[(i << 1) + 1], &state);
+
+        store_u16(image + EVX_MODEL_HEADER_SIZE + i * EVX_MODEL_STATE_SIZE, state.probability);
+        store_u16(image + EVX_MODEL_HEADER_SIZE + i * EVX_MODEL_STATE_SIZE + 2, state.confidence);
+    }
+
+    signature = compute_signature(image, context_count);
+
+    store_u32(image, EVX_MODEL_MAGIC);
+    store_u16(image + 4, EVX_MODEL_FORMAT_VERSION);
+    store_u16(image + 6, EVX_VERSION_WORD(EVX_VERSION_MAJOR, EVX_VERSION_MINOR));
+    store_u32(image + 8, context_count);
+    store_u32(image + 12, signature);
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_model::save(const char *filename)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!filename)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* Trained models are serialized from their latest counts. */
+    if (counts && EVX_SUCCESS != resolve_image())
+    {
+        return evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    if (!image)
+    {
+        return evx_post_error(EVX_ERROR_NOT_READY);
+    }
+
+    FILE *file = fopen(filename, "wb");
+
+    if (!file)
+    {
+        return evx_post_error(EVX_ERROR_IO_FAILURE);
+    }
+
+    uint32 bytes_written = (uint32) fwrite(image, 1, image_size, file);
+    fclose(file);
+
+    if (bytes_written != image_size)
+    {
+        return evx_post_error(EVX_ERROR_IO_FAILURE);
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_model::load(const char *filename)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!filename)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    clear();
+
+#if defined (EVX_PLATFORM_WINDOWS)
+    FILE *file = fopen(filename, "rb");
+
+    if (!file)
+    {
+        return evx_post_error(EVX_ERROR_RESOURCE_UNREACHABLE);
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (file_size < EVX_MODEL_HEADER_SIZE)
+    {
+        fclose(file);
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    image_size = (uint32) file_size;
+    image = new uint8[image_size];
+
+    if (!image || image_size != fread(image, 1, image_size, file))
+    {
+        fclose(file);
+        release_image();
+        return evx_post_error(EVX_ERROR_IO_FAILURE);
+    }
+
+    fclose(file);
+#else
+    /* Models are read only, so we map them directly rather than copying them. */
+    int file = open(filename, O_RDONLY);
+
+    if (file < 0)
+    {
+        return evx_post_error(EVX_ERROR_RESOURCE_UNREACHABLE);
+    }
+
+    struct stat file_info;
+
+    if (0 != fstat(file, &file_info) || file_info.st_size < EVX_MODEL_HEADER_SIZE)
+    {
+        close(file);
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    void *view = mmap(0, file_info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if (MAP_FAILED == view)
+    {
+        return evx_post_error(EVX_ERROR_IO_FAILURE);
+    }
+
+    image = reinterpret_cast<uint8 *>(view);
+    image_size = (uint32) file_info.st_size;
+    mapped = true;
+#endif
+
+    uint32 count = load_u32(image + 8);
+
+    if (EVX_MODEL_MAGIC != load_u32(image) ||
+        EVX_MODEL_FORMAT_VERSION != load_u16(image + 4) ||
+        image_size != EVX_MODEL_HEADER_SIZE + (uint64) count * EVX_MODEL_STATE_SIZE ||
+        load_u32(image + 12) != compute_signature(image, count))
+    {
+        release_image();
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    context_count = count;
+    signature = load_u32(image + 12);
+
+    return EVX_SUCCESS;
+}
+
+uint32 entropy_model::query_context_count() const
+{
+    return context_count;
+}
+
+uint32 entropy_model::query_signature() const
+{
+    return signature;
+}
+
+evx_status entropy_model::query_state(uint32 context_index, entropy_model_state *state) const
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!state)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (context_index >= context_count)
+    {
+        return evx_post_error(EVX_ERROR_INVALID_INDEX);
+    }
+
+    if (counts)
+    {
+        quantize_state(counts[context_index << 1], counts[(context_index << 1) + 1], state);
+        return EVX_SUCCESS;
+    }
+
+    const uint8 *entry = image + EVX_MODEL_HEADER_SIZE + context_index * EVX_MODEL_STATE_SIZE;
+    state->probability = load_u16(entry);
+    state->confidence = load_u16(entry + 2);
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_model::query_counts(uint32 context_index, uint64 *zero_count, uint64 *one_count) const
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!zero_count || !one_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* Loaded models only hold quantized states, not the counts they came from. */
+    if (!counts)
+    {
+        return evx_post_error(EVX_ERROR_NOT_READY);
+    }
+
+    if (context_index >= context_count)
+    {
+        return evx_post_error(EVX_ERROR_INVALID_INDEX);
+    }
+
+    *zero_count = counts[context_index << 1];
+    *one_count = counts[(context_index << 1) + 1];
+
+    return EVX_SUCCESS;
+}
+
+evx_status entropy_model::query_entropy(uint32 context_index, float64 *bits) const
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!bits)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint64 zero_count = 0;
+    uint64 one_count = 0;
+
+    if (EVX_SUCCESS != query_counts(context_index, &zero_count, &one_count))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    *bits = 0.0;
+
+    if (zero_count && one_count)
+    {
+        float64 probability = (float64) zero_count / (float64) (zero_count + one_count);
+        *bits = -probability * std::log2(probability) - (1.0 - probability) * std::log2(1.0 - probability);
+    }
+
+    return EVX_SUCCESS;
+}
+
+} // namespace evx
@@ -0,0 +1,121 @@
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// model.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_MODEL_H__
+#define __EV_MODEL_H__
+
+#include "bitstream.h"
+
+/*
+// Trained Model Interface
+//
+// An entropy_model holds the initial state of one or more coder contexts, similar
+// to the initialization tables used by CABAC. Models are trained from a sample corpus,
+// where bit i of each sample trains context (i % context_count), and saved to a compact
+// binary file that is mapped into memory when loaded.
+//
+// Encoders and decoders must agree on the model they use. The file records a format
+// version and a signature of its contents, which should be compared via
+// query_signature() before coding. The signature is valid once a model has been
+// saved or loaded.
+//
+// Training only counts bits, so large corpora may be split across threads: each 
+// part trains its own model from the context its first bit falls on, and the parts 
+// are then merged. See parallel_coder::train_model. While counts are available, 
+// query_entropy reports the empirical entropy of each context.
+*/
+
+#define EVX_MODEL_FORMAT_VERSION                (1)
+#define EVX_MODEL_HEADER_SIZE                   (16)
+#define EVX_MODEL_STATE_SIZE                    (4)
+#define EVX_MODEL_MAX_CONFIDENCE                (64)
+
+namespace evx {
+
+typedef struct entropy_model_state
+{
+    uint16 probability;                         // probability of a zero, in 1/65536 units.
+    uint16 confidence;                          // number of observations the probability represents.
+} entropy_model_state;
+
+class entropy_model
+{
+    uint32 context_count;
+    uint32 signature;
+    uint64 *counts;
+    uint8 *image;
+    uint32 image_size;
+    bool mapped;
+
+private:
+
+    void release_image();
+    evx_status resolve_image();
+
+public:
+
+    entropy_model();
+    virtual ~entropy_model();
+
+    /* Prepares an empty model for training. Any previously loaded state is discarded. */
+    evx_status create(uint32 count);
+    evx_status train(bitstream *source);
+    evx_status observe(uint32 context_index, uint8 value);
+
+    /* Trains bit_count bits of data from bit_offset, the first of which trains 
+       first_context. */
+    evx_status train(const uint8 *data, uint32 bit_offset, uint32 bit_count, uint32 first_context = 0);
+
+    /* Adds the counts of another model of the same context count to our own. */
+    evx_status merge(const entropy_model &other);
+
+    evx_status save(const char *filename);
+    evx_status load(const char *filename);
+    void clear();
+
+    uint32 query_context_count() const;
+    uint32 query_signature() const;
+    evx_status query_state(uint32 context_index, entropy_model_state *state) const;
+    evx_status query_counts(uint32 context_index, uint64 *zero_count, uint64 *one_count) const;
+
+    /* Returns the empirical entropy of a trained context, in bits per observation. */
+    evx_status query_entropy(uint32 context_index, float64 *bits) const;
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(entropy_model);
+};
+
+} // namespace evx
+
+#endif // __EV_MODEL_H__
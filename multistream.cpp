@@ -0,0 +1,560 @@
+
+#include "multistream.h"
+#include "math.h"
+
+#include "cpu.h"
+
+#if defined (EVX_CPU_X86)
+    #define EVX_MULTISTREAM_X86
+    #include "immintrin.h"
+#endif
+
+/* These mirror the private precision of our entropy_coder. */
+#define EVX_LANE_PRECISION_MAX                  (0xFFFF)
+#define EVX_LANE_ESTIMATE_MAX                   (0x8000)
+#define EVX_LANE_ESTIMATE_HALF                  (0x4000)
+#define EVX_LANE_MAX_RATE                       (14)
+#define EVX_LANE_MAX_BATCH                      (32)
+
+namespace evx {
+
+/*
+// Lane State
+//
+// Each field of our coder state is an array with one entry per lane, so a vector
+// load gathers a field for every lane. Incoming bits are kept msb first in a 32 bit
+// reservoir per lane, and the symbols decoded during a batch collect in output.
+*/
+
+typedef struct alignas(EVX_CACHE_LINE_SIZE) lane_state
+{
+    uint32 low[EVX_MULTISTREAM_MAX_LANES];
+    uint32 high[EVX_MULTISTREAM_MAX_LANES];
+    uint32 value[EVX_MULTISTREAM_MAX_LANES];
+    uint32 estimate[2][EVX_MULTISTREAM_MAX_LANES];
+    uint32 bits[EVX_MULTISTREAM_MAX_LANES];
+    uint32 count[EVX_MULTISTREAM_MAX_LANES];
+    uint32 output[EVX_MULTISTREAM_MAX_LANES];
+    uint32 remaining[EVX_MULTISTREAM_MAX_LANES];
+    decode_stream *active[EVX_MULTISTREAM_MAX_LANES];
+    bool padded[EVX_MULTISTREAM_MAX_LANES];
+
+    decode_stream *streams;
+    uint32 stream_count;
+    uint32 next_stream;
+    uint32 lane_count;
+} lane_state;
+
+static void fetch_lane_bits(lane_state *state, uint32 lane, uint32 needed)
+{
+    if (!state->active[lane])
+    {
+        /* Idle lanes keep stepping alongside the others, so we feed them zeros. */
+        state->bits[lane] = 0;
+        state->count[lane] = EVX_LANE_MAX_BATCH;
+        return;
+    }
+
+    bitstream *source = state->active[lane]->source;
+    uint32 count = state->count[lane];
+    uint32 fill = evx_min2(EVX_LANE_MAX_BATCH - count, source->query_unread_bits());
+
+    if (fill)
+    {
+        uint32 incoming = reverse_bits(source->read_word_unchecked(fill)) >> (32 - fill);
+        state->bits[lane] |= incoming << (32 - count - fill);
+        count += fill;
+    }
+
+    if (count < needed)
+    {
+        /* Our source is exhausted. As in entropy_coder::decode, the remaining bits of
+           this scaling pass repeat the last bit read during the pass (or zero). */
+        if (count && ((state->bits[lane] >> (32 - count)) & 0x1))
+        {
+            state->bits[lane] |= ((uint32(0x1) << (needed - count)) - 1) << (32 - needed);
+        }
+
+        state->padded[lane] = true;
+        count = needed;
+    }
+
+    state->count[lane] = count;
+}
+
+static void reset_lane(lane_state *state, uint32 lane, decode_stream *stream)
+{
+    state->active[lane] = stream;
+    state->remaining[lane] = stream ? stream->symbol_count : 0;
+    state->padded[lane] = false;
+    state->low[lane] = 0;
+    state->high[lane] = EVX_LANE_PRECISION_MAX;
+    state->estimate[0][lane] = EVX_LANE_ESTIMATE_HALF;
+    state->estimate[1][lane] = EVX_LANE_ESTIMATE_HALF;
+    state->bits[lane] = 0;
+    state->count[lane] = 0;
+    state->output[lane] = 0;
+
+    /* Our initial value is read as a single scaling pass of 16 bits. */
+    fetch_lane_bits(state, lane, 16);
+
+    state->value[lane] = state->bits[lane] >> 16;
+    state->bits[lane] <<= 16;
+    state->count[lane] -= 16;
+}
+
+static void start_lane(lane_state *state, uint32 lane)
+{
+    decode_stream *stream = 0;
+
+    while (!stream && state->next_stream < state->stream_count)
+    {
+        stream = &state->streams[state->next_stream++];
+
+        if (!stream->source || !stream->dest)
+        {
+            stream->result = EVX_ERROR_INVALIDARG;
+            stream = 0;
+        }
+        else if (0 == stream->symbol_count)
+        {
+            stream->result = EVX_SUCCESS;
+            stream = 0;
+        }
+    }
+
+    reset_lane(state, lane, stream);
+}
+
+static uint32 query_batch_size(const lane_state *state)
+{
+    /* Every active lane steps through the whole batch, so batches end whenever a lane
+       completes its stream or our output words are full. */
+    uint32 batch_size = 0;
+
+    for (uint32 lane = 0; lane < state->lane_count; ++lane)
+    {
+        if (state->active[lane])
+        {
+            batch_size = evx_min2(batch_size ? batch_size : (uint32) EVX_LANE_MAX_BATCH, state->remaining[lane]);
+        }
+    }
+
+    return batch_size;
+}
+
+static void finish_batch(lane_state *state, uint32 batch_size)
+{
+    for (uint32 lane = 0; lane < state->lane_count; ++lane)
+    {
+        decode_stream *stream = state->active[lane];
+
+        if (!stream)
+        {
+            continue;
+        }
+
+        if (EVX_SUCCESS != stream->dest->ensure_capacity(batch_size))
+        {
+            stream->result = EVX_ERROR_CAPACITY_LIMIT;
+            start_lane(state, lane);
+            continue;
+        }
+
+        stream->dest->write_word_unchecked(state->output[lane], batch_size);
+        state->output[lane] = 0;
+        state->remaining[lane] -= batch_size;
+
+        if (0 == state->remaining[lane])
+        {
+            /* Return any prefetched bits that we did not consume to the source. */
+            if (!state->padded[lane])
+            {
+                stream->source->seek(stream->source->query_read_index() - state->count[lane]);
+            }
+
+            stream->result = EVX_SUCCESS;
+            start_lane(state, lane);
+        }
+    }
+}
+
+static void refill_lanes(lane_state *state, uint32 need_mask, const uint32 *total)
+{
+    while (need_mask)
+    {
+        uint32 lane = count_trailing_zeros(need_mask);
+        fetch_lane_bits(state, lane, total[lane]);
+        need_mask &= need_mask - 1;
+    }
+}
+
+#if defined (EVX_MULTISTREAM_X86)
+
+/*
+// Vector Scaling
+//
+// Each lane resolves its scaling exactly as entropy_coder::renormalize_decoder does,
+// including the 3qtr boundary behavior of E3 steps. Leading and trailing zero counts
+// are derived from bit lengths, which AVX2 obtains through an int to float conversion
+// (exact for our 17 bit operands) and AVX-512 obtains through lzcnt.
+*/
+
+__attribute__((target("avx2")))
+static inline __m256i query_bit_length_avx2(__m256i x)
+{
+    __m256i exponent = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(x)), 23);
+    return _mm256_max_epi32(_mm256_sub_epi32(exponent, _mm256_set1_epi32(126)), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static void decode_lanes_avx2(lane_state *state, const uint8 *rate_shift)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i all_ones = _mm256_set1_epi32(-1);
+    const __m256i precision_mask = _mm256_set1_epi32(EVX_LANE_PRECISION_MAX);
+    const __m256i half_mask = _mm256_set1_epi32(EVX_LANE_PRECISION_MAX >> 1);
+    const __m256i msb_mask = _mm256_set1_epi32(EVX_LANE_ESTIMATE_MAX);
+    const __m256i boundary_bits = _mm256_set1_epi32(0x1FFF);
+    const __m256i estimate_max = _mm256_set1_epi32(EVX_LANE_ESTIMATE_MAX);
+    const __m128i fast_shift = _mm_cvtsi32_si128(rate_shift[0]);
+    const __m128i slow_shift = _mm_cvtsi32_si128(rate_shift[1]);
+
+    uint32 batch_size = 0;
+
+    while (0 != (batch_size = query_batch_size(state)))
+    {
+        __m256i low = _mm256_load_si256((const __m256i *) state->low);
+        __m256i high = _mm256_load_si256((const __m256i *) state->high);
+        __m256i value = _mm256_load_si256((const __m256i *) state->value);
+        __m256i fast = _mm256_load_si256((const __m256i *) state->estimate[0]);
+        __m256i slow = _mm256_load_si256((const __m256i *) state->estimate[1]);
+        __m256i bits = _mm256_load_si256((const __m256i *) state->bits);
+        __m256i count = _mm256_load_si256((const __m256i *) state->count);
+        __m256i output = zero;
+
+        for (uint32 step = 0; step < batch_size; ++step)
+        {
+            /* Decode a symbol in every lane. */
+            __m256i range = _mm256_sub_epi32(high, low);
+            __m256i mid = _mm256_add_epi32(low, _mm256_srli_epi32(_mm256_mullo_epi32(range, _mm256_add_epi32(fast, slow)), 16));
+            __m256i symbol = _mm256_cmpgt_epi32(value, mid);
+
+            low = _mm256_blendv_epi8(low, _mm256_add_epi32(mid, one), symbol);
+            high = _mm256_blendv_epi8(mid, high, symbol);
+            output = _mm256_or_si256(output, _mm256_sll_epi32(_mm256_and_si256(symbol, one), _mm_cvtsi32_si128(step)));
+
+            fast = _mm256_blendv_epi8(_mm256_add_epi32(fast, _mm256_srl_epi32(_mm256_sub_epi32(estimate_max, fast), fast_shift)),
+                                      _mm256_sub_epi32(fast, _mm256_srl_epi32(fast, fast_shift)), symbol);
+            slow = _mm256_blendv_epi8(_mm256_add_epi32(slow, _mm256_srl_epi32(_mm256_sub_epi32(estimate_max, slow), slow_shift)),
+                                      _mm256_sub_epi32(slow, _mm256_srl_epi32(slow, slow_shift)), symbol);
+
+            /* E1/E2 scaling. */
+            __m256i shifts = _mm256_sub_epi32(_mm256_set1_epi32(16), query_bit_length_avx2(_mm256_and_si256(_mm256_xor_si256(low, high), precision_mask)));
+            __m256i shifted_low = _mm256_and_si256(_mm256_sllv_epi32(low, shifts), precision_mask);
+            __m256i shifted_high = _mm256_and_si256(_mm256_or_si256(_mm256_sllv_epi32(high, shifts),
+                                                    _mm256_sub_epi32(_mm256_sllv_epi32(one, shifts), one)), precision_mask);
+
+            /* E3 scaling, limited by the first step at which high would reach 3qtr. */
+            __m256i candidates = _mm256_andnot_si256(shifted_high, _mm256_and_si256(shifted_low, half_mask));
+            __m256i e3_shifts = _mm256_sub_epi32(_mm256_set1_epi32(15), query_bit_length_avx2(_mm256_andnot_si256(candidates, half_mask)));
+            __m256i inverse_high = _mm256_xor_si256(shifted_high, all_ones);
+            __m256i trailing_ones = _mm256_sub_epi32(query_bit_length_avx2(_mm256_and_si256(inverse_high, _mm256_sub_epi32(zero, inverse_high))), one);
+            __m256i boundary_step = _mm256_blendv_epi8(_mm256_sub_epi32(_mm256_set1_epi32(14), trailing_ones), one,
+                                                       _mm256_cmpgt_epi32(trailing_ones, _mm256_set1_epi32(12)));
+            __m256i blocked = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_srli_epi32(shifted_high, 1), boundary_bits), boundary_bits);
+
+            e3_shifts = _mm256_min_epu32(e3_shifts, _mm256_andnot_si256(blocked, boundary_step));
+
+            __m256i has_e3 = _mm256_cmpgt_epi32(e3_shifts, zero);
+            __m256i total_shifts = _mm256_add_epi32(shifts, e3_shifts);
+            __m256i offset = _mm256_sub_epi32(value, low);
+
+            low = _mm256_blendv_epi8(shifted_low, _mm256_and_si256(_mm256_sllv_epi32(shifted_low, e3_shifts), half_mask), has_e3);
+            high = _mm256_blendv_epi8(shifted_high, _mm256_or_si256(_mm256_or_si256(msb_mask, _mm256_and_si256(_mm256_sllv_epi32(shifted_high, e3_shifts), half_mask)),
+                                                                    _mm256_sub_epi32(_mm256_sllv_epi32(one, e3_shifts), one)), has_e3);
+
+            /* Lanes whose reservoirs run low are refilled from their sources. */
+            uint32 need_mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(total_shifts, count)));
+
+            if (need_mask)
+            {
+                alignas(EVX_CACHE_LINE_SIZE) uint32 total[EVX_MULTISTREAM_AVX2_LANES];
+
+                _mm256_store_si256((__m256i *) total, total_shifts);
+                _mm256_store_si256((__m256i *) state->bits, bits);
+                _mm256_store_si256((__m256i *) state->count, count);
+
+                refill_lanes(state, need_mask, total);
+
+                bits = _mm256_load_si256((const __m256i *) state->bits);
+                count = _mm256_load_si256((const __m256i *) state->count);
+            }
+
+            __m256i incoming = _mm256_srlv_epi32(bits, _mm256_sub_epi32(_mm256_set1_epi32(32), total_shifts));
+
+            bits = _mm256_sllv_epi32(bits, total_shifts);
+            count = _mm256_sub_epi32(count, total_shifts);
+            value = _mm256_and_si256(_mm256_add_epi32(_mm256_add_epi32(low, _mm256_sllv_epi32(offset, total_shifts)), incoming), precision_mask);
+        }
+
+        _mm256_store_si256((__m256i *) state->low, low);
+        _mm256_store_si256((__m256i *) state->high, high);
+        _mm256_store_si256((__m256i *) state->value, value);
+        _mm256_store_si256((__m256i *) state->estimate[0], fast);
+        _mm256_store_si256((__m256i *) state->estimate[1], slow);
+        _mm256_store_si256((__m256i *) state->bits, bits);
+        _mm256_store_si256((__m256i *) state->count, count);
+        _mm256_store_si256((__m256i *) state->output, output);
+
+        finish_batch(state, batch_size);
+    }
+}
+
+/* GCC 12 seeds the masked AVX-512 builtins with _mm512_undefined_epi32() and then 
+   flags that placeholder as -Wmaybe-uninitialized once the intrinsics are inlined. 
+   Every lane is written, so silence the header false positive for these kernels only. */
+#if defined (__GNUC__) && !defined (__clang__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx512f,avx512cd")))
+static inline __m512i query_bit_length_avx512(__m512i x)
+{
+    return _mm512_sub_epi32(_mm512_set1_epi32(32), _mm512_lzcnt_epi32(x));
+}
+
+__attribute__((target("avx512f,avx512cd")))
+static void decode_lanes_avx512(lane_state *state, const uint8 *rate_shift)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i precision_mask = _mm512_set1_epi32(EVX_LANE_PRECISION_MAX);
+    const __m512i half_mask = _mm512_set1_epi32(EVX_LANE_PRECISION_MAX >> 1);
+    const __m512i msb_mask = _mm512_set1_epi32(EVX_LANE_ESTIMATE_MAX);
+    const __m512i boundary_bits = _mm512_set1_epi32(0x1FFF);
+    const __m512i estimate_max = _mm512_set1_epi32(EVX_LANE_ESTIMATE_MAX);
+    const __m128i fast_shift = _mm_cvtsi32_si128(rate_shift[0]);
+    const __m128i slow_shift = _mm_cvtsi32_si128(rate_shift[1]);
+
+    uint32 batch_size = 0;
+
+    while (0 != (batch_size = query_batch_size(state)))
+    {
+        __m512i low = _mm512_load_si512(state->low);
+        __m512i high = _mm512_load_si512(state->high);
+        __m512i value = _mm512_load_si512(state->value);
+        __m512i fast = _mm512_load_si512(state->estimate[0]);
+        __m512i slow = _mm512_load_si512(state->estimate[1]);
+        __m512i bits = _mm512_load_si512(state->bits);
+        __m512i count = _mm512_load_si512(state->count);
+        __m512i output = zero;
+
+        for (uint32 step = 0; step < batch_size; ++step)
+        {
+            __m512i range = _mm512_sub_epi32(high, low);
+            __m512i mid = _mm512_add_epi32(low, _mm512_srli_epi32(_mm512_mullo_epi32(range, _mm512_add_epi32(fast, slow)), 16));
+            __mmask16 symbol = _mm512_cmpgt_epi32_mask(value, mid);
+
+            low = _mm512_mask_add_epi32(low, symbol, mid, one);
+            high = _mm512_mask_blend_epi32(symbol, mid, high);
+            output = _mm512_or_si512(output, _mm512_maskz_mov_epi32(symbol, _mm512_set1_epi32(int32(uint32(0x1) << step))));
+
+            fast = _mm512_mask_blend_epi32(symbol, _mm512_add_epi32(fast, _mm512_srl_epi32(_mm512_sub_epi32(estimate_max, fast), fast_shift)),
+                                           _mm512_sub_epi32(fast, _mm512_srl_epi32(fast, fast_shift)));
+            slow = _mm512_mask_blend_epi32(symbol, _mm512_add_epi32(slow, _mm512_srl_epi32(_mm512_sub_epi32(estimate_max, slow), slow_shift)),
+                                           _mm512_sub_epi32(slow, _mm512_srl_epi32(slow, slow_shift)));
+
+            __m512i shifts = _mm512_sub_epi32(_mm512_set1_epi32(16), query_bit_length_avx512(_mm512_and_si512(_mm512_xor_si512(low, high), precision_mask)));
+            __m512i shifted_low = _mm512_and_si512(_mm512_sllv_epi32(low, shifts), precision_mask);
+            __m512i shifted_high = _mm512_and_si512(_mm512_or_si512(_mm512_sllv_epi32(high, shifts),
+                                                    _mm512_sub_epi32(_mm512_sllv_epi32(one, shifts), one)), precision_mask);
+
+            __m512i candidates = _mm512_andnot_si512(shifted_high, _mm512_and_si512(shifted_low, half_mask));
+            __m512i e3_shifts = _mm512_sub_epi32(_mm512_set1_epi32(15), query_bit_length_avx512(_mm512_andnot_si512(candidates, half_mask)));
+            __m512i inverse_high = _mm512_xor_si512(shifted_high, _mm512_set1_epi32(-1));
+            __m512i trailing_ones = _mm512_sub_epi32(query_bit_length_avx512(_mm512_and_si512(inverse_high, _mm512_sub_epi32(zero, inverse_high))), one);
+            __m512i boundary_step = _mm512_mask_blend_epi32(_mm512_cmpgt_epi32_mask(trailing_ones, _mm512_set1_epi32(12)),
+                                                            _mm512_sub_epi32(_mm512_set1_epi32(14), trailing_ones), one);
+            __mmask16 blocked = _mm512_cmpeq_epi32_mask(_mm512_and_si512(_mm512_srli_epi32(shifted_high, 1), boundary_bits), boundary_bits);
+
+            e3_shifts = _mm512_min_epu32(e3_shifts, _mm512_maskz_mov_epi32(~blocked, boundary_step));
+
+            __mmask16 has_e3 = _mm512_cmpgt_epi32_mask(e3_shifts, zero);
+            __m512i total_shifts = _mm512_add_epi32(shifts, e3_shifts);
+            __m512i offset = _mm512_sub_epi32(value, low);
+
+            low = _mm512_mask_blend_epi32(has_e3, shifted_low, _mm512_and_si512(_mm512_sllv_epi32(shifted_low, e3_shifts), half_mask));
+            high = _mm512_mask_blend_epi32(has_e3, shifted_high, _mm512_or_si512(_mm512_or_si512(msb_mask, _mm512_and_si512(_mm512_sllv_epi32(shifted_high, e3_shifts), half_mask)),
+                                                                                 _mm512_sub_epi32(_mm512_sllv_epi32(one, e3_shifts), one)));
+
+            uint32 need_mask = _mm512_cmpgt_epi32_mask(total_shifts, count);
+
+            if (need_mask)
+            {
+                alignas(EVX_CACHE_LINE_SIZE) uint32 total[EVX_MULTISTREAM_AVX512_LANES];
+
+                _mm512_store_si512(total, total_shifts);
+                _mm512_store_si512(state->bits, bits);
+                _mm512_store_si512(state->count, count);
+
+                refill_lanes(state, need_mask, total);
+
+                bits = _mm512_load_si512(state->bits);
+                count = _mm512_load_si512(state->count);
+            }
+
+            __m512i incoming = _mm512_srlv_epi32(bits, _mm512_sub_epi32(_mm512_set1_epi32(32), total_shifts));
+
+            bits = _mm512_sllv_epi32(bits, total_shifts);
+            count = _mm512_sub_epi32(count, total_shifts);
+            value = _mm512_and_si512(_mm512_add_epi32(_mm512_add_epi32(low, _mm512_sllv_epi32(offset, total_shifts)), incoming), precision_mask);
+        }
+
+        _mm512_store_si512(state->low, low);
+        _mm512_store_si512(state->high, high);
+        _mm512_store_si512(state->value, value);
+        _mm512_store_si512(state->estimate[0], fast);
+        _mm512_store_si512(state->estimate[1], slow);
+        _mm512_store_si512(state->bits, bits);
+        _mm512_store_si512(state->count, count);
+        _mm512_store_si512(state->output, output);
+
+        finish_batch(state, batch_size);
+    }
+}
+
+#if defined (__GNUC__) && !defined (__clang__)
+    #pragma GCC diagnostic pop
+#endif
+
+#endif
+
+multi_stream_decoder::multi_stream_decoder(uint8 fast_rate, uint8 slow_rate)
+{
+    /* Rates are clamped exactly as the entropy_coder clamps them. */
+    rate_shift[0] = evx_max2(1, evx_min2(fast_rate, EVX_LANE_MAX_RATE));
+    rate_shift[1] = evx_max2(1, evx_min2(slow_rate, EVX_LANE_MAX_RATE));
+    lane_count = EVX_MULTISTREAM_SCALAR_LANES;
+
+    if (is_lane_count_supported(EVX_MULTISTREAM_AVX512_LANES))
+    {
+        lane_count = EVX_MULTISTREAM_AVX512_LANES;
+    }
+    else if (is_lane_count_supported(EVX_MULTISTREAM_AVX2_LANES))
+    {
+        lane_count = EVX_MULTISTREAM_AVX2_LANES;
+    }
+}
+
+bool multi_stream_decoder::is_lane_count_supported(uint32 count)
+{
+    switch (count)
+    {
+        case EVX_MULTISTREAM_SCALAR_LANES: return true;
+#if defined (EVX_MULTISTREAM_X86)
+        case EVX_MULTISTREAM_AVX2_LANES: return query_cpu_level() >= EVX_CPU_AVX2;
+        case EVX_MULTISTREAM_AVX512_LANES: return query_cpu_level() >= EVX_CPU_AVX512;
+#endif
+    }
+
+    return false;
+}
+
+evx_status multi_stream_decoder::select_lanes(uint32 count)
+{
+    if (!is_lane_count_supported(count))
+    {
+        return evx_post_error(EVX_ERROR_NOTIMPL);
+    }
+
+    lane_count = count;
+
+    return EVX_SUCCESS;
+}
+
+uint32 multi_stream_decoder::query_lane_count() const
+{
+    return lane_count;
+}
+
+evx_status multi_stream_decoder::decode(decode_stream *streams, uint32 stream_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!streams || 0 == stream_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    for (uint32 i = 0; i < stream_count; ++i)
+    {
+        streams[i].result = EVX_ERROR_NOT_READY;
+    }
+
+#if defined (EVX_MULTISTREAM_X86)
+    if (lane_count > EVX_MULTISTREAM_SCALAR_LANES)
+    {
+        lane_state state;
+
+        state.streams = streams;
+        state.stream_count = stream_count;
+        state.next_stream = 0;
+        state.lane_count = lane_count;
+
+        for (uint32 lane = 0; lane < EVX_MULTISTREAM_MAX_LANES; ++lane)
+        {
+            state.active[lane] = 0;
+
+            if (lane < lane_count)
+            {
+                start_lane(&state, lane);
+            }
+            else
+            {
+                reset_lane(&state, lane, 0);
+            }
+        }
+
+        if (EVX_MULTISTREAM_AVX512_LANES == lane_count)
+        {
+            decode_lanes_avx512(&state, rate_shift);
+        }
+        else
+        {
+            decode_lanes_avx2(&state, rate_shift);
+        }
+    }
+    else
+#endif
+    {
+        for (uint32 i = 0; i < stream_count; ++i)
+        {
+            entropy_coder coder(rate_shift[0], rate_shift[1]);
+
+            if (!streams[i].source || !streams[i].dest)
+            {
+                streams[i].result = EVX_ERROR_INVALIDARG;
+                continue;
+            }
+
+            streams[i].result = streams[i].symbol_count ?
+                                coder.decode(streams[i].symbol_count, streams[i].source, streams[i].dest) : EVX_SUCCESS;
+        }
+    }
+
+    for (uint32 i = 0; i < stream_count; ++i)
+    {
+        if (EVX_SUCCESS != streams[i].result)
+        {
+            return streams[i].result;
+        }
+    }
+
+    return EVX_SUCCESS;
+}
+
+} // namespace evx
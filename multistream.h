@@ -0,0 +1,100 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// multistream.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_MULTISTREAM_H__
+#define __EV_MULTISTREAM_H__
+
+#include "cabac.h"
+
+/*
+// Multi-Stream Decoding
+//
+// A multi_stream_decoder decodes many small, independently encoded streams at once.
+// Up to 16 dual rate decoder states are kept in SoA layout (one array per field) and
+// advanced together, one symbol per lane per step, using AVX2 (8 lanes) or AVX-512 
+// (16 lanes). Scaling is resolved for all lanes at once from the leading zeros of
+// low and high, and each lane reads its incoming bits from a small bit reservoir 
+// that is refilled from its source only when it runs low.
+//
+// Whenever a lane completes its stream, it is retired and refilled with the next
+// pending stream, so lanes stay busy until the queue is drained. Processors without
+// vector support fall back to decoding one stream at a time.
+//
+// Streams must have been encoded by an entropy_coder using the same dual rates, and
+// output is identical to entropy_coder::decode.
+*/
+
+#define EVX_MULTISTREAM_SCALAR_LANES            (1)
+#define EVX_MULTISTREAM_AVX2_LANES              (8)
+#define EVX_MULTISTREAM_AVX512_LANES            (16)
+#define EVX_MULTISTREAM_MAX_LANES               (EVX_MULTISTREAM_AVX512_LANES)
+
+namespace evx {
+
+typedef struct decode_stream
+{
+    bitstream *source;
+    bitstream *dest;
+    uint32 symbol_count;
+    evx_status result;
+} decode_stream;
+
+class multi_stream_decoder
+{
+    uint8 rate_shift[2];
+    uint32 lane_count;
+
+public:
+
+    multi_stream_decoder(uint8 fast_rate = EVX_ENTROPY_DEFAULT_FAST_RATE, 
+                         uint8 slow_rate = EVX_ENTROPY_DEFAULT_SLOW_RATE);
+
+    /* Selects the lane count (and thus the instruction set) used to decode. We default
+       to the widest allowed by the cpu level at construction (see cpu.h). */
+    evx_status select_lanes(uint32 count);
+    uint32 query_lane_count() const;
+    static bool is_lane_count_supported(uint32 count);
+
+    /* Decodes every stream, recording a result for each. The first failure (if any) 
+       is returned. */
+    evx_status decode(decode_stream *streams, uint32 stream_count);
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(multi_stream_decoder);
+};
+
+} // namespace evx
+
+#endif // __EV_MULTISTREAM_H__
@@ -0,0 +1,692 @@
+
+#include "parallel.h"
+#include "math.h"
+#include "memory.h"
+#include "sink.h"
+
+#define EVX_PARALLEL_STAGING_SIZE               (64 * EVX_KB)
+
+namespace evx {
+
+/* A chunk is the unit of work handed to the scheduler. Chunk outputs are allocated 
+   by the task that codes them, so that their memory is first touched (and placed) 
+   by the worker that produces it. */
+typedef struct parallel_chunk
+{
+    uint8 rate_shift[2];
+    uint32 bit_count;
+    const uint8 *input;
+    uint32 input_size;
+    uint8 input_bit;
+    std::vector<uint8> coded;
+    bitstream *decoded;
+    evx_status result;
+} parallel_chunk;
+
+typedef struct parallel_job
+{
+    coding_job *job;
+    parallel_chunk *chunks;
+    uint32 chunk_count;
+    uint32 chunk_bits;
+    uint32 bit_count;
+    uint8 rate_shift[2];
+    std::vector<uint8> header;
+} parallel_job;
+
+typedef struct parallel_count
+{
+    const uint8 *input;
+    uint32 input_bit;
+    uint32 bit_count;
+    uint32 one_count;
+} parallel_count;
+
+/* A span of a training corpus, counted into a model allocated by the worker. */
+typedef struct parallel_statistics
+{
+    const uint8 *input;
+    uint32 input_bit;
+    uint32 bit_count;
+    uint32 first_context;
+    uint32 context_count;
+    entropy_model model;
+    evx_status result;
+} parallel_statistics;
+
+/* A range of an indexed stream, decoded from its starting checkpoint (or from the
+   start of the stream if it has none). */
+typedef struct parallel_range
+{
+    uint8 rate_shift[2];
+    const bitstream *source;
+    bool resume;
+    entropy_checkpoint checkpoint;
+    uint32 symbol_count;
+    bitstream *decoded;
+    evx_status result;
+} parallel_range;
+
+static void encode_chunk(void *context)
+{
+    parallel_chunk *chunk = reinterpret_cast<parallel_chunk *>(context);
+    entropy_coder coder(chunk->rate_shift[0], chunk->rate_shift[1]);
+
+    /* We code directly from the job source through a view of the chunk's bits. */
+    vector_sink coded_sink(&chunk->coded);
+    bitstream source;
+    bitstream staging(EVX_PARALLEL_STAGING_SIZE << 3);
+    staging.attach_sink(&coded_sink);
+
+    if (EVX_SUCCESS != source.wrap(const_cast<uint8 *>(chunk->input), chunk->input_size) ||
+        EVX_SUCCESS != source.seek(chunk->input_bit) ||
+        EVX_SUCCESS != source.truncate(chunk->input_bit + chunk->bit_count) ||
+        EVX_SUCCESS != coder.encode(&source, &staging) ||
+        EVX_SUCCESS != staging.flush_sink(true) || chunk->coded.empty())
+    {
+        chunk->result = EVX_ERROR_EXECUTION_FAILURE;
+        return;
+    }
+
+    chunk->result = EVX_SUCCESS;
+}
+
+static void decode_chunk(void *context)
+{
+    parallel_chunk *chunk = reinterpret_cast<parallel_chunk *>(context);
+    entropy_coder coder(chunk->rate_shift[0], chunk->rate_shift[1]);
+    bitstream source;
+
+    chunk->decoded = new bitstream(chunk->bit_count);
+
+    if (!chunk->decoded ||
+        EVX_SUCCESS != source.wrap(const_cast<uint8 *>(chunk->input), chunk->input_size) ||
+        EVX_SUCCESS != coder.decode(chunk->bit_count, &source, chunk->decoded))
+    {
+        chunk->result = EVX_ERROR_EXECUTION_FAILURE;
+        return;
+    }
+
+    chunk->result = EVX_SUCCESS;
+}
+
+static void decode_range(void *context)
+{
+    parallel_range *range = reinterpret_cast<parallel_range *>(context);
+    entropy_coder coder(range->rate_shift[0], range->rate_shift[1]);
+    const bitstream *stream = range->source;
+    bitstream source;
+
+    range->decoded = new bitstream(range->symbol_count);
+
+    /* Every range reads through its own view of the shared stream. */
+    if (!range->decoded ||
+        EVX_SUCCESS != source.wrap(stream->query_data(), (stream->query_write_index() + 7) >> 3) ||
+        EVX_SUCCESS != source.truncate(stream->query_write_index()) ||
+        EVX_SUCCESS != source.seek(stream->query_read_index()) ||
+        (range->resume && EVX_SUCCESS != coder.resume_decode(range->checkpoint, &source)) ||
+        EVX_SUCCESS != coder.decode(range->symbol_count, &source, range->decoded, !range->resume))
+    {
+        range->result = EVX_ERROR_EXECUTION_FAILURE;
+        return;
+    }
+
+    range->result = EVX_SUCCESS;
+}
+
+static evx_status resolve_job_result(parallel_job *state)
+{
+    for (uint32 i = 0; i < state->chunk_count; ++i)
+    {
+        if (EVX_SUCCESS != state->chunks[i].result)
+        {
+            return state->chunks[i].result;
+        }
+    }
+
+    return EVX_SUCCESS;
+}
+
+static void assemble_encoded_job(void *context)
+{
+    parallel_job *state = reinterpret_cast<parallel_job *>(context);
+    coding_job *job = state->job;
+
+    if (EVX_SUCCESS != (job->result = resolve_job_result(state)))
+    {
+        return;
+    }
+
+    state->header.resize(EVX_PARALLEL_HEADER_SIZE + (state->chunk_count << 2));
+    store_u32(&state->header[0], state->bit_count);
+    store_u32(&state->header[4], state->chunk_bits);
+    store_u32(&state->header[8], state->chunk_count);
+    store_u32(&state->header[12], state->rate_shift[0] | (state->rate_shift[1] << 8));
+
+    for (uint32 i = 0; i < state->chunk_count; ++i)
+    {
+        store_u32(&state->header[EVX_PARALLEL_HEADER_SIZE + (i << 2)], (uint32) state->chunks[i].coded.size());
+    }
+
+    /* Every piece is a whole number of bytes, so a single append emits the container. */
+    std::vector<bitstream> views(state->chunk_count + 1);
+    std::vector<const bitstream *> pieces(state->chunk_count + 1);
+
+    views[0].wrap(&state->header[0], (uint32) state->header.size());
+    pieces[0] = &views[0];
+
+    for (uint32 i = 0; i < state->chunk_count; ++i)
+    {
+        views[i + 1].wrap(&state->chunks[i].coded[0], (uint32) state->chunks[i].coded.size());
+        pieces[i + 1] = &views[i + 1];
+    }
+
+    if (EVX_SUCCESS != job->dest->append(&pieces[0], (uint32) pieces.size()))
+    {
+        job->result = EVX_ERROR_CAPACITY_LIMIT;
+    }
+}
+
+static void assemble_decoded_job(void *context)
+{
+    parallel_job *state = reinterpret_cast<parallel_job *>(context);
+    coding_job *job = state->job;
+
+    if (EVX_SUCCESS != (job->result = resolve_job_result(state)) || 0 == state->chunk_count)
+    {
+        return;
+    }
+
+    std::vector<const bitstream *> pieces(state->chunk_count);
+
+    for (uint32 i = 0; i < state->chunk_count; ++i)
+    {
+        pieces[i] = state->chunks[i].decoded;
+    }
+
+    if (EVX_SUCCESS != job->dest->append(&pieces[0], state->chunk_count))
+    {
+        job->result = EVX_ERROR_CAPACITY_LIMIT;
+    }
+}
+
+static void count_chunk(void *context)
+{
+    parallel_count *chunk = reinterpret_cast<parallel_count *>(context);
+    chunk->one_count = count_set_bits(chunk->input, chunk->input_bit, chunk->bit_count);
+}
+
+static void train_span(void *context)
+{
+    parallel_statistics *span = reinterpret_cast<parallel_statistics *>(context);
+
+    if (EVX_SUCCESS != span->model.create(span->context_count) ||
+        EVX_SUCCESS != span->model.train(span->input, span->input_bit, span->bit_count, span->first_context))
+    {
+        span->result = EVX_ERROR_EXECUTION_FAILURE;
+    }
+}
+
+static evx_status resolve_batch_result(coding_job *jobs, uint32 job_count)
+{
+    for (uint32 i = 0; i < job_count; ++i)
+    {
+        if (EVX_SUCCESS != jobs[i].result)
+        {
+            return jobs[i].result;
+        }
+    }
+
+    return EVX_SUCCESS;
+}
+
+parallel_coder::parallel_coder(task_scheduler *target, uint32 chunk_bytes, uint8 fast_rate, uint8 slow_rate)
+{
+    scheduler = target;
+    /* Chunks are addressed in bits, so their byte size must fit in 29 bits. */
+    chunk_size = evx_min2(evx_max2(chunk_bytes, 1u), (uint32) EVX_PARALLEL_MAX_CHUNK_SIZE);
+    rate_shift[0] = fast_rate;
+    rate_shift[1] = slow_rate;
+}
+
+evx_status parallel_coder::encode(bitstream *source, bitstream *dest)
+{
+    coding_job job = { source, dest, EVX_SUCCESS };
+    return encode_batch(&job, 1);
+}
+
+evx_status parallel_coder::decode(bitstream *source, bitstream *dest)
+{
+    coding_job job = { source, dest, EVX_SUCCESS };
+    return decode_batch(&job, 1);
+}
+
+evx_status parallel_coder::encode_batch(coding_job *jobs, uint32 job_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!scheduler || !jobs || 0 == job_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+
+        for (uint32 i = 0; i < job_count; ++i)
+        {
+            if (!jobs[i].source || !jobs[i].dest)
+            {
+                return evx_post_error(EVX_ERROR_INVALIDARG);
+            }
+        }
+    }
+
+    uint32 chunk_bits = chunk_size << 3;
+    uint32 total_chunks = 0;
+
+    for (uint32 i = 0; i < job_count; ++i)
+    {
+        total_chunks += (uint32) ((jobs[i].source->query_occupancy() + (uint64) chunk_bits - 1) / chunk_bits);
+    }
+
+    /* All bookkeeping is allocated before the first task is submitted so that
+       tasks may hold pointers into it. */
+    std::vector<parallel_chunk> chunks(total_chunks);
+    std::vector<parallel_job> states(job_count);
+    uint32 chunk_index = 0;
+    task_group batch;
+
+    for (uint32 i = 0; i < job_count; ++i)
+    {
+        bitstream *source = jobs[i].source;
+        parallel_job *state = &states[i];
+
+        state->job = &jobs[i];
+        state->chunks = chunks.data() + chunk_index;
+        state->bit_count = source->query_occupancy();
+        state->chunk_bits = chunk_bits;
+        state->chunk_count = (uint32) ((state->bit_count + (uint64) chunk_bits - 1) / chunk_bits);
+        state->rate_shift[0] = rate_shift[0];
+        state->rate_shift[1] = rate_shift[1];
+
+        for (uint32 j = 0; j < state->chunk_count; ++j)
+        {
+            parallel_chunk *chunk = &state->chunks[j];
+            uint32 bit_offset = source->query_read_index() + j * chunk_bits;
+
+            chunk->rate_shift[0] = rate_shift[0];
+            chunk->rate_shift[1] = rate_shift[1];
+            chunk->bit_count = evx_min2(chunk_bits, state->bit_count - j * chunk_bits);
+            chunk->input = source->query_data() + (bit_offset >> 3);
+            chunk->input_bit = bit_offset & 0x7;
+            chunk->input_size = (chunk->input_bit + chunk->bit_count + 7) >> 3;
+            chunk->decoded = 0;
+            chunk->result = EVX_ERROR_NOT_READY;
+        }
+
+        chunk_index += state->chunk_count;
+    }
+
+    for (uint32 i = 0; i < total_chunks; ++i)
+    {
+        scheduler->submit(encode_chunk, &chunks[i], &batch);
+    }
+
+    scheduler->wait(&batch);
+
+    /* Containers are assembled once every chunk of the batch is coded. Jobs write to 
+       distinct streams, so their assembly may also proceed in parallel. */
+    for (uint32 i = 0; i < job_count; ++i)
+    {
+        scheduler->submit(assemble_encoded_job, &states[i], &batch);
+    }
+
+    scheduler->wait(&batch);
+
+    for (uint32 i = 0; i < job_count; ++i)
+    {
+        if (EVX_SUCCESS == jobs[i].result)
+        {
+            jobs[i].source->seek(jobs[i].source->query_write_index());
+        }
+    }
+
+    return resolve_batch_result(jobs, job_count);
+}
+
+evx_status parallel_coder::decode_batch(coding_job *jobs, uint32 job_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!scheduler || !jobs || 0 == job_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+
+        for (uint32 i = 0; i < job_count; ++i)
+        {
+            if (!jobs[i].source || !jobs[i].dest)
+            {
+                return evx_post_error(EVX_ERROR_INVALIDARG);
+            }
+        }
+    }
+
+    std::vector<parallel_job> states(job_count);
+    uint32 total_chunks = 0;
+    task_group batch;
+
+    /* Headers are small, so we parse them up front to size our chunk list. */
+    for (uint32 i = 0; i < job_count; ++i)
+    {
+        bitstream *source = jobs[i].source;
+        parallel_job *state = &states[i];
+        uint8 header[EVX_PARALLEL_HEADER_SIZE];
+        uint32 byte_count = EVX_PARALLEL_HEADER_SIZE;
+
+        state->job = &jobs[i];
+        state->chunks = 0;
+        state->chunk_count = 0;
+        jobs[i].result = EVX_ERROR_INVALID_RESOURCE;
+
+        if (source->query_occupancy() < (EVX_PARALLEL_HEADER_SIZE << 3) ||
+            EVX_SUCCESS != source->read_bytes(header, &byte_count))
+        {
+            continue;
+        }
+
+        state->bit_count = load_u32(header);
+        state->chunk_bits = load_u32(header + 4);
+        state->chunk_count = load_u32(header + 8);
+        state->rate_shift[0] = header[12];
+        state->rate_shift[1] = header[13];
+
+        if (0 == state->chunk_bits || (state->chunk_bits & 0x7) ||
+            state->chunk_count != (state->bit_count + (uint64) state->chunk_bits - 1) / state->chunk_bits ||
+            source->query_occupancy() < ((uint64) state->chunk_count << 5))
+        {
+            state->chunk_count = 0;
+            continue;
+        }
+
+        state->header.resize(state->chunk_count << 2);
+        byte_count = (uint32) state->header.size();
+
+        if (byte_count && EVX_SUCCESS != source->read_bytes(&state->header[0], &byte_count))
+        {
+            state->chunk_count = 0;
+            continue;
+        }
+
+        jobs[i].result = EVX_SUCCESS;
+        total_chunks += state->chunk_count;
+    }
+
+    std::vector<parallel_chunk> chunks(total_chunks);
+    uint32 chunk_index = 0;
+
+    for (uint32 i = 0; i < job_count; ++i)
+    {
+        bitstream *source = jobs[i].source;
+        parallel_job *state = &states[i];
+
+        if (EVX_SUCCESS != jobs[i].result)
+        {
+            continue;
+        }
+
+        state->chunks = chunks.data() + chunk_index;
+        chunk_index += state->chunk_count;
+
+        for (uint32 j = 0; j < state->chunk_count; ++j)
+        {
+            parallel_chunk *chunk = &state->chunks[j];
+
+            chunk->rate_shift[0] = state->rate_shift[0];
+            chunk->rate_shift[1] = state->rate_shift[1];
+            chunk->bit_count = evx_min2(state->chunk_bits, state->bit_count - j * state->chunk_bits);
+            chunk->input_size = load_u32(&state->header[j << 2]);
+            chunk->input_bit = 0;
+            chunk->decoded = 0;
+            chunk->result = EVX_ERROR_NOT_READY;
+
+            if (0 == chunk->input_size || source->query_occupancy() < ((uint64) chunk->input_size << 3))
+            {
+                jobs[i].result = EVX_ERROR_INVALID_RESOURCE;
+                break;
+            }
+
+            /* Aligned sources are decoded in place, otherwise we realign a copy. */
+            if (0 == (source->query_read_index() & 0x7))
+            {
+                chunk->input = source->query_data() + (source->query_read_index() >> 3);
+                source->seek(source->query_read_index() + (chunk->input_size << 3));
+            }
+            else
+            {
+                uint32 byte_count = chunk->input_size;
+                chunk->coded.resize(byte_count);
+                source->read_bytes(&chunk->coded[0], &byte_count);
+                chunk->input = &chunk->coded[0];
+            }
+        }
+    }
+
+    for (uint32 i = 0; i < job_count; ++i)
+    {
+        if (EVX_SUCCESS != jobs[i].result)
+        {
+            continue;
+        }
+
+        for (uint32 j = 0; j < states[i].chunk_count; ++j)
+        {
+            scheduler->submit(decode_chunk, &states[i].chunks[j], &batch);
+        }
+    }
+
+    scheduler->wait(&batch);
+
+    for (uint32 i = 0; i < job_count; ++i)
+    {
+        if (EVX_SUCCESS == jobs[i].result)
+        {
+            scheduler->submit(assemble_decoded_job, &states[i], &batch);
+        }
+    }
+
+    scheduler->wait(&batch);
+
+    for (uint32 i = 0; i < total_chunks; ++i)
+    {
+        delete chunks[i].decoded;
+    }
+
+    return resolve_batch_result(jobs, job_count);
+}
+
+evx_status parallel_coder::decode_indexed(const entropy_index &index, bitstream *source, bitstream *dest)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!scheduler || !source || !dest)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint32 symbol_count = index.query_symbol_count();
+    uint32 range_bits = chunk_size << 3;
+    std::vector<parallel_range> ranges;
+    parallel_range range;
+    task_group batch;
+
+    if (0 == symbol_count)
+    {
+        return EVX_SUCCESS;
+    }
+
+    range.rate_shift[0] = rate_shift[0];
+    range.rate_shift[1] = rate_shift[1];
+    range.source = source;
+    range.resume = false;
+    range.symbol_count = 0;
+    range.decoded = 0;
+    range.result = EVX_ERROR_NOT_READY;
+    memset(&range.checkpoint, 0, sizeof(range.checkpoint));
+    ranges.push_back(range);
+
+    /* The first range always decodes from the start of the stream. Later ranges begin
+       at the first entry that leaves the previous range at least range_bits long. */
+    uint32 range_start = 0;
+
+    for (uint32 i = 0; i < index.query_entry_count(); ++i)
+    {
+        entropy_index_entry entry;
+        index.query_entry(i, &entry);
+
+        if (entry.symbol_index >= symbol_count)
+        {
+            break;
+        }
+
+        if (entry.symbol_index - range_start < range_bits)
+        {
+            continue;
+        }
+
+        ranges.back().symbol_count = entry.symbol_index - range_start;
+        range.resume = true;
+        range.checkpoint = entry.checkpoint;
+        ranges.push_back(range);
+        range_start = entry.symbol_index;
+    }
+
+    ranges.back().symbol_count = symbol_count - range_start;
+
+    for (uint32 i = 0; i < ranges.size(); ++i)
+    {
+        scheduler->submit(decode_range, &ranges[i], &batch);
+    }
+
+    scheduler->wait(&batch);
+
+    evx_status result = EVX_SUCCESS;
+    std::vector<const bitstream *> pieces(ranges.size());
+
+    for (uint32 i = 0; i < ranges.size(); ++i)
+    {
+        pieces[i] = ranges[i].decoded;
+
+        if (EVX_SUCCESS != ranges[i].result)
+        {
+            result = evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+    }
+
+    if (EVX_SUCCESS == result && EVX_SUCCESS != dest->append(&pieces[0], (uint32) pieces.size()))
+    {
+        result = evx_post_error(EVX_ERROR_CAPACITY_LIMIT);
+    }
+
+    for (uint32 i = 0; i < ranges.size(); ++i)
+    {
+        delete ranges[i].decoded;
+    }
+
+    if (EVX_SUCCESS == result)
+    {
+        source->seek(source->query_write_index());
+    }
+
+    return result;
+}
+
+evx_status parallel_coder::measure_probability(const bitstream &source, uint16 *probability)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!scheduler || !probability)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint32 chunk_bits = chunk_size << 3;
+    uint32 symbol_count = source.query_occupancy();
+    uint32 chunk_count = (uint32) ((symbol_count + (uint64) chunk_bits - 1) / chunk_bits);
+    std::vector<parallel_count> chunks(chunk_count);
+    task_group batch;
+
+    for (uint32 i = 0; i < chunk_count; ++i)
+    {
+        chunks[i].input = source.query_data();
+        chunks[i].input_bit = source.query_read_index() + i * chunk_bits;
+        chunks[i].bit_count = evx_min2(chunk_bits, symbol_count - i * chunk_bits);
+        chunks[i].one_count = 0;
+
+        scheduler->submit(count_chunk, &chunks[i], &batch);
+    }
+
+    scheduler->wait(&batch);
+
+    uint64 one_count = 0;
+
+    for (uint32 i = 0; i < chunk_count; ++i)
+    {
+        one_count += chunks[i].one_count;
+    }
+
+    *probability = entropy_coder::quantize_probability(symbol_count - one_count, symbol_count);
+
+    return EVX_SUCCESS;
+}
+
+evx_status parallel_coder::train_model(const bitstream &source, entropy_model *model)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!scheduler || !model || !model->query_context_count())
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* Spans cover whole chunks, and there are never more spans than workers, so the
+       number of partial models (and their memory) is bounded by the pool size. */
+    uint32 chunk_bits = chunk_size << 3;
+    uint32 symbol_count = source.query_occupancy();
+    uint32 chunk_count = (uint32) ((symbol_count + (uint64) chunk_bits - 1) / chunk_bits);
+    uint32 span_count = evx_min2(chunk_count, scheduler->query_worker_count());
+    uint32 span_chunks = span_count ? (chunk_count + span_count - 1) / span_count : 0;
+    uint32 context_count = model->query_context_count();
+    std::vector<parallel_statistics> spans(span_count);
+    task_group batch;
+
+    for (uint32 i = 0; i < span_count; ++i)
+    {
+        uint64 span_start = (uint64) i * span_chunks * chunk_bits;
+        uint64 span_end = evx_min2(span_start + (uint64) span_chunks * chunk_bits, (uint64) symbol_count);
+
+        spans[i].input = source.query_data();
+        spans[i].input_bit = source.query_read_index() + (uint32) span_start;
+        spans[i].bit_count = (span_end > span_start) ? (uint32) (span_end - span_start) : 0;
+        spans[i].first_context = (uint32) (span_start % context_count);
+        spans[i].context_count = context_count;
+        spans[i].result = EVX_SUCCESS;
+
+        scheduler->submit(train_span, &spans[i], &batch);
+    }
+
+    scheduler->wait(&batch);
+
+    for (uint32 i = 0; i < span_count; ++i)
+    {
+        if (EVX_SUCCESS != spans[i].result || EVX_SUCCESS != model->merge(spans[i].model))
+        {
+            return evx_post_error(EVX_ERROR_EXECUTION_FAILURE);
+        }
+    }
+
+    return EVX_SUCCESS;
+}
+
+} // namespace evx
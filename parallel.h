@@ -0,0 +1,121 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// parallel.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_PARALLEL_H__
+#define __EV_PARALLEL_H__
+
+#include "cabac.h"
+#include "index.h"
+#include "model.h"
+#include "scheduler.h"
+
+/*
+// Parallel Coding
+//
+// A parallel_coder codes one or more independent jobs on a task_scheduler. Each job
+// is split into chunks of at most chunk_size bytes that are coded independently, so 
+// small jobs run whole as a single task while large jobs are spread across every 
+// worker. Since workers steal from one another, a batch that mixes tiny and huge 
+// payloads keeps all workers busy until the last chunk completes. Each call waits 
+// only on its own tasks, so several threads may share a single scheduler.
+//
+// Every job is coded as a self describing container. All fields are little endian:
+//
+//   [0]   uint32  symbol (bit) count
+//   [4]   uint32  chunk size, in bits
+//   [8]   uint32  chunk count
+//   [12]  uint32  coder rates (fast | slow << 8)
+//   [16]  uint32  coded byte count, one per chunk
+//         coded chunks, each padded to a whole byte.
+//
+// Encoding consumes each job source and appends to its dest. Decoding consumes a
+// single container from each job source.
+*/
+
+#define EVX_PARALLEL_HEADER_SIZE                (16)
+#define EVX_PARALLEL_DEFAULT_CHUNK_SIZE         (EVX_MB)
+#define EVX_PARALLEL_MAX_CHUNK_SIZE             (0x1FFFFFFF)
+
+namespace evx {
+
+typedef struct coding_job
+{
+    bitstream *source;
+    bitstream *dest;
+    evx_status result;
+} coding_job;
+
+class parallel_coder
+{
+    task_scheduler *scheduler;
+    uint32 chunk_size;
+    uint8 rate_shift[2];
+
+public:
+
+    parallel_coder(task_scheduler *target, uint32 chunk_bytes = EVX_PARALLEL_DEFAULT_CHUNK_SIZE,
+                   uint8 fast_rate = EVX_ENTROPY_DEFAULT_FAST_RATE, 
+                   uint8 slow_rate = EVX_ENTROPY_DEFAULT_SLOW_RATE);
+
+    /* Codes a single job, splitting it into chunks as required. */
+    evx_status encode(bitstream *source, bitstream *dest);
+    evx_status decode(bitstream *source, bitstream *dest);
+
+    /* Codes a batch of jobs. Each job records its own result, and the first failure 
+       (if any) is returned. */
+    evx_status encode_batch(coding_job *jobs, uint32 job_count);
+    evx_status decode_batch(coding_job *jobs, uint32 job_count);
+
+    /* Decodes a single adaptive stream produced by entropy_coder::encode_indexed. The 
+       stream is split at index entries into ranges of at least chunk_size bytes of 
+       output, which are decoded in parallel. Our rates must match the encoder's. */
+    evx_status decode_indexed(const entropy_index &index, bitstream *source, bitstream *dest);
+
+    /* The first pass of semi-static coding, measured over chunks in parallel. See
+       entropy_coder::measure_probability. */
+    evx_status measure_probability(const bitstream &source, uint16 *probability);
+
+    /* Trains model from source as entropy_model::train would, without consuming it.
+       Each worker counts a contiguous span into its own model, and the spans are 
+       merged once every worker completes. No coding is performed. */
+    evx_status train_model(const bitstream &source, entropy_model *model);
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(parallel_coder);
+};
+
+} // namespace evx
+
+#endif // __EV_PARALLEL_H__
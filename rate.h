@@ -0,0 +1,98 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// rate.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_RATE_H__
+#define __EV_RATE_H__
+
+#include "base.h"
+
+/*
+// Rate Estimation
+//
+// Costs are expressed in 1/256 bit units. The table below holds -log2(p) * 256 for
+// probabilities quantized to 1/512 steps, sampled at the center of each step.
+*/
+
+#define EVX_RATE_PRECISION                      (8)
+#define EVX_RATE_ONE_BIT                        (0x1 << EVX_RATE_PRECISION)
+#define EVX_RATE_LUT_PRECISION                  (9)
+
+namespace evx {
+
+const uint16 rate_cost_lut[] = {
+    2560, 2154, 1966, 1841, 1748, 1674, 1613, 1560, 1514, 1473, 1436, 1402, 1371, 1343, 1316, 1292,
+    1269, 1247, 1226, 1207, 1188, 1171, 1154, 1138, 1123, 1108, 1094, 1080, 1067, 1054, 1042, 1030,
+    1018, 1007,  996,  986,  975,  965,  956,  946,  937,  928,  919,  911,  902,  894,  886,  878,
+     870,  863,  855,  848,  841,  834,  827,  821,  814,  808,  801,  795,  789,  783,  777,  771,
+     765,  759,  754,  748,  743,  738,  732,  727,  722,  717,  712,  707,  702,  697,  693,  688,
+     683,  679,  674,  670,  665,  661,  657,  652,  648,  644,  640,  636,  632,  628,  624,  620,
+     616,  613,  609,  605,  601,  598,  594,  590,  587,  583,  580,  576,  573,  570,  566,  563,
+     560,  556,  553,  550,  547,  544,  540,  537,  534,  531,  528,  525,  522,  519,  516,  513,
+     511,  508,  505,  502,  499,  496,  494,  491,  488,  486,  483,  480,  478,  475,  472,  470,
+     467,  465,  462,  460,  457,  455,  452,  450,  447,  445,  443,  440,  438,  435,  433,  431,
+     428,  426,  424,  422,  419,  417,  415,  413,  410,  408,  406,  404,  402,  400,  398,  395,
+     393,  391,  389,  387,  385,  383,  381,  379,  377,  375,  373,  371,  369,  367,  365,  363,
+     361,  359,  357,  356,  354,  352,  350,  348,  346,  344,  343,  341,  339,  337,  335,  334,
+     332,  330,  328,  327,  325,  323,  321,  320,  318,  316,  314,  313,  311,  309,  308,  306,
+     304,  303,  301,  300,  298,  296,  295,  293,  292,  290,  288,  287,  285,  284,  282,  281,
+     279,  278,  276,  274,  273,  271,  270,  268,  267,  265,  264,  263,  261,  260,  258,  257,
+     255,  254,  252,  251,  250,  248,  247,  245,  244,  243,  241,  240,  238,  237,  236,  234,
+     233,  232,  230,  229,  228,  226,  225,  224,  222,  221,  220,  218,  217,  216,  214,  213,
+     212,  211,  209,  208,  207,  206,  204,  203,  202,  201,  199,  198,  197,  196,  194,  193,
+     192,  191,  190,  188,  187,  186,  185,  184,  182,  181,  180,  179,  178,  176,  175,  174,
+     173,  172,  171,  170,  168,  167,  166,  165,  164,  163,  162,  161,  159,  158,  157,  156,
+     155,  154,  153,  152,  151,  150,  148,  147,  146,  145,  144,  143,  142,  141,  140,  139,
+     138,  137,  136,  135,  134,  133,  132,  131,  130,  129,  128,  127,  125,  124,  123,  122,
+     121,  120,  119,  118,  117,  116,  116,  115,  114,  113,  112,  111,  110,  109,  108,  107,
+     106,  105,  104,  103,  102,  101,  100,   99,   98,   97,   96,   95,   94,   93,   93,   92,
+      91,   90,   89,   88,   87,   86,   85,   84,   83,   83,   82,   81,   80,   79,   78,   77,
+      76,   75,   74,   74,   73,   72,   71,   70,   69,   68,   67,   67,   66,   65,   64,   63,
+      62,   61,   61,   60,   59,   58,   57,   56,   56,   55,   54,   53,   52,   51,   51,   50,
+      49,   48,   47,   46,   46,   45,   44,   43,   42,   42,   41,   40,   39,   38,   38,   37,
+      36,   35,   34,   34,   33,   32,   31,   30,   30,   29,   28,   27,   27,   26,   25,   24,
+      23,   23,   22,   21,   20,   20,   19,   18,   17,   17,   16,   15,   14,   14,   13,   12,
+      11,   11,   10,    9,    8,    8,    7,    6,    5,    5,    4,    3,    3,    2,    1,    0,
+};
+
+/* Returns the cost of coding a symbol whose probability is expressed in 1/65536 units.
+   Probabilities are clamped to [1, 0xFFFF], so a certain symbol is free. */
+inline uint32 query_rate_cost(uint32 probability) 
+{
+    probability = (probability < 1) ? 1 : ((probability > 0xFFFF) ? 0xFFFF : probability);
+    return rate_cost_lut[probability >> (16 - EVX_RATE_LUT_PRECISION)];
+}
+
+} // namespace evx
+
+#endif // __EV_RATE_H__
@@ -0,0 +1,334 @@
+
+#include "residual.h"
+#include "math.h"
+
+namespace evx {
+
+/* The number of contexts each size class uses within each context group. */
+static const uint32 residual_group_size[EVX_RESIDUAL_CONTEXT_GROUPS] = 
+{
+    1, EVX_RESIDUAL_LAST_CONTEXTS, EVX_RESIDUAL_LAST_CONTEXTS, 
+    EVX_RESIDUAL_SIG_CONTEXTS, EVX_RESIDUAL_LEVEL_CONTEXTS, EVX_RESIDUAL_LEVEL_CONTEXTS
+};
+
+/* Accumulates the clipped magnitudes of our five template neighbors: two to the right,
+   two below, and one diagonal. All of these follow the current position in diagonal
+   scan order, so they have already been coded when traversing in reverse. */
+static inline void query_template(const uint8 *level, uint32 stride, uint8 *sig_count, uint8 *excess)
+{
+    uint8 neighbors[5] = { level[1], level[2], level[stride], level[stride << 1], level[stride + 1] };
+    uint8 count = 0;
+    uint8 sum = 0;
+
+    for (uint8 i = 0; i < 5; ++i)
+    {
+        count += (neighbors[i] != 0);
+        sum += neighbors[i];
+    }
+
+    *sig_count = count;
+    *excess = sum - count;
+}
+
+static inline uint8 query_region(uint8 x, uint8 y)
+{
+    /* The dc coefficient and the lowest frequencies are far more likely to be 
+       significant than the rest of a block, so they adapt separately. */
+    return (0 == x + y) ? 0 : ((x + y < 3) ? 1 : 2);
+}
+
+residual_coder::residual_coder(entropy_coder *entropy)
+{
+    coder = entropy;
+    memset(levels, 0, sizeof(levels));
+
+    uint32 group_sizes[EVX_RESIDUAL_CONTEXT_GROUPS];
+
+    for (uint32 i = 0; i < EVX_RESIDUAL_CONTEXT_GROUPS; ++i)
+    {
+        group_sizes[i] = residual_group_size[i] * EVX_RESIDUAL_SIZE_CLASSES;
+    }
+
+    if (EVX_SUCCESS != contexts.create(group_sizes, EVX_RESIDUAL_CONTEXT_GROUPS))
+    {
+        evx_post_error(EVX_ERROR_OUTOFMEMORY);
+    }
+
+    build_scans();
+}
+
+void residual_coder::build_scans()
+{
+    for (uint8 size_class = 0; size_class < EVX_RESIDUAL_SIZE_CLASSES; ++size_class)
+    {
+        int32 block_size = 4 << size_class;
+        uint32 index = 0;
+
+        /* Up-right diagonal scan, starting from the bottom left of each diagonal. */
+        for (int32 diagonal = 0; diagonal < (block_size << 1) - 1; ++diagonal)
+        {
+            for (int32 y = evx_min2(diagonal, block_size - 1); y >= evx_max2(0, diagonal - block_size + 1); --y)
+            {
+                uint8 position = (y << 4) | (diagonal - y);
+
+                scan[size_class][index] = position;
+                scan_index[size_class][position] = index++;
+            }
+        }
+    }
+}
+
+int8 residual_coder::query_size_class(uint8 block_size) const
+{
+    switch (block_size)
+    {
+        case 4: return 0;
+        case 8: return 1;
+        case 16: return 2;
+    }
+
+    return -1;
+}
+
+entropy_context *residual_coder::query_contexts(uint32 group, int8 size_class) const
+{
+    return contexts.query_group(group) + size_class * residual_group_size[group];
+}
+
+void residual_coder::clear()
+{
+    contexts.reset();
+}
+
+evx_status residual_coder::encode_block(const int16 *coefficients, uint8 block_size, bitstream *dest)
+{
+    int8 size_class = query_size_class(block_size);
+
+    if (EVX_PARAM_CHECK)
+    {
+        if (!coder || !coefficients || !dest || size_class < 0)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    const uint8 *block_scan = scan[size_class];
+    int32 last = (block_size * block_size) - 1;
+
+    while (last >= 0 && 0 == coefficients[(block_scan[last] >> 4) * block_size + (block_scan[last] & 0xF)])
+    {
+        last--;
+    }
+
+    if (EVX_SUCCESS != coder->encode_bin(last >= 0, query_contexts(EVX_RESIDUAL_CODED_BLOCK_GROUP, size_class), dest))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    if (last < 0)
+    {
+        return EVX_SUCCESS;
+    }
+
+    if (EVX_SUCCESS != coder->encode_truncated_unary(block_scan[last] & 0xF, block_size - 1, 
+                                                     query_contexts(EVX_RESIDUAL_LAST_X_GROUP, size_class), EVX_RESIDUAL_LAST_CONTEXTS, dest) ||
+        EVX_SUCCESS != coder->encode_truncated_unary(block_scan[last] >> 4, block_size - 1, 
+                                                     query_contexts(EVX_RESIDUAL_LAST_Y_GROUP, size_class), EVX_RESIDUAL_LAST_CONTEXTS, dest))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    uint32 stride = block_size + 2;
+    uint8 rice_order = 0;
+
+    memset(levels, 0, stride * stride);
+
+    for (int32 n = last; n >= 0; --n)
+    {
+        uint8 x = block_scan[n] & 0xF;
+        uint8 y = block_scan[n] >> 4;
+        int16 coefficient = coefficients[y * block_size + x];
+        uint32 magnitude = (coefficient < 0) ? -int32(coefficient) : coefficient;
+        uint8 *level = &levels[y * stride + x];
+        uint8 sig_count = 0;
+        uint8 excess = 0;
+
+        query_template(level, stride, &sig_count, &excess);
+
+        /* The last position is significant by definition. */
+        if (n != last)
+        {
+            uint8 context_index = query_region(x, y) * EVX_RESIDUAL_REGION_CONTEXTS + 
+                                  evx_min2(sig_count, (uint8) (EVX_RESIDUAL_REGION_CONTEXTS - 1));
+
+            if (EVX_SUCCESS != coder->encode_bin(magnitude != 0, query_contexts(EVX_RESIDUAL_SIGNIFICANCE_GROUP, size_class) + context_index, dest))
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            if (0 == magnitude)
+            {
+                continue;
+            }
+        }
+
+        uint8 level_context = evx_min2(excess, (uint8) (EVX_RESIDUAL_LEVEL_CONTEXTS - 1));
+
+        if (EVX_SUCCESS != coder->encode_bin(magnitude > 1, query_contexts(EVX_RESIDUAL_GREATER1_GROUP, size_class) + level_context, dest))
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        if (magnitude > 1)
+        {
+            if (EVX_SUCCESS != coder->encode_bin(magnitude > 2, query_contexts(EVX_RESIDUAL_GREATER2_GROUP, size_class) + level_context, dest))
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            if (magnitude > 2)
+            {
+                if (EVX_SUCCESS != coder->encode_exp_golomb(magnitude - 3, rice_order, dest))
+                {
+                    return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+                }
+
+                /* Large remainders raise our Rice order for the rest of the block. */
+                if (magnitude - 3 > (uint32(3) << rice_order))
+                {
+                    rice_order = evx_min2(rice_order + 1, EVX_RESIDUAL_MAX_RICE_ORDER);
+                }
+            }
+        }
+
+        if (EVX_SUCCESS != coder->encode_fixed_length(coefficient < 0, 1, dest))
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        *level = evx_min2(magnitude, (uint32) 4);
+    }
+
+    return EVX_SUCCESS;
+}
+
+evx_status residual_coder::decode_block(uint8 block_size, bitstream *source, int16 *coefficients)
+{
+    int8 size_class = query_size_class(block_size);
+
+    if (EVX_PARAM_CHECK)
+    {
+        if (!coder || !coefficients || !source || size_class < 0)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    const uint8 *block_scan = scan[size_class];
+    uint8 coded = 0;
+
+    memset(coefficients, 0, sizeof(int16) * block_size * block_size);
+
+    if (EVX_SUCCESS != coder->decode_bin(query_contexts(EVX_RESIDUAL_CODED_BLOCK_GROUP, size_class), source, &coded))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    if (!coded)
+    {
+        return EVX_SUCCESS;
+    }
+
+    uint32 last_x = 0;
+    uint32 last_y = 0;
+
+    if (EVX_SUCCESS != coder->decode_truncated_unary(block_size - 1, query_contexts(EVX_RESIDUAL_LAST_X_GROUP, size_class), 
+                                                     EVX_RESIDUAL_LAST_CONTEXTS, source, &last_x) ||
+        EVX_SUCCESS != coder->decode_truncated_unary(block_size - 1, query_contexts(EVX_RESIDUAL_LAST_Y_GROUP, size_class), 
+                                                     EVX_RESIDUAL_LAST_CONTEXTS, source, &last_y))
+    {
+        return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+    }
+
+    int32 last = scan_index[size_class][(last_y << 4) | last_x];
+    uint32 stride = block_size + 2;
+    uint8 rice_order = 0;
+
+    memset(levels, 0, stride * stride);
+
+    for (int32 n = last; n >= 0; --n)
+    {
+        uint8 x = block_scan[n] & 0xF;
+        uint8 y = block_scan[n] >> 4;
+        uint8 *level = &levels[y * stride + x];
+        uint8 sig_count = 0;
+        uint8 excess = 0;
+        uint8 bit = 1;
+
+        query_template(level, stride, &sig_count, &excess);
+
+        if (n != last)
+        {
+            uint8 context_index = query_region(x, y) * EVX_RESIDUAL_REGION_CONTEXTS + 
+                                  evx_min2(sig_count, (uint8) (EVX_RESIDUAL_REGION_CONTEXTS - 1));
+
+            if (EVX_SUCCESS != coder->decode_bin(query_contexts(EVX_RESIDUAL_SIGNIFICANCE_GROUP, size_class) + context_index, source, &bit))
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            if (!bit)
+            {
+                continue;
+            }
+        }
+
+        uint8 level_context = evx_min2(excess, (uint8) (EVX_RESIDUAL_LEVEL_CONTEXTS - 1));
+        uint32 magnitude = 1;
+        uint32 sign = 0;
+
+        if (EVX_SUCCESS != coder->decode_bin(query_contexts(EVX_RESIDUAL_GREATER1_GROUP, size_class) + level_context, source, &bit))
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        if (bit)
+        {
+            magnitude = 2;
+
+            if (EVX_SUCCESS != coder->decode_bin(query_contexts(EVX_RESIDUAL_GREATER2_GROUP, size_class) + level_context, source, &bit))
+            {
+                return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+            }
+
+            if (bit)
+            {
+                uint32 remainder = 0;
+
+                if (EVX_SUCCESS != coder->decode_exp_golomb(rice_order, source, &remainder))
+                {
+                    return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+                }
+
+                if (remainder > (uint32(3) << rice_order))
+                {
+                    rice_order = evx_min2(rice_order + 1, EVX_RESIDUAL_MAX_RICE_ORDER);
+                }
+
+                magnitude = 3 + remainder;
+            }
+        }
+
+        if (EVX_SUCCESS != coder->decode_fixed_length(1, source, &sign))
+        {
+            return evx_post_error(EVX_ERROR_INVALID_RESOURCE);
+        }
+
+        coefficients[y * block_size + x] = (int16) (sign ? -int32(magnitude) : int32(magnitude));
+        *level = evx_min2(magnitude, (uint32) 4);
+    }
+
+    return EVX_SUCCESS;
+}
+
+} // namespace evx
@@ -0,0 +1,119 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// residual.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_RESIDUAL_H__
+#define __EV_RESIDUAL_H__
+
+#include "cabac.h"
+
+/*
+// Residual Block Coding
+//
+// A residual_coder codes square blocks of transform coefficients (4x4, 8x8 or 16x16,
+// stored in raster order) using an entropy_coder, in the style of the CABAC residual
+// syntax. Each block is coded as:
+//
+//   + A coded block flag indicating whether any coefficient is non-zero.
+//   + The (x, y) position of the last significant coefficient in diagonal scan order,
+//     each as a truncated unary value.
+//   + In reverse scan order from the last position, a significance flag for each 
+//     coefficient, followed (for significant ones) by greater-than-one and 
+//     greater-than-two flags, an Exp-Golomb remainder with an adaptive Rice order, 
+//     and a bypass coded sign.
+//
+// Significance and level flag contexts are selected from a template of up to five
+// previously coded neighbors (right, below and diagonal), so coefficients in busy
+// regions of a block adapt separately from those in sparse regions. 
+//
+// Blocks are coded between start_decode and finish_encode of the underlying coder, 
+// and the contexts of both sides must be cleared together.
+*/
+
+#define EVX_RESIDUAL_SIZE_CLASSES               (3)
+#define EVX_RESIDUAL_MAX_BLOCK_SIZE             (16)
+#define EVX_RESIDUAL_MAX_COEFFICIENTS           (EVX_RESIDUAL_MAX_BLOCK_SIZE * EVX_RESIDUAL_MAX_BLOCK_SIZE)
+#define EVX_RESIDUAL_LAST_CONTEXTS              (8)
+#define EVX_RESIDUAL_REGION_CONTEXTS            (5)
+#define EVX_RESIDUAL_SIG_CONTEXTS               (3 * EVX_RESIDUAL_REGION_CONTEXTS)
+#define EVX_RESIDUAL_LEVEL_CONTEXTS             (5)
+#define EVX_RESIDUAL_MAX_RICE_ORDER             (4)
+
+/* Context groups, one per syntax element. Each holds the contexts of every size class. */
+#define EVX_RESIDUAL_CODED_BLOCK_GROUP          (0)
+#define EVX_RESIDUAL_LAST_X_GROUP               (1)
+#define EVX_RESIDUAL_LAST_Y_GROUP               (2)
+#define EVX_RESIDUAL_SIGNIFICANCE_GROUP         (3)
+#define EVX_RESIDUAL_GREATER1_GROUP             (4)
+#define EVX_RESIDUAL_GREATER2_GROUP             (5)
+#define EVX_RESIDUAL_CONTEXT_GROUPS             (6)
+
+namespace evx {
+
+class residual_coder
+{
+    entropy_coder *coder;
+    context_table contexts;
+
+    /* Diagonal scan positions for each size class, packed as (y << 4) | x. */
+    uint8 scan[EVX_RESIDUAL_SIZE_CLASSES][EVX_RESIDUAL_MAX_COEFFICIENTS];
+    uint8 scan_index[EVX_RESIDUAL_SIZE_CLASSES][EVX_RESIDUAL_MAX_COEFFICIENTS];
+
+    /* Clipped magnitudes of coded coefficients, padded by two on the right and
+       bottom so that neighbor templates never require bounds checks. */
+    uint8 levels[(EVX_RESIDUAL_MAX_BLOCK_SIZE + 2) * (EVX_RESIDUAL_MAX_BLOCK_SIZE + 2)];
+
+private:
+
+    void build_scans();
+    int8 query_size_class(uint8 block_size) const;
+    entropy_context *query_contexts(uint32 group, int8 size_class) const;
+
+public:
+
+    explicit residual_coder(entropy_coder *entropy);
+
+    /* Resets all contexts to their initial state. */
+    void clear();
+
+    evx_status encode_block(const int16 *coefficients, uint8 block_size, bitstream *dest);
+    evx_status decode_block(uint8 block_size, bitstream *source, int16 *coefficients);
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(residual_coder);
+};
+
+} // namespace evx
+
+#endif // __EV_RESIDUAL_H__
@@ -0,0 +1,121 @@
+
+#include "ring.h"
+#include <thread>
+
+namespace evx {
+
+bitstream_ring::bitstream_ring(uint32 byte_capacity)
+{
+    uint32 capacity = 1;
+
+    while (capacity < byte_capacity && capacity < (EVX_GB << 1))
+    {
+        capacity <<= 1;
+    }
+
+    data_store = new uint8[capacity];
+    data_capacity = data_store ? capacity : 0;
+
+    write_offset.store(0);
+    read_offset.store(0);
+    closed.store(false);
+
+    cached_read_offset = 0;
+    cached_write_offset = 0;
+}
+
+bitstream_ring::~bitstream_ring()
+{
+    delete [] data_store;
+}
+
+uint32 bitstream_ring::query_capacity() const
+{
+    return data_capacity;
+}
+
+evx_status bitstream_ring::write(const void *data, uint32 *byte_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!byte_count || (!data && *byte_count))
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint64 offset = write_offset.load(std::memory_order_relaxed);
+
+    /* We only synchronize with the consumer if our cached view of its cursor 
+       leaves insufficient room. */
+    if (offset + *byte_count - cached_read_offset > data_capacity)
+    {
+        cached_read_offset = read_offset.load(std::memory_order_acquire);
+    }
+
+    uint32 write_count = evx_min2(*byte_count, (uint32) (data_capacity - (offset - cached_read_offset)));
+    uint32 ring_index = (uint32) (offset & (data_capacity - 1));
+    uint32 head_count = evx_min2(write_count, data_capacity - ring_index);
+    const uint8 *source = reinterpret_cast<const uint8 *>(data);
+
+    memcpy(data_store + ring_index, source, head_count);
+    memcpy(data_store, source + head_count, write_count - head_count);
+
+    write_offset.store(offset + write_count, std::memory_order_release);
+    *byte_count = write_count;
+
+    return EVX_SUCCESS;
+}
+
+void bitstream_ring::close()
+{
+    closed.store(true, std::memory_order_release);
+}
+
+evx_status bitstream_ring::acquire(uint8 **data, uint32 *byte_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!data || !byte_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    uint64 offset = read_offset.load(std::memory_order_relaxed);
+
+    while (offset == cached_write_offset)
+    {
+        /* We must observe the close before our final reload of the write cursor,
+           otherwise we could miss bytes written just before it. */
+        bool was_closed = closed.load(std::memory_order_acquire);
+        cached_write_offset = write_offset.load(std::memory_order_acquire);
+
+        if (offset != cached_write_offset)
+        {
+            break;
+        }
+
+        if (was_closed)
+        {
+            *byte_count = 0;
+            return EVX_ERROR_OPERATION_COMPLETED;
+        }
+
+        std::this_thread::yield();
+    }
+
+    uint32 ring_index = (uint32) (offset & (data_capacity - 1));
+
+    *data = data_store + ring_index;
+    *byte_count = (uint32) evx_min2(cached_write_offset - offset, (uint64) (data_capacity - ring_index));
+
+    return EVX_SUCCESS;
+}
+
+void bitstream_ring::release(uint32 byte_count)
+{
+    read_offset.store(read_offset.load(std::memory_order_relaxed) + byte_count, std::memory_order_release);
+}
+
+} // namespace evx
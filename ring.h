@@ -0,0 +1,96 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// ring.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_RING_H__
+#define __EV_RING_H__
+
+#include "base.h"
+#include "math.h"
+#include <atomic>
+
+/*
+// Bitstream Rings
+//
+// A bitstream_ring passes whole bytes from a single producer thread to a single
+// consumer thread without locks. The producer writes and eventually closes the ring,
+// while the consumer acquires contiguous spans of unread bytes in place (without
+// copying them) and releases them once they have been consumed.
+//
+// Each cursor is written by only one thread and lives on its own cache line, along
+// with that thread's cached copy of the opposite cursor. A thread only reloads the 
+// opposite cursor when its cached copy suggests that the ring is full (or empty),
+// so in steady state the two threads rarely touch the same cache line.
+*/
+
+namespace evx {
+
+class bitstream_ring
+{
+    uint8 *data_store;
+    uint32 data_capacity;
+
+    alignas(EVX_CACHE_LINE_SIZE) std::atomic<uint64> write_offset;
+    uint64 cached_read_offset;
+    std::atomic<bool> closed;
+
+    alignas(EVX_CACHE_LINE_SIZE) std::atomic<uint64> read_offset;
+    uint64 cached_write_offset;
+
+public:
+
+    /* Our capacity is rounded up to a power of two. */
+    explicit bitstream_ring(uint32 byte_capacity);
+    virtual ~bitstream_ring();
+
+    uint32 query_capacity() const;
+
+    /* Producer interface. write copies up to *byte_count bytes into the ring and 
+       replaces it with the number actually written, without blocking. */
+    evx_status write(const void *data, uint32 *byte_count);
+    void close();
+
+    /* Consumer interface. acquire waits until bytes are available and returns the
+       longest contiguous span of them, or EVX_ERROR_OPERATION_COMPLETED once the ring
+       has been closed and fully consumed. */
+    evx_status acquire(uint8 **data, uint32 *byte_count);
+    void release(uint32 byte_count);
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(bitstream_ring);
+};
+
+} // namespace evx
+
+#endif // __EV_RING_H__
@@ -0,0 +1,323 @@
+
+#include "scheduler.h"
+
+#if defined (EVX_PLATFORM_LINUX)
+    #include "pthread.h"
+    #include "sched.h"
+#endif
+
+namespace evx {
+
+/* Identifies the scheduler and worker that own the current thread, if any. */
+static thread_local task_scheduler *current_scheduler = 0;
+static thread_local uint32 current_worker = 0;
+
+#if defined (EVX_PLATFORM_LINUX)
+
+static void query_processor_order(std::vector<uint32> *order)
+{
+    /* Each NUMA node lists its processors as comma separated ranges (e.g. 0-3,8-11). 
+       We visit nodes in order, which groups processors by node. */
+    for (uint32 node = 0; ; ++node)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%i/cpulist", node);
+        FILE *file = fopen(path, "r");
+
+        if (!file)
+        {
+            break;
+        }
+
+        uint32 first = 0;
+        uint32 last = 0;
+        int32 fields = 0;
+
+        while ((fields = fscanf(file, "%u-%u", &first, &last)) >= 1)
+        {
+            last = (1 == fields) ? first : last;
+
+            for (uint32 cpu = first; cpu <= last; ++cpu)
+            {
+                order->push_back(cpu);
+            }
+
+            if (',' != fgetc(file))
+            {
+                break;
+            }
+        }
+
+        fclose(file);
+    }
+
+    if (order->empty())
+    {
+        for (uint32 cpu = 0; cpu < evx_max2(std::thread::hardware_concurrency(), 1u); ++cpu)
+        {
+            order->push_back(cpu);
+        }
+    }
+}
+
+#endif
+
+task_group::task_group()
+{
+    pending_count.store(0);
+}
+
+uint32 task_group::query_pending_count() const
+{
+    return pending_count.load();
+}
+
+task_scheduler::task_scheduler(uint32 worker_count, bool pin)
+{
+    if (0 == worker_count)
+    {
+        worker_count = evx_max2(std::thread::hardware_concurrency(), 1u);
+    }
+
+    queued_count.store(0);
+    pending_count.store(0);
+    submit_cursor.store(0);
+    stopping = false;
+
+    for (uint32 i = 0; i < worker_count; ++i)
+    {
+        queues.push_back(new scheduler_queue);
+    }
+
+    for (uint32 i = 0; i < worker_count; ++i)
+    {
+        workers.push_back(std::thread(&task_scheduler::worker_main, this, i));
+    }
+
+    if (pin)
+    {
+        pin_workers();
+    }
+}
+
+task_scheduler::~task_scheduler()
+{
+    wait();
+
+    {
+        std::unique_lock<std::mutex> guard(signal_lock);
+        stopping = true;
+        work_signal.notify_all();
+    }
+
+    for (uint32 i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+
+    for (uint32 i = 0; i < queues.size(); ++i)
+    {
+        delete queues[i];
+    }
+}
+
+void task_scheduler::pin_workers()
+{
+#if defined (EVX_PLATFORM_LINUX)
+    std::vector<uint32> order;
+    query_processor_order(&order);
+
+    for (uint32 i = 0; i < workers.size(); ++i)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(order[i % order.size()], &cpu_set);
+
+        /* Pinning is advisory, so failures (e.g. restricted cpusets) are ignored. */
+        pthread_setaffinity_np(workers[i].native_handle(), sizeof(cpu_set), &cpu_set);
+    }
+#elif defined (EVX_PLATFORM_WINDOWS)
+    for (uint32 i = 0; i < workers.size(); ++i)
+    {
+        SetThreadAffinityMask(workers[i].native_handle(), DWORD_PTR(1) << (i % (sizeof(DWORD_PTR) << 3)));
+    }
+#endif
+}
+
+uint32 task_scheduler::query_worker_count() const
+{
+    return (uint32) workers.size();
+}
+
+evx_status task_scheduler::submit(scheduler_function function, void *context, task_group *group)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!function)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    scheduler_task task = { function, context, group };
+    bool local = (this == current_scheduler);
+    uint32 index = local ? current_worker : submit_cursor.fetch_add(1) % queues.size();
+
+    pending_count.fetch_add(1);
+
+    if (group)
+    {
+        group->pending_count.fetch_add(1);
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(queues[index]->lock);
+        queues[index]->tasks.push_back(task);
+    }
+
+    queued_count.fetch_add(1);
+
+    {
+        std::unique_lock<std::mutex> guard(signal_lock);
+        work_signal.notify_one();
+    }
+
+    return EVX_SUCCESS;
+}
+
+bool task_scheduler::find_task(uint32 index, scheduler_task *task)
+{
+    uint32 queue_count = (uint32) queues.size();
+
+    if (0 == queued_count.load())
+    {
+        return false;
+    }
+
+    /* Our own deque is consumed from the back, all others are stolen from the front. */
+    for (uint32 i = 0; i < queue_count; ++i)
+    {
+        scheduler_queue *queue = queues[(index + i) % queue_count];
+        std::unique_lock<std::mutex> guard(queue->lock);
+
+        if (queue->tasks.empty())
+        {
+            continue;
+        }
+
+        if (0 == i)
+        {
+            *task = queue->tasks.back();
+            queue->tasks.pop_back();
+        }
+        else
+        {
+            *task = queue->tasks.front();
+            queue->tasks.pop_front();
+        }
+
+        queued_count.fetch_sub(1);
+
+        return true;
+    }
+
+    return false;
+}
+
+void task_scheduler::execute(const scheduler_task &task)
+{
+    task.function(task.context);
+
+    bool group_idle = task.group && (1 == task.group->pending_count.fetch_sub(1));
+
+    if (1 == pending_count.fetch_sub(1) || group_idle)
+    {
+        std::unique_lock<std::mutex> guard(signal_lock);
+        idle_signal.notify_all();
+    }
+}
+
+void task_scheduler::worker_main(uint32 index)
+{
+    current_scheduler = this;
+    current_worker = index;
+
+    scheduler_task task;
+
+    while (true)
+    {
+        if (find_task(index, &task))
+        {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(signal_lock);
+
+        while (0 == queued_count.load() && !stopping)
+        {
+            work_signal.wait(guard);
+        }
+
+        if (stopping && 0 == queued_count.load())
+        {
+            return;
+        }
+    }
+}
+
+void task_scheduler::wait()
+{
+    uint32 index = (this == current_scheduler) ? current_worker : 0;
+    scheduler_task task;
+
+    while (pending_count.load())
+    {
+        if (find_task(index, &task))
+        {
+            execute(task);
+            continue;
+        }
+
+        /* Remaining tasks are running elsewhere. We recheck periodically since those
+           tasks may submit further work that we can help with. */
+        std::unique_lock<std::mutex> guard(signal_lock);
+
+        if (pending_count.load() && 0 == queued_count.load())
+        {
+            idle_signal.wait_for(guard, std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void task_scheduler::wait(task_group *group)
+{
+    if (!group)
+    {
+        wait();
+        return;
+    }
+
+    uint32 index = (this == current_scheduler) ? current_worker : 0;
+    scheduler_task task;
+
+    /* We help with any queued work (ours or not) rather than sleep, since our own 
+       tasks may be queued behind it. */
+    while (group->pending_count.load())
+    {
+        if (find_task(index, &task))
+        {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(signal_lock);
+
+        if (group->pending_count.load() && 0 == queued_count.load())
+        {
+            idle_signal.wait_for(guard, std::chrono::milliseconds(1));
+        }
+    }
+}
+
+} // namespace evx
@@ -0,0 +1,143 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// scheduler.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_SCHEDULER_H__
+#define __EV_SCHEDULER_H__
+
+#include "base.h"
+#include "math.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+// Work Stealing Scheduler
+//
+// A task_scheduler runs tasks on a fixed pool of worker threads. Each worker owns a
+// deque: tasks submitted from a worker are pushed onto its own deque and popped from
+// the back (most recent first, which keeps related data hot in its cache), while 
+// idle workers steal from the front of other deques (oldest, and typically largest,
+// first). Tasks submitted from outside the pool are spread across workers.
+//
+// Tasks may be submitted as part of a task_group, which counts its own outstanding
+// tasks. Waiting on a group returns as soon as its tasks complete, so independent
+// callers sharing a scheduler do not wait on one another's work.
+//
+// Workers may optionally be pinned to processors. Processors are assigned in NUMA 
+// node order where the platform reports it, so that consecutive workers share a node
+// and memory first touched by a task tends to stay local to the worker that uses it.
+*/
+
+namespace evx {
+
+typedef void (*scheduler_function)(void *context);
+
+class task_group
+{
+    std::atomic<uint32> pending_count;
+
+    friend class task_scheduler;
+
+public:
+
+    task_group();
+
+    uint32 query_pending_count() const;
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(task_group);
+};
+
+typedef struct scheduler_task
+{
+    scheduler_function function;
+    void *context;
+    task_group *group;
+} scheduler_task;
+
+typedef struct alignas(EVX_CACHE_LINE_SIZE) scheduler_queue
+{
+    std::mutex lock;
+    std::deque<scheduler_task> tasks;
+} scheduler_queue;
+
+class task_scheduler
+{
+    std::vector<scheduler_queue *> queues;
+    std::vector<std::thread> workers;
+    std::atomic<uint32> queued_count;
+    std::atomic<uint32> pending_count;
+    std::atomic<uint32> submit_cursor;
+    bool stopping;
+
+    std::mutex signal_lock;
+    std::condition_variable work_signal;
+    std::condition_variable idle_signal;
+
+private:
+
+    void worker_main(uint32 index);
+    bool find_task(uint32 index, scheduler_task *task);
+    void execute(const scheduler_task &task);
+    void pin_workers();
+
+public:
+
+    /* A worker count of zero selects one worker per hardware thread. */
+    explicit task_scheduler(uint32 worker_count = 0, bool pin = false);
+    virtual ~task_scheduler();
+
+    uint32 query_worker_count() const;
+
+    evx_status submit(scheduler_function function, void *context, task_group *group = 0);
+
+    /* Blocks until every submitted task (including tasks submitted by tasks) has
+       completed. The calling thread executes queued tasks while it waits. */
+    void wait();
+
+    /* Blocks until every task submitted to group has completed. */
+    void wait(task_group *group);
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(task_scheduler);
+};
+
+} // namespace evx
+
+#endif // __EV_SCHEDULER_H__
@@ -0,0 +1,169 @@
+
+#include "sink.h"
+#include "math.h"
+
+#if defined (EVX_PLATFORM_WINDOWS)
+    #include "io.h"
+#else
+    #include "errno.h"
+#endif
+
+namespace evx {
+
+vector_sink::vector_sink(std::vector<uint8> *output)
+{
+    target = output;
+}
+
+evx_status vector_sink::write(const uint8 *data, uint32 byte_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!target || (!data && byte_count))
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    target->insert(target->end(), data, data + byte_count);
+
+    return EVX_SUCCESS;
+}
+
+fd_sink::fd_sink(int32 fd)
+{
+    descriptor = fd;
+}
+
+evx_status fd_sink::write(const uint8 *data, uint32 byte_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (descriptor < 0 || (!data && byte_count))
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    while (byte_count)
+    {
+#if defined (EVX_PLATFORM_WINDOWS)
+        int32 bytes_written = _write(descriptor, data, byte_count);
+#else
+        int32 bytes_written = (int32) ::write(descriptor, data, byte_count);
+
+        if (bytes_written < 0 && EINTR == errno)
+        {
+            continue;
+        }
+#endif
+        if (bytes_written <= 0)
+        {
+            return evx_post_error(EVX_ERROR_IO_FAILURE);
+        }
+
+        data += bytes_written;
+        byte_count -= bytes_written;
+    }
+
+    return EVX_SUCCESS;
+}
+
+callback_sink::callback_sink(sink_callback function, void *context)
+{
+    callback = function;
+    user_data = context;
+}
+
+evx_status callback_sink::write(const uint8 *data, uint32 byte_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!callback)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    return callback(data, byte_count, user_data);
+}
+
+ring_sink::ring_sink(uint32 byte_capacity)
+{
+    ring = new uint8[byte_capacity];
+    capacity = ring ? byte_capacity : 0;
+    read_offset = 0;
+    occupancy = 0;
+}
+
+ring_sink::~ring_sink()
+{
+    delete [] ring;
+}
+
+evx_status ring_sink::write(const uint8 *data, uint32 byte_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!data && byte_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    if (0 == byte_count)
+    {
+        return EVX_SUCCESS;
+    }
+
+    if (occupancy + byte_count > capacity)
+    {
+        return EVX_ERROR_CAPACITY_LIMIT;
+    }
+
+    /* Our write may wrap around the end of the ring, requiring two copies. */
+    uint32 write_offset = (read_offset + occupancy) % capacity;
+    uint32 head_count = evx_min2(byte_count, capacity - write_offset);
+
+    memcpy(ring + write_offset, data, head_count);
+    memcpy(ring, data + head_count, byte_count - head_count);
+    occupancy += byte_count;
+
+    return EVX_SUCCESS;
+}
+
+evx_status ring_sink::read(uint8 *data, uint32 *byte_count)
+{
+    if (EVX_PARAM_CHECK)
+    {
+        if (!data || !byte_count)
+        {
+            return evx_post_error(EVX_ERROR_INVALIDARG);
+        }
+    }
+
+    /* We read up to *byte_count bytes and replace it with the number actually read. */
+    uint32 read_count = evx_min2(*byte_count, occupancy);
+    uint32 head_count = evx_min2(read_count, capacity - read_offset);
+
+    memcpy(data, ring + read_offset, head_count);
+    memcpy(data + head_count, ring, read_count - head_count);
+
+    read_offset = (read_offset + read_count) % evx_max2(capacity, 1);
+    occupancy -= read_count;
+    *byte_count = read_count;
+
+    return EVX_SUCCESS;
+}
+
+uint32 ring_sink::query_capacity() const
+{
+    return capacity;
+}
+
+uint32 ring_sink::query_occupancy() const
+{
+    return occupancy;
+}
+
+} // namespace evx
@@ -0,0 +1,123 @@
+
+/*
+//
+// Copyright (c) 2002-2015 Joe Bertolami. All Right Reserved.
+//
+// sink.h
+//
+//   Redistribution and use in source and binary forms, with or without
+//   modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice, this
+//     list of conditions and the following disclaimer.
+//
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+//   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+//   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+//   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Additional Information:
+//
+//   For more information, visit http://www.bertolami.com.
+//
+*/
+
+#ifndef __EV_SINK_H__
+#define __EV_SINK_H__
+
+#include "base.h"
+#include <vector>
+
+/*
+// Output Sinks
+//
+// A sink receives whole bytes that have been drained from a bitstream. Attaching
+// a sink to a bitstream turns its buffer into a staging area: whenever a write would
+// exceed its capacity, all completed bytes are handed to the sink and the buffer is
+// reused, so output streams out while coding continues.
+*/
+
+namespace evx {
+
+class bitstream_sink
+{
+public:
+
+    virtual ~bitstream_sink() {}
+    virtual evx_status write(const uint8 *data, uint32 byte_count) = 0;
+};
+
+/* Appends output to a caller owned, growable vector. */
+class vector_sink : public bitstream_sink
+{
+    std::vector<uint8> *target;
+
+public:
+
+    explicit vector_sink(std::vector<uint8> *output);
+    evx_status write(const uint8 *data, uint32 byte_count);
+};
+
+/* Writes output to a file descriptor, retrying partial writes. */
+class fd_sink : public bitstream_sink
+{
+    int32 descriptor;
+
+public:
+
+    explicit fd_sink(int32 fd);
+    evx_status write(const uint8 *data, uint32 byte_count);
+};
+
+/* Forwards output to a user supplied callback. */
+typedef evx_status (*sink_callback)(const uint8 *data, uint32 byte_count, void *user_data);
+
+class callback_sink : public bitstream_sink
+{
+    sink_callback callback;
+    void *user_data;
+
+public:
+
+    callback_sink(sink_callback function, void *context);
+    evx_status write(const uint8 *data, uint32 byte_count);
+};
+
+/* Stores output in a fixed size ring. Writes that do not fit fail with 
+   EVX_ERROR_CAPACITY_LIMIT, so consumers must read to make room. */
+class ring_sink : public bitstream_sink
+{
+    uint8 *ring;
+    uint32 capacity;
+    uint32 read_offset;
+    uint32 occupancy;
+
+public:
+
+    explicit ring_sink(uint32 byte_capacity);
+    virtual ~ring_sink();
+
+    evx_status write(const uint8 *data, uint32 byte_count);
+    evx_status read(uint8 *data, uint32 *byte_count);
+
+    uint32 query_capacity() const;
+    uint32 query_occupancy() const;
+
+private:
+
+    EVX_DISABLE_COPY_AND_ASSIGN(ring_sink);
+};
+
+} // namespace evx
+
+#endif // __EV_SINK_H__
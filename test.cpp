@@ -1,6 +1,21 @@
 
 #include "cabac.h"
+#include "container.h"
+#include "cpu.h"
+#include "filter.h"
+#include "hashed.h"
+#include "index.h"
+#include "match.h"
 #include "math.h"
+#include "memory.h"
+#include "model.h"
+#include "multistream.h"
+#include "parallel.h"
+#include "rate.h"
+#include "residual.h"
+#include "ring.h"
+#include "sink.h"
+#include <thread>
 
 using namespace evx;
 
@@ -46,8 +61,1782 @@ void test_basic_cabac_rt()
     evx_msg("test completed successfully.");
 }
 
+void test_dual_rate_cabac_rt()
+{
+    entropy_coder coder(EVX_ENTROPY_DEFAULT_FAST_RATE, EVX_ENTROPY_DEFAULT_SLOW_RATE);
+    bitstream a((uint32) 4096);
+    bitstream b((uint32) 4096);
+    bitstream c((uint32) 4096);
+
+    /* Our statistics shift halfway through the stream so that the estimator
+       must re-adapt after having settled. */
+    for (uint32 i = 0; i < 256; ++i)
+    {
+        a.write_byte(i < 128 ? test_kernel(i) : (0xF0 | test_kernel(i)));
+    }
+
+    uint32 raw_size = a.query_occupancy();
+    coder.encode(&a, &b);
+    evx_msg("dual rate encoded size: %i bits", b.query_occupancy());
+    coder.decode(raw_size, &b, &c);
+
+    if (c.query_byte_occupancy() != 256)
+    {
+        evx_err("Dual rate decode produced an invalid symbol count.");
+        return;
+    }
+
+    for (uint32 i = 0; i < 256; ++i)
+    {
+        uint8 expected = (i < 128 ? test_kernel(i) : (0xF0 | test_kernel(i)));
+
+        if (expected != c.query_data()[i])
+        {
+            evx_err("Dual rate data integrity check failure.");
+            return;
+        }
+    }
+
+    evx_msg("dual rate test completed successfully.");
+}
+
+void test_trained_model_rt()
+{
+    entropy_model trainer;
+    entropy_model model;
+    const char *model_filename = "abac-test.model";
+
+    /* We train a single context on a corpus that resembles our test payload. */
+    bitstream corpus((uint32) 8192);
+
+    for (uint32 i = 0; i < 1024; ++i)
+    {
+        corpus.write_byte(test_kernel(i));
+    }
+
+    if (EVX_SUCCESS != trainer.create(1) ||
+        EVX_SUCCESS != trainer.train(&corpus) ||
+        EVX_SUCCESS != trainer.save(model_filename) ||
+        EVX_SUCCESS != model.load(model_filename))
+    {
+        evx_err("Failed to train and load a model.");
+        return;
+    }
+
+    remove(model_filename);
+
+    if (model.query_signature() != trainer.query_signature() || 1 != model.query_context_count())
+    {
+        evx_err("Loaded model does not match the trained model.");
+        return;
+    }
+
+    entropy_coder untrained_coder;
+    entropy_coder encoder;
+    entropy_coder decoder;
+    bitstream a((uint32) 512);
+    bitstream b((uint32) 512);
+    bitstream c((uint32) 512);
+    bitstream d((uint32) 512);
+
+    for (uint8 i = 0; i < 16; ++i)
+    {
+        a.write_byte(test_kernel(i));
+    }
+
+    uint32 raw_size = a.query_occupancy();
+
+    if (EVX_SUCCESS != encoder.load_model(model, 0) ||
+        EVX_SUCCESS != decoder.load_model(model, 0))
+    {
+        evx_err("Failed to initialize coders from a trained model.");
+        return;
+    }
+
+    encoder.encode(&a, &b);
+    a.seek(0);
+    untrained_coder.encode(&a, &d);
+    evx_msg("trained encoded size: %i bits (untrained %i bits)", b.query_occupancy(), d.query_occupancy());
+
+    if (b.query_occupancy() >= d.query_occupancy())
+    {
+        evx_err("Trained model failed to improve the coded size.");
+        return;
+    }
+
+    decoder.decode(raw_size, &b, &c);
+
+    for (uint8 i = 0; i < 16; ++i)
+    {
+        if (test_kernel(i) != c.query_data()[i])
+        {
+            evx_err("Trained model data integrity check failure.");
+            return;
+        }
+    }
+
+    /* A context that only ever saw zeros saturates, yet static coders loaded from it 
+       must still be able to code a one. */
+    entropy_model saturated_trainer;
+    entropy_model saturated;
+    entropy_coder static_encoder((uint32) 0x8000);
+    entropy_coder static_decoder((uint32) 0x8000);
+    bitstream zeros((uint32) 100000);
+    bitstream e((uint32) 512);
+    bitstream f((uint32) 512);
+
+    zeros.write_run(0, 100000);
+
+    if (EVX_SUCCESS != saturated_trainer.create(1) || EVX_SUCCESS != saturated_trainer.train(&zeros) ||
+        EVX_SUCCESS != saturated_trainer.save(model_filename) || EVX_SUCCESS != saturated.load(model_filename) ||
+        EVX_SUCCESS != static_encoder.load_model(saturated, 0) || EVX_SUCCESS != static_decoder.load_model(saturated, 0))
+    {
+        evx_err("Failed to load a saturated model.");
+        return;
+    }
+
+    remove(model_filename);
+
+    uint8 sparse[2] = { 0x10, 0x00 };
+    e.write_bytes(sparse, 2);
+
+    if (EVX_SUCCESS != static_encoder.encode(&e, &f) || EVX_SUCCESS != static_decoder.decode(16, &f, &e) ||
+        0 != memcmp(e.query_data() + 2, sparse, 2))
+    {
+        evx_err("Saturated static model failed to code a one.");
+        return;
+    }
+
+    evx_msg("trained model test completed successfully.");
+}
+
+void test_rate_estimation()
+{
+    entropy_coder estimator;
+    entropy_coder coder;
+    bitstream a((uint32) 8192);
+    bitstream b((uint32) 8192);
+
+    for (uint32 i = 0; i < 1024; ++i)
+    {
+        a.write_byte(test_kernel(i));
+    }
+
+    uint32 cost = 0;
+    uint32 initial_cost = estimator.estimate_rate(1);
+
+    /* An untrained model should charge (very nearly) a full bit per symbol. */
+    if (initial_cost + 2 < EVX_RATE_ONE_BIT || initial_cost > EVX_RATE_ONE_BIT + 2 ||
+        EVX_SUCCESS != estimator.estimate_rate(&a, &cost))
+    {
+        evx_err("Failed to estimate the coding rate.");
+        return;
+    }
+
+    /* Our estimate should closely track the size of an actual encode. */
+    a.seek(0);
+    coder.encode(&a, &b);
+
+    uint32 estimated_bits = cost >> EVX_RATE_PRECISION;
+    uint32 coded_bits = b.query_occupancy();
+    evx_msg("estimated size: %i bits (encoded %i bits)", estimated_bits, coded_bits);
+
+    if (estimated_bits + 32 < coded_bits || coded_bits + 32 < estimated_bits)
+    {
+        evx_err("Rate estimate diverges from the encoded size.");
+        return;
+    }
+
+    /* Bulk estimation must not disturb the estimator's model. */
+    if (initial_cost != estimator.estimate_rate(1))
+    {
+        evx_err("Rate estimation modified the coder state.");
+        return;
+    }
+
+    /* A certain symbol is free, rather than wrapping to the cost of an impossible one. */
+    entropy_coder certain((uint32) 0);
+
+    if (0 != certain.estimate_rate(1) || certain.estimate_rate(0) < 8 * EVX_RATE_ONE_BIT)
+    {
+        evx_err("Rate estimation mispriced a certain symbol.");
+        return;
+    }
+
+    /* Contexts are priced in their current state, as encode_bin would code them. */
+    entropy_coder context_coder(EVX_ENTROPY_DEFAULT_FAST_RATE, EVX_ENTROPY_DEFAULT_SLOW_RATE);
+    entropy_context context = { EVX_CONTEXT_INITIAL_STATE };
+    bitstream d((uint32) 8192);
+    uint32 initial_context_costs[2] = { entropy_coder::estimate_rate(context, 0), entropy_coder::estimate_rate(context, 1) };
+
+    for (uint32 i = 0; i < 200; ++i)
+    {
+        context_coder.encode_bin(0, &context, &d);
+    }
+
+    if (initial_context_costs[0] != initial_context_costs[1] || initial_context_costs[0] + 2 < EVX_RATE_ONE_BIT || 
+        initial_context_costs[0] > EVX_RATE_ONE_BIT + 2 || entropy_coder::estimate_rate(context, 0) >= EVX_RATE_ONE_BIT / 4 || 
+        entropy_coder::estimate_rate(context, 1) <= 3 * EVX_RATE_ONE_BIT)
+    {
+        evx_err("Context rate estimation failed to track the context state.");
+        return;
+    }
+
+    evx_msg("rate estimation test completed successfully.");
+}
+
+void test_checkpoint_rollback()
+{
+    entropy_coder coder;
+    entropy_coder reference_coder;
+    entropy_checkpoint checkpoint;
+    bitstream prefix((uint32) 1024);
+    bitstream candidate_a((uint32) 1024);
+    bitstream candidate_b((uint32) 1024);
+    bitstream reference((uint32) 2048);
+    bitstream a((uint32) 4096);
+    bitstream b((uint32) 4096);
+    bitstream c((uint32) 4096);
+
+    for (uint8 i = 0; i < 32; ++i)
+    {
+        prefix.write_byte(test_kernel(i));
+        candidate_a.write_byte(0xA5 ^ i);
+        candidate_b.write_byte(test_kernel(i + 1));
+        reference.write_byte(test_kernel(i));
+    }
+
+    for (uint8 i = 0; i < 32; ++i)
+    {
+        reference.write_byte(test_kernel(i + 1));
+    }
+
+    /* Encode our prefix, try candidate a, then roll back and commit candidate b. */
+    coder.encode(&prefix, &a, false);
+    coder.save_checkpoint(&a, &checkpoint);
+    coder.encode(&candidate_a, &a, false);
+    evx_msg("candidate a size: %i bits", (uint32) (a.query_occupancy() - checkpoint.position));
+
+    if (EVX_SUCCESS != coder.restore_checkpoint(checkpoint, &a))
+    {
+        evx_err("Failed to restore a coder checkpoint.");
+        return;
+    }
+
+    coder.encode(&candidate_b, &a, false);
+    coder.finish_encode(&a);
+
+    /* Our output must be identical to a direct encode of prefix + b. */
+    reference_coder.encode(&reference, &b);
+
+    if (a.query_occupancy() != b.query_occupancy() ||
+        0 != memcmp(a.query_data(), b.query_data(), a.query_occupancy() >> 3))
+    {
+        evx_err("Rolled back stream differs from a direct encode.");
+        return;
+    }
+
+    coder.decode(64 << 3, &a, &c);
+
+    for (uint8 i = 0; i < 64; ++i)
+    {
+        if (reference.query_data()[i] != c.query_data()[i])
+        {
+            evx_err("Checkpoint data integrity check failure.");
+            return;
+        }
+    }
+
+    evx_msg("checkpoint test completed successfully.");
+}
+
+void test_bulk_capacity_fallback()
+{
+    entropy_coder coder;
+    bitstream a((uint32) 32768);
+    bitstream b((uint32) 65536);
+
+    uint32 seed = 0x12345678;
+
+    for (uint32 i = 0; i < 4096; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        a.write_byte((seed >> 16) & (seed >> 24) & 0xFF);
+    }
+
+    uint32 raw_size = a.query_occupancy();
+    coder.encode(&a, &b);
+
+    /* A destination that is exactly large enough forces the tail of the stream
+       through the checked path, which must produce identical output. */
+    uint32 coded_size = b.query_occupancy();
+    bitstream c(align(coded_size, 8));
+    bitstream d(raw_size);
+
+    a.seek(0);
+
+    if (EVX_SUCCESS != coder.encode(&a, &c) ||
+        c.query_occupancy() != coded_size ||
+        0 != memcmp(b.query_data(), c.query_data(), coded_size >> 3))
+    {
+        evx_err("Checked encode path diverged from the bulk path.");
+        return;
+    }
+
+    if (EVX_SUCCESS != coder.decode(raw_size, &c, &d) ||
+        0 != memcmp(a.query_data(), d.query_data(), raw_size >> 3))
+    {
+        evx_err("Bulk decode data integrity check failure.");
+        return;
+    }
+
+    evx_msg("bulk coding test completed successfully.");
+}
+
+void test_run_mode_rt()
+{
+    entropy_coder coder(EVX_ENTROPY_DEFAULT_FAST_RATE, EVX_ENTROPY_DEFAULT_SLOW_RATE);
+    bitstream a((uint32) 65536);
+    bitstream b((uint32) 65536);
+    bitstream c((uint32) 65536);
+
+    /* A sparse bitmap whose final run extends to the end of the stream. */
+    for (uint32 i = 0; i < 4096; ++i)
+    {
+        a.write_byte((i % 61 == 0 && i < 4000) ? (0x1 << (i % 8)) : 0x00);
+    }
+
+    uint32 raw_size = a.query_occupancy();
+    coder.enable_run_mode(true);
+    coder.encode(&a, &b);
+    evx_msg("run mode encoded size: %i bits", b.query_occupancy());
+    coder.decode(raw_size, &b, &c);
+
+    if (c.query_occupancy() != raw_size || 0 != memcmp(a.query_data(), c.query_data(), raw_size >> 3))
+    {
+        evx_err("Run mode data integrity check failure.");
+        return;
+    }
+
+    /* Incremental calls that split runs (including the final one) must produce the 
+       same stream as a single call. */
+    const uint32 splits[] = { 0, 1000, 20003, 20010, raw_size };
+    bitstream d((uint32) 65536);
+    bitstream e((uint32) 65536);
+    coder.clear();
+
+    for (uint32 i = 0; i + 1 < sizeof(splits) / sizeof(splits[0]); ++i)
+    {
+        bitstream view;
+        view.wrap(a.query_data(), raw_size >> 3);
+        view.seek(splits[i]);
+        view.truncate(splits[i + 1]);
+
+        if (EVX_SUCCESS != coder.encode(&view, &d, false))
+        {
+            evx_err("Incremental run mode encode failed.");
+            return;
+        }
+    }
+
+    if (EVX_SUCCESS != coder.finish_encode(&d) || d.query_write_index() != b.query_write_index() ||
+        0 != memcmp(b.query_data(), d.query_data(), d.query_byte_occupancy()) ||
+        EVX_SUCCESS != coder.decode(raw_size, &d, &e) || 
+        0 != memcmp(a.query_data(), e.query_data(), raw_size >> 3))
+    {
+        evx_err("Incremental run mode encode diverged from a single call.");
+        return;
+    }
+
+    evx_msg("run mode test completed successfully.");
+}
+
+void test_bitstream_append()
+{
+    bitstream chunks[3];
+    const bitstream *sources[] = { &chunks[0], &chunks[1], &chunks[2] };
+    const uint32 chunk_bits[] = { 13, 1021, 250 };
+    bitstream a((uint32) 5);
+    bitstream b((uint32) 8);
+
+    /* Our destinations start unaligned and must grow to hold the appended data. */
+    for (uint32 i = 0; i < 5; ++i)
+    {
+        a.write_bit(i & 0x1);
+        b.write_bit(i & 0x1);
+    }
+
+    for (uint32 i = 0; i < 3; ++i)
+    {
+        chunks[i].resize_capacity(chunk_bits[i]);
+
+        for (uint32 j = 0; j < chunk_bits[i]; ++j)
+        {
+            chunks[i].write_bit(((j * 7) ^ (j >> 3) ^ i) & 0x1);
+        }
+
+        a.append(chunks[i]);
+    }
+
+    b.append(sources, 3);
+
+    if (a.query_occupancy() != 5 + 13 + 1021 + 250 || b.query_occupancy() != a.query_occupancy())
+    {
+        evx_err("Append produced an invalid bit count.");
+        return;
+    }
+
+    for (uint32 i = 0; i < 5 + 13 + 1021 + 250; ++i)
+    {
+        uint8 expected = i & 0x1;
+        uint8 actual_a = 0;
+        uint8 actual_b = 0;
+
+        if (i >= 5)
+        {
+            uint32 chunk = (i < 18 ? 0 : (i < 1039 ? 1 : 2));
+            uint32 j = i - (chunk == 0 ? 5 : (chunk == 1 ? 18 : 1039));
+            expected = ((j * 7) ^ (j >> 3) ^ chunk) & 0x1;
+        }
+
+        a.read_bit(&actual_a);
+        b.read_bit(&actual_b);
+
+        if (actual_a != expected || actual_b != expected)
+        {
+            evx_err("Append data integrity check failure.");
+            return;
+        }
+    }
+
+    evx_msg("append test completed successfully.");
+}
+
+void test_integer_coding_rt()
+{
+    entropy_coder encoder;
+    entropy_coder decoder;
+    entropy_context encode_contexts[4];
+    entropy_context decode_contexts[4];
+    bitstream stream((uint32) 65536);
+
+    for (uint32 i = 0; i < 4; ++i)
+    {
+        encoder.init_context(&encode_contexts[i]);
+        decoder.init_context(&decode_contexts[i]);
+    }
+
+    /* Each value is coded with every binarization that can represent it. */
+    for (uint32 i = 0; i < 256; ++i)
+    {
+        uint32 value = test_kernel(i) + (i % 17 == 0 ? i * 1000 : 0);
+
+        encoder.encode_truncated_unary(evx_min2(value, (uint32) 5), 5, encode_contexts, 2, &stream);
+        encoder.encode_fixed_length(value & 0xFF, 8, &stream);
+        encoder.encode_exp_golomb(value, 1, &stream);
+        encoder.encode_ueg(value, 0, 14, encode_contexts + 2, 2, &stream);
+    }
+
+    encoder.finish_encode(&stream);
+    evx_msg("integer coding encoded size: %i bits", stream.query_occupancy());
+    decoder.start_decode(&stream);
+
+    for (uint32 i = 0; i < 256; ++i)
+    {
+        uint32 value = test_kernel(i) + (i % 17 == 0 ? i * 1000 : 0);
+        uint32 decoded[4] = {0};
+
+        decoder.decode_truncated_unary(5, decode_contexts, 2, &stream, &decoded[0]);
+        decoder.decode_fixed_length(8, &stream, &decoded[1]);
+        decoder.decode_exp_golomb(1, &stream, &decoded[2]);
+        decoder.decode_ueg(0, 14, decode_contexts + 2, 2, &stream, &decoded[3]);
+
+        if (decoded[0] != evx_min2(value, (uint32) 5) || decoded[1] != (value & 0xFF) ||
+            decoded[2] != value || decoded[3] != value)
+        {
+            evx_err("Integer coding data integrity check failure.");
+            return;
+        }
+    }
+
+    evx_msg("integer coding test completed successfully.");
+}
+
+void test_residual_block_rt()
+{
+    entropy_coder encoder;
+    entropy_coder decoder;
+    residual_coder block_encoder(&encoder);
+    residual_coder block_decoder(&decoder);
+    bitstream stream((uint32) 65536);
+    int16 blocks[3][EVX_RESIDUAL_MAX_COEFFICIENTS];
+    int16 decoded[EVX_RESIDUAL_MAX_COEFFICIENTS];
+
+    /* Energy concentrates in the top left of each block, as after a transform. */
+    for (uint8 size_class = 0; size_class < 3; ++size_class)
+    {
+        uint8 block_size = 4 << size_class;
+
+        for (uint32 i = 0; i < uint32(block_size * block_size); ++i)
+        {
+            uint32 x = i % block_size;
+            uint32 y = i / block_size;
+            int16 magnitude = (x + y < 4) ? (int16) (12 >> (x + y)) : (i % 29 == 0);
+
+            blocks[size_class][i] = (i & 0x2) ? -magnitude : magnitude;
+        }
+    }
+
+    blocks[2][0] = -1000;
+
+    for (uint8 size_class = 0; size_class < 3; ++size_class)
+    {
+        block_encoder.encode_block(blocks[size_class], 4 << size_class, &stream);
+    }
+
+    encoder.finish_encode(&stream);
+    evx_msg("residual encoded size: %i bits", stream.query_occupancy());
+    decoder.start_decode(&stream);
+
+    for (uint8 size_class = 0; size_class < 3; ++size_class)
+    {
+        uint8 block_size = 4 << size_class;
+        block_decoder.decode_block(block_size, &stream, decoded);
+
+        if (0 != memcmp(decoded, blocks[size_class], sizeof(int16) * block_size * block_size))
+        {
+            evx_err("Residual block data integrity check failure.");
+            return;
+        }
+    }
+
+    evx_msg("residual block test completed successfully.");
+}
+
+void test_context_table()
+{
+    const uint32 group_sizes[] = { 3, 40, 1 };
+    context_table table;
+
+    if (EVX_SUCCESS != table.create(group_sizes, 3))
+    {
+        evx_err("Context table creation failed.");
+        return;
+    }
+
+    /* Groups start on their own cache lines and never overlap. */
+    for (uint32 i = 0; i < 3; ++i)
+    {
+        entropy_context *group = table.query_group(i);
+
+        if (0 != (reinterpret_cast<uintptr_t>(group) % EVX_CACHE_LINE_SIZE) ||
+            (i < 2 && table.query_group(i + 1) < group + group_sizes[i]))
+        {
+            evx_err("Context group layout is invalid.");
+            return;
+        }
+
+        for (uint32 j = 0; j < group_sizes[i]; ++j)
+        {
+            if (EVX_CONTEXT_INITIAL_STATE != group[j].state)
+            {
+                evx_err("Context table was not reset.");
+                return;
+            }
+        }
+    }
+
+    evx_msg("context table test completed successfully.");
+}
+
+void produce_ring_bytes(bitstream_ring *ring, const uint8 *data, uint32 byte_count)
+{
+    uint32 offset = 0;
+
+    /* We write in uneven pieces so that spans regularly wrap around the ring. */
+    while (offset < byte_count)
+    {
+        uint32 write_count = evx_min2(byte_count - offset, (uint32) (37 + offset % 91));
+        ring->write(data + offset, &write_count);
+        offset += write_count;
+
+        if (0 == write_count)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    ring->close();
+}
+
+void test_ring_encode()
+{
+    entropy_coder coder(EVX_ENTROPY_DEFAULT_FAST_RATE, EVX_ENTROPY_DEFAULT_SLOW_RATE);
+    bitstream_ring ring(256);
+    bitstream_ring run_ring(256);
+    uint8 data[8192];
+    bitstream a((uint32) 65536);
+    bitstream b((uint32) 131072);
+    bitstream c((uint32) 131072);
+
+    for (uint32 i = 0; i < 8192; ++i)
+    {
+        data[i] = test_kernel(i) | ((i >> 7) & 0xF0);
+    }
+
+    a.write_bytes(data, 8192);
+    coder.encode(&a, &b);
+
+    /* Streaming through the ring must produce exactly the same output. */
+    std::thread producer(produce_ring_bytes, &ring, data, 8192);
+    coder.encode(&ring, &c);
+    producer.join();
+
+    if (b.query_occupancy() != c.query_occupancy() ||
+        0 != memcmp(b.query_data(), c.query_data(), b.query_byte_occupancy()))
+    {
+        evx_err("Ring encode diverged from the bitstream encode.");
+        return;
+    }
+
+    /* Sparse data in run mode, whose runs span many ring acquisitions. */
+    for (uint32 i = 0; i < 8192; ++i)
+    {
+        data[i] = (i % 509 == 0) ? (uint8) (0x1 << (i % 8)) : 0x00;
+    }
+
+    a.empty();
+    b.empty();
+    c.empty();
+    a.write_bytes(data, 8192);
+    coder.enable_run_mode(true);
+    coder.encode(&a, &b);
+
+    std::thread run_producer(produce_ring_bytes, &run_ring, data, 8192);
+    coder.encode(&run_ring, &c);
+    run_producer.join();
+
+    a.empty();
+
+    if (b.query_occupancy() != c.query_occupancy() ||
+        0 != memcmp(b.query_data(), c.query_data(), b.query_byte_occupancy()) ||
+        EVX_SUCCESS != coder.decode(8192 << 3, &c, &a) || 0 != memcmp(a.query_data(), data, 8192))
+    {
+        evx_err("Run mode ring encode diverged from the bitstream encode.");
+        return;
+    }
+
+    evx_msg("ring encode test completed successfully.");
+}
+
+void test_parallel_batch_rt()
+{
+    task_scheduler scheduler(4);
+    parallel_coder coder(&scheduler, 1024);
+    const uint32 sizes[] = { 50, 3000, 9000 };
+    bitstream sources[3];
+    bitstream coded[3];
+    bitstream decoded[3];
+    coding_job jobs[3];
+
+    /* Jobs run whole or in chunks, from unaligned sources and to unaligned dests. */
+    for (uint32 i = 0; i < 3; ++i)
+    {
+        sources[i].resize_capacity((sizes[i] + 1) << 3);
+        sources[i].write_byte(0xA5);
+        sources[i].seek(i);
+        coded[i].resize_capacity(8);
+        coded[i].write_run(1, i + 3);
+
+        for (uint32 j = 0; j < sizes[i]; ++j)
+        {
+            sources[i].write_byte(test_kernel(j) | ((j >> 7) & 0xF0));
+        }
+
+        jobs[i].source = &sources[i];
+        jobs[i].dest = &coded[i];
+    }
+
+    if (EVX_SUCCESS != coder.encode_batch(jobs, 3))
+    {
+        evx_err("Parallel batch encode failed.");
+        return;
+    }
+
+    for (uint32 i = 0; i < 3; ++i)
+    {
+        coded[i].seek(i + 3);
+        decoded[i].resize_capacity(8);
+        jobs[i].source = &coded[i];
+        jobs[i].dest = &decoded[i];
+    }
+
+    if (EVX_SUCCESS != coder.decode_batch(jobs, 3))
+    {
+        evx_err("Parallel batch decode failed.");
+        return;
+    }
+
+    for (uint32 i = 0; i < 3; ++i)
+    {
+        sources[i].seek(i);
+
+        if (decoded[i].query_occupancy() != sources[i].query_occupancy() || !coded[i].is_empty())
+        {
+            evx_err("Parallel batch size mismatch.");
+            return;
+        }
+
+        for (uint32 j = 0; j < decoded[i].query_occupancy(); ++j)
+        {
+            uint8 expected = 0;
+            uint8 actual = 0;
+
+            sources[i].read_bit(&expected);
+            decoded[i].read_bit(&actual);
+
+            if (expected != actual)
+            {
+                evx_err("Parallel batch data integrity check failure.");
+                return;
+            }
+        }
+    }
+
+    /* Oversized chunks are clamped rather than overflowing their bit counts. */
+    parallel_coder whole(&scheduler, 512 * EVX_MB);
+    bitstream whole_coded;
+    bitstream whole_decoded;
+    sources[2].seek(2);
+
+    if (EVX_SUCCESS != whole.encode(&sources[2], &whole_coded) || 
+        EVX_SUCCESS != whole.decode(&whole_coded, &whole_decoded) ||
+        whole_decoded.query_occupancy() != ((sizes[2] + 1) << 3) - 2)
+    {
+        evx_err("Parallel coding with an oversized chunk failed.");
+        return;
+    }
+
+    evx_msg("parallel batch test completed successfully.");
+}
+
+void block_until_released(void *context)
+{
+    std::atomic<uint32> *state = reinterpret_cast<std::atomic<uint32> *>(context);
+    state->store(1);
+
+    /* Bounded, so that a scheduler that waits on us cannot hang the test. */
+    for (uint32 i = 0; i < 2000 && 1 == state->load(); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    state->store(3);
+}
+
+void test_semi_static_rt()
+{
+    task_scheduler scheduler(2);
+    parallel_coder measure(&scheduler, 256);
+    entropy_coder coder;
+    bitstream a((uint32) 65536);
+    bitstream b((uint32) 65536);
+    bitstream c((uint32) 65536);
+    uint16 probability = 0;
+
+    /* A skewed source, read from an unaligned offset. */
+    a.write_run(1, 3);
+    a.seek(3);
+
+    for (uint32 i = 0; i < 3000; ++i)
+    {
+        a.write_byte((i % 7) ? 0x00 : (uint8) (0x11 << (i & 0x3)));
+    }
+
+    uint32 raw_size = a.query_occupancy();
+
+    if (EVX_SUCCESS != measure.measure_probability(a, &probability) ||
+        probability != entropy_coder::measure_probability(a))
+    {
+        evx_err("Parallel and serial probability measurements differ.");
+        return;
+    }
+
+    /* Another caller's long running task on the same scheduler must not delay us. */
+    std::atomic<uint32> blocker(0);
+    scheduler.submit(block_until_released, &blocker);
+
+    while (0 == blocker.load())
+    {
+        std::this_thread::yield();
+    }
+
+    uint16 shared_probability = 0;
+    bool independent = EVX_SUCCESS == measure.measure_probability(a, &shared_probability) && 1 == blocker.load();
+
+    blocker.store(2);
+    scheduler.wait();
+
+    if (!independent || shared_probability != probability)
+    {
+        evx_err("Parallel measurement waited on unrelated scheduler work.");
+        return;
+    }
+
+    if (EVX_SUCCESS != coder.encode_semi_static(probability, &a, &b))
+    {
+        evx_err("Semi-static encode failed.");
+        return;
+    }
+
+    evx_msg("semi-static encoded size: %i bits", b.query_occupancy());
+
+    entropy_coder decoder((uint8) EVX_ENTROPY_DEFAULT_FAST_RATE, (uint8) EVX_ENTROPY_DEFAULT_SLOW_RATE);
+
+    if (EVX_SUCCESS != decoder.decode_semi_static(raw_size, &b, &c) || 
+        raw_size != c.query_occupancy())
+    {
+        evx_err("Semi-static decode failed.");
+        return;
+    }
+
+    a.seek(3);
+
+    for (uint32 i = 0; i < raw_size; ++i)
+    {
+        uint8 expected = 0;
+        uint8 actual = 0;
+
+        a.read_bit(&expected);
+        c.read_bit(&actual);
+
+        if (expected != actual)
+        {
+            evx_err("Semi-static data integrity check failure.");
+            return;
+        }
+    }
+
+    evx_msg("semi-static test completed successfully.");
+}
+
+void test_indexed_parallel_decode()
+{
+    const uint32 byte_count = 20000;
+    const uint32 interval = 4096;
+    task_scheduler scheduler(4);
+    parallel_coder parallel(&scheduler, 1024);
+    entropy_coder coder((uint8) EVX_ENTROPY_DEFAULT_FAST_RATE, (uint8) EVX_ENTROPY_DEFAULT_SLOW_RATE);
+    entropy_index index;
+    entropy_index loaded;
+    bitstream a(byte_count << 3);
+    bitstream b(byte_count << 3);
+    bitstream c(byte_count << 3);
+    bitstream d(byte_count << 3);
+    bitstream image((EVX_INDEX_HEADER_SIZE + 64 * EVX_INDEX_ENTRY_SIZE) << 3);
+
+    for (uint32 i = 0; i < byte_count; ++i)
+    {
+        a.write_byte((i & 0x400) ? (uint8) (i * 0x9E) : test_kernel(i));
+    }
+
+    /* An indexed stream is identical to a plain encode of the same data. */
+    if (EVX_SUCCESS != coder.encode(&a, &c))
+    {
+        evx_err("Plain encode failed.");
+        return;
+    }
+
+    a.seek(0);
+
+    if (EVX_SUCCESS != coder.encode_indexed(interval, &a, &b, &index) ||
+        b.query_occupancy() != c.query_occupancy() ||
+        0 != memcmp(b.query_data(), c.query_data(), b.query_byte_occupancy()))
+    {
+        evx_err("Indexed encode does not match a plain encode.");
+        return;
+    }
+
+    if (index.query_entry_count() < 2 || index.query_symbol_count() != (byte_count << 3) ||
+        EVX_SUCCESS != index.save(&image) || EVX_SUCCESS != loaded.load(&image) ||
+        loaded.query_entry_count() != index.query_entry_count())
+    {
+        evx_err("Index save and load failed.");
+        return;
+    }
+
+    /* Every entry resumes serially into the span that follows it. */
+    for (uint32 i = 0; i < loaded.query_entry_count(); ++i)
+    {
+        entropy_index_entry entry;
+        entropy_coder decoder((uint8) EVX_ENTROPY_DEFAULT_FAST_RATE, (uint8) EVX_ENTROPY_DEFAULT_SLOW_RATE);
+        uint32 span = evx_min2(interval, (byte_count << 3) - i * interval);
+
+        b.seek(0);
+        d.empty();
+        loaded.query_entry(i, &entry);
+
+        if (entry.symbol_index != i * interval ||
+            EVX_SUCCESS != decoder.resume_decode(entry.checkpoint, &b) ||
+            EVX_SUCCESS != decoder.decode(span, &b, &d, false))
+        {
+            evx_err("Indexed resume failed.");
+            return;
+        }
+
+        for (uint32 j = 0; j < span; ++j)
+        {
+            uint8 expected = 0;
+            uint8 actual = 0;
+
+            a.seek(entry.symbol_index + j);
+            a.read_bit(&expected);
+            d.read_bit(&actual);
+
+            if (expected != actual)
+            {
+                evx_err("Indexed resume data integrity check failure.");
+                return;
+            }
+        }
+    }
+
+    b.seek(0);
+    d.empty();
+
+    if (EVX_SUCCESS != parallel.decode_indexed(loaded, &b, &d) || !b.is_empty() ||
+        d.query_occupancy() != (byte_count << 3) || 0 != memcmp(a.query_data(), d.query_data(), byte_count))
+    {
+        evx_err("Indexed parallel decode failed.");
+        return;
+    }
+
+    evx_msg("indexed parallel decode test completed successfully.");
+}
+
+void test_bounded_packets()
+{
+    const uint32 byte_count = 6000;
+    const uint32 budget = 180;
+    bitstream a(byte_count << 3);
+    uint32 packet_count = 0;
+
+    for (uint32 i = 0; i < byte_count; ++i)
+    {
+        a.write_byte((i & 0x200) ? (uint8) (i * 0x9E) : test_kernel(i));
+    }
+
+    /* Every packet fits the budget, decodes on its own, and all but the last are full 
+       to within the cost of the symbol that did not fit. */
+    while (!a.is_empty())
+    {
+        entropy_coder coder;
+        entropy_coder decoder;
+        bitstream packet(budget << 3);
+        bitstream decoded(byte_count << 3);
+        uint32 read_index = a.query_read_index();
+        uint32 symbol_count = 0;
+
+        if (EVX_SUCCESS != coder.encode_bounded(budget, &a, &packet, &symbol_count) || 0 == symbol_count ||
+            a.query_read_index() != read_index + symbol_count || packet.query_occupancy() > (budget << 3) ||
+            (!a.is_empty() && packet.query_occupancy() + 24 < (budget << 3)))
+        {
+            evx_err("Bounded encode failed.");
+            return;
+        }
+
+        if (EVX_SUCCESS != decoder.decode(symbol_count, &packet, &decoded))
+        {
+            evx_err("Bounded decode failed.");
+            return;
+        }
+
+        for (uint32 i = 0; i < symbol_count; ++i)
+        {
+            uint8 expected = 0;
+            uint8 actual = 0;
+
+            a.seek(read_index + i);
+            a.read_bit(&expected);
+            decoded.read_bit(&actual);
+
+            if (expected != actual)
+            {
+                evx_err("Bounded packet data integrity check failure.");
+                return;
+            }
+        }
+
+        packet_count++;
+    }
+
+    evx_msg("bounded encode produced %i packets of at most %i bytes.", packet_count, budget);
+    evx_msg("bounded packet test completed successfully.");
+}
+
+void test_sync_flush()
+{
+    const uint32 segment_count = 6;
+    const uint32 segment_size = 700;
+    entropy_coder encoder;
+    entropy_coder decoder;
+    entropy_coder plain;
+    bitstream a(segment_count * segment_size << 3);
+    bitstream b(segment_count * segment_size << 3);
+    bitstream c(segment_count * segment_size << 3);
+    bitstream d(segment_count * segment_size << 3);
+    bitstream live(segment_count * segment_size << 3);
+    bitstream view;
+    uint32 flush_points[segment_count + 1] = { 0 };
+
+    for (uint32 i = 0; i < segment_count * segment_size; ++i)
+    {
+        a.write_byte(test_kernel(i) | ((i / segment_size) << 4));
+    }
+
+    /* Each segment is flushed, byte aligned, while the model carries across flushes. */
+    for (uint32 i = 0; i < segment_count; ++i)
+    {
+        view.wrap(a.query_data() + i * segment_size, segment_size);
+
+        if (EVX_SUCCESS != encoder.encode(&view, &b, false) || EVX_SUCCESS != encoder.sync_flush(&b) ||
+            0 != (b.query_write_index() & 0x7))
+        {
+            evx_err("Sync flush encode failed.");
+            return;
+        }
+
+        flush_points[i + 1] = b.query_byte_occupancy();
+    }
+
+    a.seek(0);
+    plain.encode(&a, &c);
+    evx_msg("sync flush size: %i bits (%i bits unflushed)", b.query_occupancy(), c.query_occupancy());
+
+    /* Our decoder only ever sees the bytes written up to the latest flush. */
+    for (uint32 i = 0; i < segment_count; ++i)
+    {
+        live.write_bytes(b.query_data() + flush_points[i], flush_points[i + 1] - flush_points[i]);
+
+        if ((i && EVX_SUCCESS != decoder.sync_decode(&live)) ||
+            EVX_SUCCESS != decoder.decode(segment_size << 3, &live, &d, 0 == i) ||
+            live.query_write_index() - live.query_read_index() >= 8)
+        {
+            evx_err("Sync flush decode failed.");
+            return;
+        }
+    }
+
+    if (d.query_occupancy() != a.query_write_index() || 0 != memcmp(a.query_data(), d.query_data(), segment_count * segment_size))
+    {
+        evx_err("Sync flush data integrity check failure.");
+        return;
+    }
+
+    evx_msg("sync flush test completed successfully.");
+}
+
+void test_filter_stages()
+{
+    const uint32 word_count = 10000;
+    const uint32 byte_count = (word_count << 2) + 3;
+    const uint8 chains[][3] = { { EVX_FILTER_DELTA }, { EVX_FILTER_XOR_DELTA }, { EVX_FILTER_BIT_PLANE }, 
+                                { EVX_FILTER_BWT_MTF }, { EVX_FILTER_DELTA, EVX_FILTER_BIT_PLANE }, 
+                                { EVX_FILTER_XOR_DELTA, EVX_FILTER_BWT_MTF, EVX_FILTER_BIT_PLANE } };
+    const uint8 word_sizes[] = { 1, 2, 4, 8 };
+    bitstream a(byte_count << 3);
+    uint32 raw_size = 0;
+
+    /* A column of slowly increasing 32 bit timestamps, plus a few trailing bytes. */
+    for (uint32 i = 0; i < word_count; ++i)
+    {
+        uint32 value = 1000000 + i * 37 + ((i * 0x9E3779B9) >> 28);
+
+        for (uint32 j = 0; j < 4; ++j)
+        {
+            a.write_byte((value >> (j << 3)) & 0xFF);
+        }
+    }
+
+    a.write_byte(1);
+    a.write_byte(test_kernel(2));
+    a.write_byte(3);
+
+    for (uint32 i = 0; i < sizeof(chains) / sizeof(chains[0]); ++i)
+    {
+        for (uint32 j = 0; j < sizeof(word_sizes); ++j)
+        {
+            stream_filter filter;
+            stream_filter reader;
+            entropy_coder coder;
+            bitstream b(byte_count << 4);
+            bitstream c(byte_count << 3);
+
+            filter.set_word_size(word_sizes[j]);
+
+            for (uint32 k = 0; k < 3 && chains[i][k]; ++k)
+            {
+                filter.add_stage(chains[i][k]);
+            }
+
+            a.seek(0);
+
+            if (EVX_SUCCESS != filter.encode(&coder, &a, &b) || EVX_SUCCESS != reader.decode(&coder, &b, &c) ||
+                reader.query_stage_count() != filter.query_stage_count() || reader.query_word_size() != word_sizes[j] ||
+                c.query_occupancy() != (byte_count << 3) || 0 != memcmp(a.query_data(), c.query_data(), byte_count))
+            {
+                evx_err("Filter chain %i with word size %i failed to round trip.", i, word_sizes[j]);
+                return;
+            }
+
+            /* Delta and bit planes over whole words should beat coding the raw bytes. */
+            if (4 == i && 4 == word_sizes[j])
+            {
+                entropy_coder plain;
+                bitstream d(byte_count << 4);
+
+                a.seek(0);
+                plain.encode(&a, &d);
+                raw_size = d.query_occupancy();
+
+                evx_msg("filtered size: %i bits (%i bits unfiltered)", b.query_write_index(), raw_size);
+
+                if (b.query_write_index() >= raw_size)
+                {
+                    evx_err("Filtered coding did not improve our ratio.");
+                    return;
+                }
+            }
+        }
+    }
+
+    evx_msg("filter stage test completed successfully.");
+}
+
+void test_cpu_dispatch()
+{
+    const uint32 byte_count = 4003;
+    uint8 data[byte_count];
+    std::vector<uint8> reference;
+    uint32 reference_count = 0;
+
+    for (uint32 i = 0; i < byte_count; ++i)
+    {
+        data[i] = (uint8) ((i * 0x9E3779B9) >> 24);
+    }
+
+    /* Every supported variant must match the scalar kernels bit for bit. */
+    for (uint8 level = EVX_CPU_SCALAR; level <= query_cpu_support(); ++level)
+    {
+        stream_filter filter;
+        std::vector<uint8> planes;
+        std::vector<uint8> restored;
+        bitstream source;
+        bitstream dest(byte_count << 3);
+
+        if (EVX_SUCCESS != force_cpu_level(level) || query_cpu_level() != level)
+        {
+            evx_err("Unable to force cpu level %s.", query_cpu_level_name(level));
+            return;
+        }
+
+        /* Shifted copies from every source alignment to an unaligned dest. */
+        for (uint32 shift = 1; shift < 8; ++shift)
+        {
+            source.wrap(data, byte_count);
+            source.seek(shift);
+            dest.empty();
+            dest.write_run(1, 3);
+            dest.seek(3);
+
+            if (EVX_SUCCESS != dest.append(source))
+            {
+                evx_err("Shifted append failed.");
+                return;
+            }
+
+            for (uint32 i = 0; i < (byte_count << 3) - shift; ++i)
+            {
+                uint8 bit = 0;
+                dest.read_bit(&bit);
+
+                if (bit != ((data[(i + shift) >> 3] >> ((i + shift) & 0x7)) & 0x1))
+                {
+                    evx_err("Shifted copy mismatch at level %s.", query_cpu_level_name(level));
+                    return;
+                }
+            }
+        }
+
+        uint32 one_count = count_set_bits(data, 5, (byte_count << 3) - 9);
+        filter.set_word_size(2);
+        filter.add_stage(EVX_FILTER_BIT_PLANE);
+        filter.forward(data, byte_count, &planes);
+        filter.inverse(planes.data(), (uint32) planes.size(), &restored);
+
+        if (EVX_CPU_SCALAR == level)
+        {
+            reference = planes;
+            reference_count = one_count;
+        }
+
+        if (planes != reference || one_count != reference_count || 0 != memcmp(restored.data(), data, byte_count))
+        {
+            evx_err("Kernel mismatch at level %s.", query_cpu_level_name(level));
+            return;
+        }
+
+        if (multi_stream_decoder::is_lane_count_supported(EVX_MULTISTREAM_AVX2_LANES) != (level >= EVX_CPU_AVX2))
+        {
+            evx_err("Multi-stream lanes ignore the cpu level.");
+            return;
+        }
+
+        evx_msg("cpu level %s verified.", query_cpu_level_name(level));
+    }
+
+    force_cpu_level(EVX_CPU_AUTO);
+
+    evx_msg("cpu dispatch test completed successfully.");
+}
+
+void test_hashed_contexts()
+{
+    const char *levels[] = { "INFO", "WARN", "INFO", "DEBUG" };
+    const uint8 bucket_bits[] = { EVX_HASHED_DEFAULT_BUCKET_BITS, 4 };
+    bitstream a(64 * EVX_KB << 3);
+    bitstream plain_coded(64 * EVX_KB << 3);
+    entropy_coder plain;
+    char line[128];
+
+    /* A synthetic log, whose structure is only visible to a high order model. */
+    for (uint32 i = 0; i < 600; ++i)
+    {
+        int32 length = snprintf(line, sizeof(line), "2026-10-18 12:%02i:%02i %s request id=%05i path=/api/v1/items/%i status=%i\n",
+                                (i / 60) % 60, i % 60, levels[i & 0x3], i * 7, i % 13, (i % 17) ? 200 : 404);
+        a.write_bytes(line, (uint32) length);
+    }
+
+    uint32 byte_count = a.query_byte_occupancy();
+    plain.encode(&a, &plain_coded);
+
+    for (uint32 i = 0; i < sizeof(bucket_bits); ++i)
+    {
+        entropy_coder coder;
+        entropy_coder decoder;
+        hashed_byte_coder encoder(&coder);
+        hashed_byte_coder reader(&decoder);
+        bitstream b(64 * EVX_KB << 3);
+        bitstream c(64 * EVX_KB << 3);
+
+        /* A tiny table forces constant slot replacement, which must stay in sync. */
+        a.seek(0);
+
+        if (EVX_SUCCESS != encoder.create(EVX_HASHED_DEFAULT_ORDER, bucket_bits[i]) ||
+            EVX_SUCCESS != reader.create(EVX_HASHED_DEFAULT_ORDER, bucket_bits[i]) ||
+            EVX_SUCCESS != encoder.encode(&a, &b) || EVX_SUCCESS != reader.decode(byte_count, &b, &c) ||
+            c.query_byte_occupancy() != byte_count || 0 != memcmp(a.query_data(), c.query_data(), byte_count))
+        {
+            evx_err("Hashed context round trip failed with %i bucket bits.", bucket_bits[i]);
+            return;
+        }
+
+        evx_msg("order %i hashed size with %i bucket bits: %i bits (%i bits order 0)", EVX_HASHED_DEFAULT_ORDER, 
+                bucket_bits[i], b.query_write_index(), plain_coded.query_occupancy());
+
+        if (0 == i && b.query_write_index() * 2 > plain_coded.query_occupancy())
+        {
+            evx_err("Hashed contexts failed to improve our ratio.");
+            return;
+        }
+    }
+
+    evx_msg("hashed context test completed successfully.");
+}
+
+void test_match_model()
+{
+    const uint32 record_size = 160;
+    const uint32 record_count = 32;
+    bitstream a(64 * EVX_KB << 3);
+    uint32 coded_sizes[2] = { 0 };
+    uint8 records[record_count][record_size];
+
+    /* Noisy records repeated in a scrambled order: every repeat is far longer than 
+       any hashed order, so only the match model can anticipate it. */
+    for (uint32 i = 0; i < record_count; ++i)
+    {
+        for (uint32 j = 0; j < record_size; ++j)
+        {
+            records[i][j] = test_kernel(i * record_size + j) ^ (uint8) (j * 131 + i * 7);
+        }
+    }
+
+    for (uint32 i = 0; i < 300; ++i)
+    {
+        uint32 record = (i * 13 + (i >> 3)) % record_count;
+        records[record][i % record_size] += (0 == i % 7) ? 1 : 0;
+        a.write_bytes(records[record], record_size);
+    }
+
+    uint32 byte_count = a.query_byte_occupancy();
+
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        entropy_coder coder;
+        entropy_coder decoder;
+        hashed_byte_coder encoder(&coder);
+        hashed_byte_coder reader(&decoder);
+        match_model encoder_matches;
+        match_model reader_matches;
+        bitstream b(64 * EVX_KB << 3);
+        bitstream c(64 * EVX_KB << 3);
+
+        if (EVX_SUCCESS != encoder.create(2, EVX_HASHED_DEFAULT_BUCKET_BITS) ||
+            EVX_SUCCESS != reader.create(2, EVX_HASHED_DEFAULT_BUCKET_BITS) ||
+            EVX_SUCCESS != encoder_matches.create(16, 14) || EVX_SUCCESS != reader_matches.create(16, 14))
+        {
+            evx_err("Failed to create match models.");
+            return;
+        }
+
+        if (i)
+        {
+            encoder.attach_match_model(&encoder_matches);
+            reader.attach_match_model(&reader_matches);
+        }
+
+        a.seek(0);
+
+        if (EVX_SUCCESS != encoder.encode(&a, &b) || EVX_SUCCESS != reader.decode(byte_count, &b, &c) ||
+            c.query_byte_occupancy() != byte_count || 0 != memcmp(a.query_data(), c.query_data(), byte_count))
+        {
+            evx_err("Match model round trip failed (%s).", i ? "with matches" : "without matches");
+            return;
+        }
+
+        coded_sizes[i] = b.query_write_index();
+    }
+
+    evx_msg("order 2 hashed size with match model: %i bits (%i bits without, %i bytes raw)", 
+            coded_sizes[1], coded_sizes[0], byte_count);
+
+    if (coded_sizes[1] * 2 > coded_sizes[0])
+    {
+        evx_err("Match model failed to improve our ratio.");
+        return;
+    }
+
+    evx_msg("match model test completed successfully.");
+}
+
+void test_parallel_statistics()
+{
+    const uint32 context_counts[] = { 1, 8, 24 };
+    task_scheduler scheduler(4);
+    parallel_coder trainer(&scheduler, 256);
+    bitstream a((uint32) 65536 << 3);
+
+    /* Seven bit text, read from an unaligned offset so spans begin mid byte. */
+    a.write_run(1, 5);
+
+    for (uint32 i = 0; i < 60000; ++i)
+    {
+        a.write_byte(test_kernel(i) & 0x7F);
+    }
+
+    for (uint32 i = 0; i < sizeof(context_counts) / sizeof(context_counts[0]); ++i)
+    {
+        uint32 context_count = context_counts[i];
+        entropy_model reference;
+        entropy_model serial;
+        entropy_model parallel;
+        uint8 value = 0;
+
+        if (EVX_SUCCESS != reference.create(context_count) || EVX_SUCCESS != serial.create(context_count) ||
+            EVX_SUCCESS != parallel.create(context_count))
+        {
+            evx_err("Failed to create statistics models.");
+            return;
+        }
+
+        /* Our reference observes one bit at a time. */
+        a.seek(5);
+
+        for (uint32 j = 0; !a.is_empty(); j = (j + 1) % context_count)
+        {
+            a.read_bit(&value);
+            reference.observe(j, value);
+        }
+
+        a.seek(5);
+
+        if (EVX_SUCCESS != trainer.train_model(a, &parallel) || 5 != a.query_read_index() ||
+            EVX_SUCCESS != serial.train(&a) || !a.is_empty())
+        {
+            evx_err("Failed to gather statistics over %i contexts.", context_count);
+            return;
+        }
+
+        for (uint32 j = 0; j < context_count; ++j)
+        {
+            uint64 counts[3][2] = { { 0 } };
+            reference.query_counts(j, &counts[0][0], &counts[0][1]);
+            serial.query_counts(j, &counts[1][0], &counts[1][1]);
+            parallel.query_counts(j, &counts[2][0], &counts[2][1]);
+
+            if (0 != memcmp(counts[0], counts[1], sizeof(counts[0])) ||
+                0 != memcmp(counts[0], counts[2], sizeof(counts[0])))
+            {
+                evx_err("Statistics of context %i of %i differ from the reference.", j, context_count);
+                return;
+            }
+        }
+
+        if (EVX_SUCCESS != parallel.save("abac-test.model") || EVX_SUCCESS != serial.save("abac-test.model") ||
+            parallel.query_signature() != serial.query_signature())
+        {
+            evx_err("Parallel and serial models differ.");
+            return;
+        }
+
+        remove("abac-test.model");
+    }
+
+    /* With one context per bit of each byte, the always clear high bit is free. */
+    entropy_model bytes;
+    float64 entropy[2] = { 1.0, 0.0 };
+    a.seek(5);
+
+    if (EVX_SUCCESS != bytes.create(8) || EVX_SUCCESS != trainer.train_model(a, &bytes) ||
+        EVX_SUCCESS != bytes.query_entropy(7, &entropy[0]) || EVX_SUCCESS != bytes.query_entropy(0, &entropy[1]) ||
+        0.0 != entropy[0] || entropy[1] <= 0.0 || entropy[1] > 1.0)
+    {
+        evx_err("Unexpected context entropy estimates.");
+        return;
+    }
+
+    evx_msg("low bit entropy: %.4f bits/symbol (high bit %.4f)", entropy[1], entropy[0]);
+    evx_msg("parallel statistics test completed successfully.");
+}
+
+void test_multi_stream_decode()
+{
+    const uint32 stream_count = 37;
+    const uint32 lane_counts[] = { EVX_MULTISTREAM_SCALAR_LANES, EVX_MULTISTREAM_AVX2_LANES, EVX_MULTISTREAM_AVX512_LANES };
+    bitstream coded[stream_count];
+    uint32 symbol_counts[stream_count];
+    uint8 data[1024];
+
+    /* Streams vary in length and skew, so lanes retire at different times. */
+    for (uint32 i = 0; i < stream_count; ++i)
+    {
+        entropy_coder coder(EVX_ENTROPY_DEFAULT_FAST_RATE, EVX_ENTROPY_DEFAULT_SLOW_RATE);
+        uint32 byte_count = 1 + (i * 97) % 700;
+        bitstream source((uint32) (byte_count << 3));
+
+        for (uint32 j = 0; j < byte_count; ++j)
+        {
+            data[j] = (j % (i + 2)) ? test_kernel(j + i) : (uint8) (j * 31 + i);
+        }
+
+        source.write_bytes(data, byte_count);
+        symbol_counts[i] = source.query_occupancy() - (i % 5);
+        source.truncate(symbol_counts[i]);
+
+        coded[i].resize_capacity(byte_count << 4);
+        coder.encode(&source, &coded[i]);
+    }
+
+    for (uint32 k = 0; k < 3; ++k)
+    {
+        multi_stream_decoder decoder;
+        bitstream decoded[stream_count];
+        decode_stream streams[stream_count];
+
+        if (!multi_stream_decoder::is_lane_count_supported(lane_counts[k]))
+        {
+            continue;
+        }
+
+        decoder.select_lanes(lane_counts[k]);
+
+        for (uint32 i = 0; i < stream_count; ++i)
+        {
+            coded[i].seek(0);
+            decoded[i].resize_capacity(symbol_counts[i] + 32);
+            streams[i].source = &coded[i];
+            streams[i].dest = &decoded[i];
+            streams[i].symbol_count = symbol_counts[i];
+        }
+
+        if (EVX_SUCCESS != decoder.decode(streams, stream_count))
+        {
+            evx_err("Multi-stream decode failed.");
+            return;
+        }
+
+        for (uint32 i = 0; i < stream_count; ++i)
+        {
+            entropy_coder reference_coder(EVX_ENTROPY_DEFAULT_FAST_RATE, EVX_ENTROPY_DEFAULT_SLOW_RATE);
+            bitstream reference(symbol_counts[i] + 32);
+            uint32 read_index = coded[i].query_read_index();
+
+            coded[i].seek(0);
+            reference_coder.decode(symbol_counts[i], &coded[i], &reference);
+
+            if (reference.query_occupancy() != decoded[i].query_occupancy() ||
+                read_index != coded[i].query_read_index() ||
+                0 != memcmp(reference.query_data(), decoded[i].query_data(), symbol_counts[i] >> 3))
+            {
+                evx_err("Multi-stream decode diverged from the scalar decoder.");
+                return;
+            }
+
+            for (uint32 j = symbol_counts[i] & ~0x7; j < symbol_counts[i]; ++j)
+            {
+                uint8 expected = 0;
+                uint8 actual = 0;
+
+                reference.seek(j);
+                decoded[i].seek(j);
+                reference.read_bit(&expected);
+                decoded[i].read_bit(&actual);
+
+                if (expected != actual)
+                {
+                    evx_err("Multi-stream decode diverged from the scalar decoder.");
+                    return;
+                }
+            }
+        }
+
+        evx_msg("multi-stream decode verified with %i lanes.", lane_counts[k]);
+    }
+
+    evx_msg("multi-stream decode test completed successfully.");
+}
+
+void test_stream_compatibility()
+{
+    /* A mismatched static model forces long runs of E1/E2 and E3 scaling. The
+       expected stream was produced by the original bit serial scaling loops. */
+    const uint8 expected[] = { 0xBE, 0x4A, 0x49, 0x40, 0x5C, 0xA4, 0xE8, 0xE2, 0x77, 0xCD, 
+                               0x34, 0x32, 0xDB, 0x6E, 0xE7, 0xEC, 0xCC, 0xA9, 0xF5, 0x95, 
+                               0x33, 0xB4, 0x65, 0x70, 0xB5, 0xC0, 0x4E, 0x01 };
+
+    entropy_coder coder((uint32) 60000);
+    bitstream a((uint32) 512);
+    bitstream b((uint32) 2048);
+    bitstream c((uint32) 512);
+
+    for (uint32 i = 0; i < 16; ++i)
+    {
+        a.write_byte((i * 37) ^ (i >> 1));
+    }
+
+    uint32 raw_size = a.query_occupancy();
+    coder.encode(&a, &b);
+
+    if (217 != b.query_occupancy() || 0 != memcmp(b.query_data(), expected, sizeof(expected)))
+    {
+        evx_err("Encoded stream does not match the reference stream.");
+        return;
+    }
+
+    coder.decode(raw_size, &b, &c);
+
+    if (0 != memcmp(a.query_data(), c.query_data(), raw_size >> 3))
+    {
+        evx_err("Reference stream data integrity check failure.");
+        return;
+    }
+
+    evx_msg("stream compatibility test completed successfully.");
+}
+
+evx_status count_sink_bytes(const uint8 *data, uint32 byte_count, void *user_data)
+{
+    *reinterpret_cast<uint32 *>(user_data) += byte_count;
+    return EVX_SUCCESS;
+}
+
+void test_output_sinks()
+{
+    entropy_coder coder;
+    bitstream a((uint32) 65536);
+    bitstream reference((uint32) 65536);
+
+    for (uint32 i = 0; i < 4096; ++i)
+    {
+        a.write_byte(test_kernel(i) ^ (i >> 5));
+    }
+
+    coder.encode(&a, &reference);
+    uint32 reference_bytes = reference.query_byte_occupancy();
+
+    /* Stream the same encode through a small staging buffer into each sink type. */
+    std::vector<uint8> vector_output;
+    uint32 callback_bytes = 0;
+    vector_sink vector_output_sink(&vector_output);
+    callback_sink counting_sink(count_sink_bytes, &callback_bytes);
+    ring_sink ring_output_sink(reference_bytes);
+    FILE *file = tmpfile();
+    fd_sink file_sink(fileno(file));
+
+    bitstream_sink *sinks[] = { &vector_output_sink, &counting_sink, &ring_output_sink, &file_sink };
+
+    for (uint32 i = 0; i < 4; ++i)
+    {
+        bitstream staging((uint32) 8192);
+        staging.attach_sink(sinks[i]);
+        a.seek(0);
+
+        if (EVX_SUCCESS != coder.encode(&a, &staging) ||
+            EVX_SUCCESS != staging.flush_sink(true) ||
+            staging.query_flushed_bits() != reference.query_occupancy())
+        {
+            evx_err("Failed to stream an encode into a sink.");
+            return;
+        }
+    }
+
+    std::vector<uint8> ring_output(reference_bytes);
+    std::vector<uint8> file_output(reference_bytes);
+    uint32 ring_bytes = reference_bytes;
+
+    ring_output_sink.read(&ring_output[0], &ring_bytes);
+    rewind(file);
+    uint32 file_bytes = (uint32) fread(&file_output[0], 1, reference_bytes, file);
+    fclose(file);
+
+    if (vector_output.size() != reference_bytes || callback_bytes != reference_bytes ||
+        ring_bytes != reference_bytes || file_bytes != reference_bytes ||
+        0 != memcmp(&vector_output[0], reference.query_data(), reference_bytes - 1) ||
+        0 != memcmp(&ring_output[0], reference.query_data(), reference_bytes - 1) ||
+        0 != memcmp(&file_output[0], reference.query_data(), reference_bytes - 1))
+    {
+        evx_err("Sink output differs from a direct encode.");
+        return;
+    }
+
+    /* Single bit writes fill a tiny staging buffer exactly, byte aligned, before 
+       each drain. */
+    std::vector<uint8> bit_output;
+    vector_sink bit_sink(&bit_output);
+    bitstream bit_staging((uint32) 64);
+    bit_staging.attach_sink(&bit_sink);
+
+    for (uint32 i = 0; i < 200; ++i)
+    {
+        if (EVX_SUCCESS != bit_staging.write_bit(test_kernel(i) & 0x1))
+        {
+            evx_err("Failed to stream single bits into a sink.");
+            return;
+        }
+    }
+
+    if (EVX_SUCCESS != bit_staging.flush_sink(true) || 200 != bit_staging.query_flushed_bits() || 25 != bit_output.size())
+    {
+        evx_err("Failed to drain a full staging buffer.");
+        return;
+    }
+
+    for (uint32 i = 0; i < 200; ++i)
+    {
+        if (((bit_output[i >> 3] >> (i & 0x7)) & 0x1) != (test_kernel(i) & 0x1))
+        {
+            evx_err("Drained bit %i differs from the bit written.", i);
+            return;
+        }
+    }
+
+    evx_msg("output sink test completed successfully.");
+}
+
+void test_container_rt()
+{
+    const char *words[] = { "the ", "coder ", "context ", "adapts ", "to ", "each ", "bit ", "of ", "a ", "stream.\n" };
+    const uint32 levels[] = { 1, 3, EVX_CONTAINER_MAX_LEVEL };
+    uint32 coded_sizes[3] = { 0 };
+    std::vector<uint8> input;
+    uint32 seed = 1;
+
+    /* Several level 1 chunks of text drawn from a small vocabulary. */
+    while (input.size() < 320 * EVX_KB)
+    {
+        seed = seed * 1103515245 + 12345;
+        const char *word = words[(seed >> 16) % 10];
+        input.insert(input.end(), word, word + strlen(word));
+    }
+
+    for (uint32 i = 0; i < 3; ++i)
+    {
+        FILE *raw = tmpfile();
+        FILE *packed = tmpfile();
+        FILE *unpacked = tmpfile();
+        std::vector<uint8> output(input.size() + 1);
+
+        fwrite(&input[0], 1, input.size(), raw);
+        rewind(raw);
+
+        bool coded = (EVX_SUCCESS == compress_container(raw, packed, levels[i], 2));
+        coded_sizes[i] = (uint32) ftell(packed);
+        rewind(packed);
+        coded = coded && (EVX_SUCCESS == decompress_container(packed, unpacked, 2));
+        rewind(unpacked);
+
+        uint32 output_size = (uint32) fread(&output[0], 1, output.size(), unpacked);
+
+        fclose(raw);
+        fclose(packed);
+        fclose(unpacked);
+
+        if (!coded || output_size != input.size() || 0 != memcmp(&output[0], &input[0], input.size()))
+        {
+            evx_err("Container round trip failed at level %i.", levels[i]);
+            return;
+        }
+    }
+
+    /* Higher levels select higher order models than the previous byte contexts of level 1. */
+    if (coded_sizes[0] >= input.size() / 2 || coded_sizes[1] >= coded_sizes[0] || coded_sizes[2] >= coded_sizes[0])
+    {
+        evx_err("Container levels did not improve compression (%i, %i, %i bytes).", coded_sizes[0], coded_sizes[1], coded_sizes[2]);
+        return;
+    }
+
+    evx_msg("container test completed successfully: %i bytes at level 1, %i at level 3, %i at level %i.",
+            coded_sizes[0], coded_sizes[1], coded_sizes[2], EVX_CONTAINER_MAX_LEVEL);
+}
+
 int main() 
 {
     test_basic_cabac_rt();
+    test_dual_rate_cabac_rt();
+    test_trained_model_rt();
+    test_rate_estimation();
+    test_checkpoint_rollback();
+    test_bulk_capacity_fallback();
+    test_stream_compatibility();
+    test_run_mode_rt();
+    test_bitstream_append();
+    test_integer_coding_rt();
+    test_residual_block_rt();
+    test_context_table();
+    test_ring_encode();
+    test_parallel_batch_rt();
+    test_semi_static_rt();
+    test_multi_stream_decode();
+    test_indexed_parallel_decode();
+    test_bounded_packets();
+    test_sync_flush();
+    test_filter_stages();
+    test_cpu_dispatch();
+    test_hashed_contexts();
+    test_match_model();
+    test_parallel_statistics();
+    test_output_sinks();
+    test_container_rt();
 	return 0;
 }
@@ -0,0 +1,168 @@
+
+#include "model.h"
+#include "math.h"
+#include "parallel.h"
+
+using namespace evx;
+
+#define EVX_TRAIN_CHUNK_SIZE                    (64 * EVX_MB)
+#define EVX_TRAIN_SPAN_SIZE                     (EVX_MB)
+
+/*
+// abac-train
+//
+// Trains initial context states from a corpus of sample files and saves them as a
+// model file that coders may load via entropy_coder::load_model.
+//
+//   usage: abac-train [-c context_count] [-j workers] [-v] output.model sample [sample ...]
+//
+// Bit i of each sample trains context (i % context_count). Samples are processed
+// in chunks whose bit length is a multiple of the context count so that the context
+// assignment is identical to training the entire sample at once. Each chunk is 
+// counted across workers (one per hardware thread by default) without any coding.
+//
+// Once trained, we report the empirical entropy of the corpus under the model, and
+// with -v the counts and entropy of every context.
+*/
+
+void print_usage()
+{
+    printf("usage: abac-train [-c context_count] [-j workers] [-v] output.model sample [sample ...]\n");
+}
+
+evx_status train_sample(const char *filename, uint32 context_count, parallel_coder *trainer, entropy_model *model)
+{
+    FILE *file = fopen(filename, "rb");
+
+    if (!file)
+    {
+        printf("error: unable to open %s\n", filename);
+        return EVX_ERROR_RESOURCE_UNREACHABLE;
+    }
+
+    uint32 chunk_size = evx_max2(EVX_TRAIN_CHUNK_SIZE - (EVX_TRAIN_CHUNK_SIZE % context_count), context_count);
+    uint8 *buffer = new uint8[chunk_size];
+    bitstream chunk;
+    evx_status result = EVX_SUCCESS;
+
+    while (EVX_SUCCESS == result)
+    {
+        uint32 bytes_read = (uint32) fread(buffer, 1, chunk_size, file);
+
+        if (0 == bytes_read)
+        {
+            break;
+        }
+
+        if (EVX_SUCCESS != chunk.wrap(buffer, bytes_read) ||
+            EVX_SUCCESS != trainer->train_model(chunk, model))
+        {
+            result = EVX_ERROR_EXECUTION_FAILURE;
+        }
+    }
+
+    delete [] buffer;
+    fclose(file);
+
+    return result;
+}
+
+void print_statistics(const entropy_model &model, bool verbose)
+{
+    uint64 symbol_count = 0;
+    float64 estimated_bits = 0.0;
+
+    for (uint32 i = 0; i < model.query_context_count(); ++i)
+    {
+        uint64 zero_count = 0;
+        uint64 one_count = 0;
+        float64 entropy = 0.0;
+
+        if (EVX_SUCCESS != model.query_counts(i, &zero_count, &one_count) ||
+            EVX_SUCCESS != model.query_entropy(i, &entropy))
+        {
+            return;
+        }
+
+        if (verbose)
+        {
+            printf("context %i: %llu zeros, %llu ones, %.4f bits/symbol\n", i, 
+                   (unsigned long long) zero_count, (unsigned long long) one_count, entropy);
+        }
+
+        symbol_count += zero_count + one_count;
+        estimated_bits += entropy * (zero_count + one_count);
+    }
+
+    printf("trained %llu symbols, estimated %.0f bits (%.4f bits/symbol)\n", (unsigned long long) symbol_count, 
+           estimated_bits, symbol_count ? estimated_bits / symbol_count : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    uint32 context_count = 1;
+    uint32 worker_count = 0;
+    bool verbose = false;
+    int32 arg_index = 1;
+
+    while (arg_index < argc && '-' == argv[arg_index][0])
+    {
+        if (0 == strcmp(argv[arg_index], "-v"))
+        {
+            verbose = true;
+            arg_index++;
+        }
+        else if (arg_index + 1 < argc && 0 == strcmp(argv[arg_index], "-c"))
+        {
+            context_count = (uint32) atoi(argv[arg_index + 1]);
+            arg_index += 2;
+        }
+        else if (arg_index + 1 < argc && 0 == strcmp(argv[arg_index], "-j"))
+        {
+            worker_count = (uint32) atoi(argv[arg_index + 1]);
+            arg_index += 2;
+        }
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (0 == context_count || argc - arg_index < 2)
+    {
+        print_usage();
+        return 1;
+    }
+
+    entropy_model model;
+    task_scheduler scheduler(worker_count);
+    parallel_coder trainer(&scheduler, EVX_TRAIN_SPAN_SIZE);
+    const char *output_filename = argv[arg_index++];
+
+    if (EVX_SUCCESS != model.create(context_count))
+    {
+        printf("error: unable to create a model with %i contexts\n", context_count);
+        return 1;
+    }
+
+    for (; arg_index < argc; ++arg_index)
+    {
+        if (EVX_SUCCESS != train_sample(argv[arg_index], context_count, &trainer, &model))
+        {
+            return 1;
+        }
+    }
+
+    print_statistics(model, verbose);
+
+    if (EVX_SUCCESS != model.save(output_filename))
+    {
+        printf("error: unable to save %s\n", output_filename);
+        return 1;
+    }
+
+    printf("saved %i contexts to %s (signature %08x)\n", context_count, output_filename, model.query_signature());
+
+    return 0;
+}